@@ -0,0 +1,94 @@
+#ifndef ASSIMP_IO_H
+#define ASSIMP_IO_H
+
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+
+#include <learnopengl/filesystem.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+// Lets assimp read models, and the files they reference (an OBJ's .mtl libraries), through FileSystem:
+// from the mounted resource pack when it has them, from disk otherwise. every file assimp opens is read
+// whole into memory, which is what its importers do with a file anyway.
+//
+// usage:
+//     Assimp::Importer importer;
+//     importer.SetIOHandler(new FileSystemIOSystem); // the importer owns and deletes it
+//     importer.ReadFile(path, flags);
+//
+// read only: opening a file for writing fails.
+
+class FileSystemIOStream : public Assimp::IOStream
+{
+public:
+    explicit FileSystemIOStream(std::string&& fileContent) : content(std::move(fileContent)) {}
+
+    size_t Read(void* buffer, size_t size, size_t count) override
+    {
+        if (size == 0 || count == 0)
+            return 0;
+        // whole elements only, like fread
+        size_t elements = std::min(count, (content.size() - position) / size);
+        std::memcpy(buffer, content.data() + position, elements * size);
+        position += elements * size;
+        return elements;
+    }
+
+    size_t Write(const void*, size_t, size_t) override
+    {
+        return 0;
+    }
+
+    // the offset is negative (wrapped around) for aiOrigin_END, as with fseek
+    aiReturn Seek(size_t offset, aiOrigin origin) override
+    {
+        size_t target = offset;
+        if (origin == aiOrigin_CUR)
+            target = position + offset;
+        else if (origin == aiOrigin_END)
+            target = content.size() + offset;
+        if (target > content.size())
+            return aiReturn_FAILURE;
+        position = target;
+        return aiReturn_SUCCESS;
+    }
+
+    size_t Tell() const override { return position; }
+    size_t FileSize() const override { return content.size(); }
+    void Flush() override {}
+
+private:
+    std::string content;
+    size_t position = 0;
+};
+
+class FileSystemIOSystem : public Assimp::IOSystem
+{
+public:
+    bool Exists(const char* path) const override
+    {
+        return FileSystem::exists(path);
+    }
+
+    char getOsSeparator() const override
+    {
+        return '/';
+    }
+
+    Assimp::IOStream* Open(const char* path, const char* mode = "rb") override
+    {
+        std::string content;
+        if (std::strchr(mode, 'w') || std::strchr(mode, 'a') || !FileSystem::readFile(path, content))
+            return nullptr;
+        return new FileSystemIOStream(std::move(content));
+    }
+
+    void Close(Assimp::IOStream* file) override
+    {
+        delete file;
+    }
+};
+#endif
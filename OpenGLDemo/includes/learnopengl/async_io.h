@@ -0,0 +1,672 @@
+#ifndef ASYNC_IO_H
+#define ASYNC_IO_H
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/profiler.h>
+#include <learnopengl/thread_pool.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// io_uring is talked to through its system calls directly, the kernel headers are all it needs
+#if defined(__linux__) && !defined(LOGL_NO_IO_URING) && __has_include(<linux/io_uring.h>)
+#define ASYNC_IO_URING 1
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Reads whole files in the background, most important first, so streaming never blocks a frame on
+// the disk. A request gets a priority (higher is read sooner) that can be changed or cancelled while it
+// waits; files are read in IO_CHUNK_SIZE chunks, so a request that becomes more important overtakes a
+// large file already being read, and up to IO_QUEUE_DEPTH chunks are in flight at once to keep an SSD's
+// queues full.
+//
+// the reads go through io_uring on Linux (one I/O thread submits and reaps them, no thread blocks per
+// read), and are pread on the thread pool elsewhere or when the kernel refuses io_uring. the completion
+// callback runs on the thread pool, so it can go straight on to decode what was read. files in the
+// mounted resource pack (FileSystem::mountPack) skip the disk altogether and are decoded from its
+// mapping on the pool.
+//
+// usage:
+//     IoRequest id = AsyncIO::instance().read(path, priority, [](bool ok, std::string& content) { ...worker... });
+//     AsyncIO::instance().setPriority(id, higher);
+//     AsyncIO::instance().cancel(id);    // 'done' still runs, with ok false, unless it already has
+typedef uint64_t IoRequest;
+
+const int IO_PRIORITY_DEFAULT = 0;
+const size_t IO_CHUNK_SIZE = 256 << 10;
+const int IO_QUEUE_DEPTH = 32;
+
+class AsyncIO
+{
+public:
+    typedef std::function<void(bool ok, std::string& content)> Callback;
+
+    static AsyncIO& instance()
+    {
+        static AsyncIO io(true);
+        return io;
+    }
+
+    // useIoUring false always reads on the thread pool, e.g. to compare the two
+    explicit AsyncIO(bool useIoUring)
+    {
+#ifdef ASYNC_IO_URING
+        if (useIoUring)
+            uring = ring.open(IO_QUEUE_DEPTH);
+#else
+        (void)useIoUring;
+#endif
+        // more reads in flight than workers would only move the queue into the pool, out of priority order
+        depth = uring ? IO_QUEUE_DEPTH : (int)ThreadPool::instance().threadCount() + 1;
+        slots.resize(depth);
+        thread = std::thread([this] { run(); });
+    }
+
+    ~AsyncIO()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            for (auto& request : requests)
+                request.second->cancelled = true;
+        }
+        wake();
+        thread.join();
+    }
+
+    AsyncIO(const AsyncIO&) = delete;
+    AsyncIO& operator=(const AsyncIO&) = delete;
+
+    // queues reading the whole file at 'path'. 'done' gets called exactly once, on the thread pool,
+    // with the content, or with ok false if the file can't be read or the request was cancelled
+    IoRequest read(const std::string& path, int priority, Callback done)
+    {
+        if (FileSystem::findInPack(path))
+        {
+            ThreadPool::instance().submit([path, done]() {
+                std::string content;
+                bool ok = FileSystem::readFile(path, content);
+                done(ok, content);
+            });
+            return 0;
+        }
+
+        std::shared_ptr<Request> request = std::make_shared<Request>();
+        request->path = path;
+        request->priority = priority;
+        request->done = std::move(done);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            request->id = request->sequence = ++lastId;
+            requests[request->id] = request;
+            waiting.push_back(request);
+        }
+        wake();
+        return request->id;
+    }
+
+    // moves a request that hasn't finished reading ahead of or behind the others
+    void setPriority(IoRequest id, int priority)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto request = requests.find(id);
+        if (request != requests.end())
+            request->second->priority = priority;
+    }
+
+    // stops reading the file. chunks already in flight still complete, the rest are never issued
+    void cancel(IoRequest id)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto request = requests.find(id);
+            if (request == requests.end())
+                return;
+            request->second->cancelled = true;
+        }
+        wake();
+    }
+
+    // requests that haven't completed yet
+    size_t pendingCount()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return requests.size();
+    }
+
+    uint64_t bytesRead() const { return totalBytes; }
+
+    const char* backendName() const { return uring ? "io_uring" : "thread pool"; }
+
+private:
+#ifdef _WIN32
+    typedef HANDLE FileHandle;
+    static FileHandle invalidFile() { return INVALID_HANDLE_VALUE; }
+#else
+    typedef int FileHandle;
+    static FileHandle invalidFile() { return -1; }
+#endif
+
+    struct Request {
+        IoRequest id = 0;
+        uint64_t sequence = 0;       // ties of priority go first come, first served
+        std::string path;
+        int priority = IO_PRIORITY_DEFAULT;
+        Callback done;
+        FileHandle file = invalidFile();
+        bool opened = false;
+        bool failed = false;
+        bool cancelled = false;
+        std::string content;
+        uint64_t issued = 0;         // bytes handed to chunks so far
+        uint64_t completed = 0;
+        int inFlight = 0;
+    };
+
+    // a read in flight, indexed by its position in 'slots'
+    struct Slot {
+        std::shared_ptr<Request> request;
+        uint64_t offset = 0;
+        size_t size = 0;
+#ifdef ASYNC_IO_URING
+        iovec vector;
+#endif
+    };
+
+    struct Completion {
+        size_t slot;
+        int64_t result;              // bytes read, or negative on error
+    };
+
+#ifdef ASYNC_IO_URING
+    // the submission and completion rings of one io_uring, mapped from the kernel. only the I/O thread
+    // touches them
+    struct Ring {
+        static const uint64_t WAKE_TAG = ~0ull;
+
+        int fd = -1;
+        int wakeFd = -1;             // an eventfd polled through the ring, so submitting a request wakes the I/O thread
+        void* sqMemory = nullptr;
+        void* cqMemory = nullptr;
+        size_t sqMemorySize = 0, cqMemorySize = 0;
+        io_uring_sqe* sqes = nullptr;
+        size_t sqesSize = 0;
+        unsigned *sqHead = nullptr, *sqTail = nullptr, *sqMask = nullptr, *sqArray = nullptr;
+        unsigned *cqHead = nullptr, *cqTail = nullptr, *cqMask = nullptr;
+        io_uring_cqe* cqes = nullptr;
+        unsigned toSubmit = 0;
+
+        ~Ring()
+        {
+            close();
+        }
+
+        bool open(unsigned entries)
+        {
+            io_uring_params params;
+            std::memset(&params, 0, sizeof(params));
+            // room for every chunk plus the wake poll
+            fd = (int)syscall(__NR_io_uring_setup, entries + 1, &params);
+            if (fd < 0)
+                return false;
+            sqMemorySize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cqMemorySize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            if (params.features & IORING_FEAT_SINGLE_MMAP)
+                sqMemorySize = cqMemorySize = std::max(sqMemorySize, cqMemorySize);
+            sqMemory = mmap(nullptr, sqMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+            if (sqMemory == MAP_FAILED)
+            {
+                sqMemory = nullptr;
+                close();
+                return false;
+            }
+            if (params.features & IORING_FEAT_SINGLE_MMAP)
+                cqMemory = sqMemory;
+            else
+            {
+                cqMemory = mmap(nullptr, cqMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+                if (cqMemory == MAP_FAILED)
+                {
+                    cqMemory = nullptr;
+                    close();
+                    return false;
+                }
+            }
+            sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+            void* sqeMemory = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+            if (sqeMemory == MAP_FAILED)
+            {
+                close();
+                return false;
+            }
+            sqes = static_cast<io_uring_sqe*>(sqeMemory);
+
+            char* sq = static_cast<char*>(sqMemory);
+            sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+            sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+            sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+            sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+            char* cq = static_cast<char*>(cqMemory);
+            cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+            cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+            cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+            cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+            wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+            if (wakeFd < 0)
+            {
+                close();
+                return false;
+            }
+            armWake();
+            return true;
+        }
+
+        void close()
+        {
+            if (sqes)
+                munmap(sqes, sqesSize);
+            if (cqMemory && cqMemory != sqMemory)
+                munmap(cqMemory, cqMemorySize);
+            if (sqMemory)
+                munmap(sqMemory, sqMemorySize);
+            if (wakeFd >= 0)
+                ::close(wakeFd);
+            if (fd >= 0)
+                ::close(fd);
+            sqes = nullptr;
+            sqMemory = cqMemory = nullptr;
+            wakeFd = fd = -1;
+        }
+
+        io_uring_sqe* nextSqe(uint64_t tag)
+        {
+            unsigned tail = *sqTail;
+            unsigned index = tail & *sqMask;
+            io_uring_sqe* sqe = &sqes[index];
+            std::memset(sqe, 0, sizeof(*sqe));
+            sqe->user_data = tag;
+            sqArray[index] = index;
+            __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+            toSubmit++;
+            return sqe;
+        }
+
+        void armWake()
+        {
+            io_uring_sqe* sqe = nextSqe(WAKE_TAG);
+            sqe->opcode = IORING_OP_POLL_ADD;
+            sqe->fd = wakeFd;
+            sqe->poll_events = POLLIN;
+        }
+
+        void submitRead(int file, size_t slot, Slot& read)
+        {
+            read.vector.iov_base = &read.request->content[read.offset];
+            read.vector.iov_len = read.size;
+            io_uring_sqe* sqe = nextSqe(slot);
+            sqe->opcode = IORING_OP_READV;
+            sqe->fd = file;
+            sqe->off = read.offset;
+            sqe->addr = reinterpret_cast<uint64_t>(&read.vector);
+            sqe->len = 1;
+        }
+
+        void wake()
+        {
+            uint64_t one = 1;
+            if (::write(wakeFd, &one, sizeof(one)) < 0)
+                return; // the counter is full: the I/O thread has a wake-up pending anyway
+        }
+
+        // submits what was queued and blocks until at least one read completed or wake() was called
+        void wait(std::vector<Completion>& completions)
+        {
+            bool woken = false;
+            while (completions.empty() && !woken)
+            {
+                int result = (int)syscall(__NR_io_uring_enter, fd, toSubmit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+                if (result >= 0)
+                    toSubmit -= std::min<unsigned>(toSubmit, (unsigned)result);
+                else if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+                {
+                    std::cout << "ERROR::ASYNC_IO:: io_uring_enter failed (" << errno << ")" << std::endl;
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+
+                unsigned head = *cqHead;
+                unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+                for (; head != tail; head++)
+                {
+                    const io_uring_cqe& cqe = cqes[head & *cqMask];
+                    if (cqe.user_data == WAKE_TAG)
+                        woken = true;
+                    else
+                        completions.push_back(Completion{ (size_t)cqe.user_data, cqe.res });
+                }
+                __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+            }
+            if (woken)
+            {
+                uint64_t count;
+                if (::read(wakeFd, &count, sizeof(count)) < 0)
+                    count = 0; // nothing to reset
+                armWake();
+            }
+        }
+    };
+
+    Ring ring;
+#endif
+
+    bool uring = false;
+    int depth = 0;
+    std::vector<Slot> slots;
+    std::vector<size_t> freeSlots;
+    std::thread thread;
+
+    std::mutex mutex;
+    std::unordered_map<IoRequest, std::shared_ptr<Request>> requests; // until 'done' is queued
+    std::vector<std::shared_ptr<Request>> waiting;                   // with bytes left to issue
+    IoRequest lastId = 0;
+    bool stopping = false;
+    std::atomic<uint64_t> totalBytes{ 0 };
+
+    // thread pool reads hand their results back through here
+    std::mutex completedMutex;
+    std::condition_variable completedChanged;
+    std::vector<Completion> completedReads;
+    bool woken = false;
+
+    static FileHandle openFile(const std::string& path, uint64_t& size)
+    {
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        LARGE_INTEGER fileSize;
+        if (file != INVALID_HANDLE_VALUE && !GetFileSizeEx(file, &fileSize))
+        {
+            CloseHandle(file);
+            return INVALID_HANDLE_VALUE;
+        }
+        if (file != INVALID_HANDLE_VALUE)
+            size = (uint64_t)fileSize.QuadPart;
+        return file;
+#else
+        int file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat status;
+        if (file >= 0 && fstat(file, &status) != 0)
+        {
+            ::close(file);
+            return -1;
+        }
+        if (file >= 0)
+            size = (uint64_t)status.st_size;
+        return file;
+#endif
+    }
+
+    static void closeFile(FileHandle file)
+    {
+#ifdef _WIN32
+        CloseHandle(file);
+#else
+        ::close(file);
+#endif
+    }
+
+    // a blocking read at 'offset', for the thread pool backend
+    static int64_t readAt(FileHandle file, void* buffer, size_t size, uint64_t offset)
+    {
+#ifdef _WIN32
+        OVERLAPPED overlapped;
+        std::memset(&overlapped, 0, sizeof(overlapped));
+        overlapped.Offset = (DWORD)offset;
+        overlapped.OffsetHigh = (DWORD)(offset >> 32);
+        DWORD read = 0;
+        if (!ReadFile(file, buffer, (DWORD)size, &read, &overlapped))
+            return -1;
+        return read;
+#else
+        return pread(file, buffer, size, (off_t)offset);
+#endif
+    }
+
+    void wake()
+    {
+#ifdef ASYNC_IO_URING
+        if (uring)
+        {
+            ring.wake();
+            return;
+        }
+#endif
+        {
+            std::lock_guard<std::mutex> lock(completedMutex);
+            woken = true;
+        }
+        completedChanged.notify_one();
+    }
+
+    // the waiting request to read from next: highest priority, then oldest. the queue is short (the
+    // textures of the scenes being loaded), so a scan is cheaper than keeping it sorted as priorities change
+    std::shared_ptr<Request> nextRequest()
+    {
+        size_t best = waiting.size();
+        for (size_t i = 0; i < waiting.size(); i++)
+        {
+            const Request& request = *waiting[i];
+            if (request.cancelled || request.failed || (request.opened && request.issued == request.content.size()))
+                continue;
+            if (best == waiting.size() || request.priority > waiting[best]->priority ||
+                (request.priority == waiting[best]->priority && request.sequence < waiting[best]->sequence))
+                best = i;
+        }
+        return best == waiting.size() ? nullptr : waiting[best];
+    }
+
+    void submit(size_t slot)
+    {
+        Slot& read = slots[slot];
+#ifdef ASYNC_IO_URING
+        if (uring)
+        {
+            ring.submitRead(read.request->file, slot, read);
+            return;
+        }
+#endif
+        FileHandle file = read.request->file;
+        unsigned char* buffer = reinterpret_cast<unsigned char*>(&read.request->content[read.offset]);
+        size_t size = read.size;
+        uint64_t offset = read.offset;
+        ThreadPool::instance().submit([this, slot, file, buffer, size, offset]() {
+            PROFILE_ZONE("AsyncIO read");
+            int64_t result = readAt(file, buffer, size, offset);
+            {
+                std::lock_guard<std::mutex> lock(completedMutex);
+                completedReads.push_back(Completion{ slot, result });
+            }
+            completedChanged.notify_one();
+        });
+    }
+
+    // blocks until reads completed or a request came in
+    void waitForCompletions(std::vector<Completion>& completions)
+    {
+#ifdef ASYNC_IO_URING
+        if (uring)
+        {
+            ring.wait(completions);
+            return;
+        }
+#endif
+        std::unique_lock<std::mutex> lock(completedMutex);
+        completedChanged.wait(lock, [this] { return woken || !completedReads.empty(); });
+        woken = false;
+        completions.swap(completedReads);
+    }
+
+    // hands out chunks of the most important requests until every slot is busy. requests that can't be
+    // opened fail here, empty ones finish here. called with the lock held
+    void issue(std::vector<std::shared_ptr<Request>>& finished)
+    {
+        while (!freeSlots.empty())
+        {
+            std::shared_ptr<Request> request = nextRequest();
+            if (!request)
+                break;
+            if (!request->opened)
+            {
+                request->opened = true;
+                uint64_t size = 0;
+                request->file = openFile(request->path, size);
+                if (request->file == invalidFile())
+                {
+                    request->failed = true;
+                    continue;
+                }
+                request->content.resize((size_t)size);
+                if (size == 0)
+                    continue;
+            }
+
+            size_t slot = freeSlots.back();
+            freeSlots.pop_back();
+            Slot& read = slots[slot];
+            read.request = request;
+            read.offset = request->issued;
+            read.size = (size_t)std::min<uint64_t>(IO_CHUNK_SIZE, request->content.size() - request->issued);
+            request->issued += read.size;
+            request->inFlight++;
+            submit(slot);
+        }
+
+        // what can't be read any further and has nothing in flight is done
+        for (size_t i = 0; i < waiting.size();)
+        {
+            Request& request = *waiting[i];
+            bool complete = request.opened && !request.failed && request.completed == request.content.size();
+            if (request.inFlight == 0 && (request.cancelled || request.failed || complete))
+            {
+                finished.push_back(waiting[i]);
+                waiting[i] = waiting.back();
+                waiting.pop_back();
+            }
+            else
+                i++;
+        }
+    }
+
+    // a read came back: short reads continue where they stopped, errors fail the request
+    void complete(const Completion& completion, std::vector<std::shared_ptr<Request>>& finished)
+    {
+        Slot& read = slots[completion.slot];
+        std::shared_ptr<Request> request = read.request;
+        if (completion.result > 0 && (size_t)completion.result < read.size && !request->cancelled)
+        {
+            totalBytes += (uint64_t)completion.result;
+            request->completed += (uint64_t)completion.result;
+            read.offset += (uint64_t)completion.result;
+            read.size -= (size_t)completion.result;
+            submit(completion.slot);
+            return;
+        }
+        if (completion.result <= 0)
+            request->failed = true; // an error, or the file got shorter since it was opened
+        else
+        {
+            totalBytes += (uint64_t)completion.result;
+            request->completed += (uint64_t)completion.result;
+        }
+        request->inFlight--;
+        read.request.reset();
+        freeSlots.push_back(completion.slot);
+
+        bool complete = !request->failed && request->completed == request->content.size();
+        if (request->inFlight == 0 && (request->cancelled || request->failed || complete))
+        {
+            auto waits = std::find(waiting.begin(), waiting.end(), request);
+            if (waits != waiting.end())
+                waiting.erase(waits);
+            finished.push_back(request);
+        }
+    }
+
+    void run()
+    {
+        Profiler::instance().setThreadName("async io");
+        for (size_t slot = 0; slot < slots.size(); slot++)
+            freeSlots.push_back(slots.size() - 1 - slot);
+
+        std::vector<Completion> completions;
+        std::vector<std::shared_ptr<Request>> finished;
+        for (;;)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (const Completion& completion : completions)
+                    complete(completion, finished);
+                completions.clear();
+                issue(finished);
+                for (const std::shared_ptr<Request>& request : finished)
+                    requests.erase(request->id);
+                if (stopping && requests.empty() && freeSlots.size() == slots.size())
+                    break;
+            }
+
+            for (std::shared_ptr<Request>& request : finished)
+            {
+                if (request->file != invalidFile())
+                    closeFile(request->file);
+                bool ok = !request->cancelled && !request->failed;
+                if (!ok)
+                    request->content.clear();
+                ThreadPool::instance().submit([request, ok]() {
+                    request->done(ok, request->content);
+                });
+            }
+            finished.clear();
+            waitForCompletions(completions);
+        }
+
+        for (std::shared_ptr<Request>& request : finished)
+        {
+            if (request->file != invalidFile())
+                closeFile(request->file);
+            std::string none;
+            request->done(false, none);
+        }
+    }
+};
+#endif
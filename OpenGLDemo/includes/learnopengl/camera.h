@@ -24,6 +24,13 @@ const float SPEED       =  2.5f;
 const float SENSITIVITY =  0.1f;
 const float ZOOM        =  45.0f;
 
+// the minimal state needed to reproduce a view, used to drive the camera without input (benchmarks, replays)
+struct CameraPose {
+    glm::vec3 Position;
+    float Yaw;
+    float Pitch;
+    float Zoom;
+};
 
 // An abstract camera class that processes input and calculates the corresponding Euler Angles, Vectors and Matrices for use in OpenGL
 class Camera
@@ -122,6 +129,22 @@ public:
         return Zoom;
     }
 
+    // returns the current view as a pose
+    CameraPose GetPose() const
+    {
+        return CameraPose{ Position, Yaw, Pitch, Zoom };
+    }
+
+    // jumps straight to the given pose, bypassing movement speed and mouse sensitivity
+    void SetPose(const CameraPose& pose)
+    {
+        Position = pose.Position;
+        Yaw = pose.Yaw;
+        Pitch = pose.Pitch;
+        Zoom = pose.Zoom;
+        updateCameraVectors();
+    }
+
 private:
     // calculates the front vector from the Camera's (updated) Euler Angles
     void updateCameraVectors()
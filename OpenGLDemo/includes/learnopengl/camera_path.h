@@ -0,0 +1,131 @@
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+#include <learnopengl/camera.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Recorded camera paths, so a run can be replayed frame for frame. The file is a small header followed
+// by one pose per frame:
+//
+//     char[4]  magic "CAMP"
+//     uint32   version
+//     float    timestep    seconds per frame used on replay
+//     uint32   frame count
+//     frame count * { float position[3], yaw, pitch, zoom }    (24 bytes per frame)
+//
+// everything little endian, as written by the machines we record on.
+
+const char CAMERA_PATH_MAGIC[4] = { 'C', 'A', 'M', 'P' };
+const uint32_t CAMERA_PATH_VERSION = 1;
+
+struct CameraPathFrame {
+    float position[3];
+    float yaw;
+    float pitch;
+    float zoom;
+};
+
+// appends one pose per frame to a file, the frame count in the header is patched on close
+class CameraPathRecorder
+{
+public:
+    ~CameraPathRecorder()
+    {
+        close();
+    }
+
+    bool open(const std::string& path, float timestep)
+    {
+        close();
+        file = std::fopen(path.c_str(), "wb");
+        if (!file)
+        {
+            std::cout << "ERROR::CAMERA_PATH:: could not create " << path << std::endl;
+            return false;
+        }
+        frameCount = 0;
+        uint32_t count = 0;
+        std::fwrite(CAMERA_PATH_MAGIC, 1, 4, file);
+        std::fwrite(&CAMERA_PATH_VERSION, sizeof(uint32_t), 1, file);
+        std::fwrite(&timestep, sizeof(float), 1, file);
+        std::fwrite(&count, sizeof(uint32_t), 1, file);
+        return true;
+    }
+
+    bool isOpen() const { return file != nullptr; }
+
+    void record(const CameraPose& pose)
+    {
+        if (!file)
+            return;
+        CameraPathFrame frame = { { pose.Position.x, pose.Position.y, pose.Position.z }, pose.Yaw, pose.Pitch, pose.Zoom };
+        std::fwrite(&frame, sizeof(CameraPathFrame), 1, file);
+        frameCount++;
+    }
+
+    void close()
+    {
+        if (!file)
+            return;
+        std::fseek(file, 12, SEEK_SET);
+        std::fwrite(&frameCount, sizeof(uint32_t), 1, file);
+        std::fclose(file);
+        file = nullptr;
+        std::cout << "CAMERA_PATH:: recorded " << frameCount << " frames" << std::endl;
+    }
+
+private:
+    std::FILE* file = nullptr;
+    uint32_t frameCount = 0;
+};
+
+// a recorded path loaded in full, frame N is always the same pose
+class CameraPath
+{
+public:
+    float timestep = 1.0f / 60.0f;
+
+    bool load(const std::string& path)
+    {
+        std::FILE* file = std::fopen(path.c_str(), "rb");
+        if (!file)
+        {
+            std::cout << "ERROR::CAMERA_PATH:: could not open " << path << std::endl;
+            return false;
+        }
+        char magic[4];
+        uint32_t version = 0, count = 0;
+        bool valid = std::fread(magic, 1, 4, file) == 4 && std::equal(magic, magic + 4, CAMERA_PATH_MAGIC)
+            && std::fread(&version, sizeof(uint32_t), 1, file) == 1 && version == CAMERA_PATH_VERSION
+            && std::fread(&timestep, sizeof(float), 1, file) == 1
+            && std::fread(&count, sizeof(uint32_t), 1, file) == 1;
+        std::vector<CameraPathFrame> frames(count);
+        valid = valid && count > 0 && std::fread(frames.data(), sizeof(CameraPathFrame), count, file) == count;
+        std::fclose(file);
+        if (!valid)
+        {
+            std::cout << "ERROR::CAMERA_PATH:: " << path << " is not a valid camera path" << std::endl;
+            return false;
+        }
+
+        poses.clear();
+        poses.reserve(count);
+        for (const CameraPathFrame& frame : frames)
+            poses.push_back(CameraPose{ glm::vec3(frame.position[0], frame.position[1], frame.position[2]), frame.yaw, frame.pitch, frame.zoom });
+        return true;
+    }
+
+    size_t size() const { return poses.size(); }
+    const CameraPose& pose(size_t frame) const { return poses[frame % poses.size()]; }
+    const std::vector<CameraPose>& allPoses() const { return poses; }
+
+private:
+    std::vector<CameraPose> poses;
+};
+#endif
@@ -0,0 +1,277 @@
+#ifndef CONE_STEP_MAP_H
+#define CONE_STEP_MAP_H
+
+#include <glad/glad.h>
+
+#include <stb_image.h>
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/hash.h>
+#include <learnopengl/mapped_file.h>
+#include <learnopengl/profiler.h>
+#include <learnopengl/texture_streamer.h>
+#include <learnopengl/thread_pool.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Relaxed cone step maps (Policarpo and Oliveira, "Relaxed Cone Stepping for Relief Mapping", GPU Gems 3)
+// turn a depth map (*_disp: 0 is the top of the surface, 1 the deepest point) into the input of a relief
+// mapping shader that finds where a view ray hits the surface in a handful of steps instead of the dozens
+// of fixed steps of parallax occlusion mapping.
+//
+// every texel stores its depth and the ratio (radius over depth) of the widest cone, with its apex on the
+// surface at that texel and opening upwards, that a ray entering it from the top crosses into the solid
+// at most once. a ray can then safely step to where it meets the cone of the texel below it; the relaxed
+// cone lets it end up inside the solid, where a short binary search between its last two positions finds
+// the surface.
+//
+// the map is computed on the thread pool from the 8 bit depths and cached next to the image as
+// <image>.cone, valid while the image's hash matches. it holds two channels: the depth, and the square
+// root of the cone ratio over CONE_STEP_MAX_RATIO, which keeps more of the 8 bits for the narrow cones
+// that matter. the shader side (relief_geometry.fs):
+//     vec2 texel = textureLod(coneStepMap, uv, 0.0).rg;
+//     float depth = texel.r, coneRatio = texel.g * texel.g * CONE_STEP_MAX_RATIO;
+
+const uint32_t CONE_STEP_CACHE_VERSION = 1;
+const float CONE_STEP_MAX_RATIO = 1.0f;
+const int CONE_STEP_ROWS_PER_TASK = 8;
+
+// the cone step map of the image at 'path'
+std::string coneStepCachePath(const std::string& path)
+{
+    return path + ".cone";
+}
+
+// the relaxed cone ratio of the texel at (x, y), in texture coordinates over depth. 'depths' wraps at the
+// edges, like the repeating texture it is sampled as.
+//
+// for every texel D above it (the ones below can't block the view of it), the ray from the top of this
+// texel through the surface at D is followed on into the solid until it leaves it again; the cone must
+// stay clear of that exit point, unless it is deeper than this texel. texels are visited ring by ring
+// outwards, and the search stops once even the nearest texel of a ring can't narrow the cone any further
+float relaxedConeRatio(const std::vector<float>& depths, int width, int height, int x, int y)
+{
+    float depth = depths[(size_t)y * width + x];
+    float best = CONE_STEP_MAX_RATIO;
+    if (depth <= 0.0f)
+        return best;
+    const float scaleX = 1.0f / width, scaleY = 1.0f / height;
+    const float nearest = std::min(scaleX, scaleY);
+    // a ray over the top surface has to sink a little to get anywhere
+    const float minimumDepth = 0.5f / 255.0f;
+    int maxRing = std::max(width, height) / 2;
+    for (int ring = 1; ring <= maxRing && ring * nearest < best * depth; ring++)
+    {
+        for (int j = -ring; j <= ring; j++)
+        {
+            // the whole top and bottom rows of the ring, only the ends of the others
+            int stride = (j == -ring || j == ring) ? 1 : 2 * ring;
+            for (int i = -ring; i <= ring; i += stride)
+            {
+                int dx = (x + i) & (width - 1), dy = (y + j) & (height - 1);
+                float through = depths[(size_t)dy * width + dx];
+                if (through >= depth)
+                    continue;
+                through = std::max(through, minimumDepth);
+
+                // one texel sideways per step, sinking by as much as the ray does over that distance
+                float length = std::sqrt((float)(i * i + j * j));
+                float stepX = i / length, stepY = j / length, stepZ = through / length;
+                float px = (float)(x + i), py = (float)(y + j), pz = through;
+                for (;;)
+                {
+                    px += stepX;
+                    py += stepY;
+                    pz += stepZ;
+                    if (pz >= depth)
+                        break; // still inside when it gets to this texel's depth: no limit
+                    float ox = (px - x) * scaleX, oy = (py - y) * scaleY;
+                    float ratio = std::sqrt(ox * ox + oy * oy) / (depth - pz);
+                    if (ratio >= best)
+                        break; // only widens from here
+                    int sx = (int)std::floor(px + 0.5f) & (width - 1), sy = (int)std::floor(py + 0.5f) & (height - 1);
+                    if (depths[(size_t)sy * width + sx] > pz)
+                    {
+                        best = ratio; // out of the solid again
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    return best;
+}
+
+// the relief map (depth, cone) of an 8 bit depth map whose sides are powers of two, as 2 byte texels.
+// 'parallel' spreads the rows over the thread pool
+bool computeConeStepMap(const unsigned char* depths, int width, int height, std::vector<unsigned char>& relief, bool parallel = true)
+{
+    PROFILE_ZONE("computeConeStepMap");
+    if (width <= 0 || height <= 0 || (width & (width - 1)) != 0 || (height & (height - 1)) != 0)
+    {
+        std::cout << "ERROR::CONE_STEP_MAP:: depth maps must be a power of two in size, not " << width << "x" << height << std::endl;
+        return false;
+    }
+    std::vector<float> normalized((size_t)width * height);
+    for (size_t i = 0; i < normalized.size(); i++)
+        normalized[i] = depths[i] / 255.0f;
+
+    relief.resize((size_t)width * height * 2);
+    auto rows = [&](size_t task) {
+        int first = (int)task * CONE_STEP_ROWS_PER_TASK, last = std::min(height, first + CONE_STEP_ROWS_PER_TASK);
+        for (int y = first; y < last; y++)
+            for (int x = 0; x < width; x++)
+            {
+                size_t i = (size_t)y * width + x;
+                float ratio = relaxedConeRatio(normalized, width, height, x, y);
+                relief[i * 2] = depths[i];
+                relief[i * 2 + 1] = (unsigned char)std::min(255.0f, std::sqrt(ratio / CONE_STEP_MAX_RATIO) * 255.0f + 0.5f);
+            }
+    };
+    size_t tasks = (size_t)(height + CONE_STEP_ROWS_PER_TASK - 1) / CONE_STEP_ROWS_PER_TASK;
+    if (parallel)
+        ThreadPool::instance().parallelFor(tasks, rows);
+    else
+        for (size_t task = 0; task < tasks; task++)
+            rows(task);
+    return true;
+}
+
+struct ConeStepCacheHeader {
+    char magic[4];          // "LCSM"
+    uint32_t version;
+    uint64_t sourceHash;
+    uint32_t width;
+    uint32_t height;
+};
+
+bool readConeStepCache(const std::string& path, uint64_t sourceHash, std::vector<unsigned char>& relief, int& width, int& height)
+{
+    PROFILE_ZONE("readConeStepCache");
+    MappedFile file;
+    if (!file.open(path) || file.size() < sizeof(ConeStepCacheHeader))
+        return false;
+    ConeStepCacheHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, "LCSM", 4) != 0 || header.version != CONE_STEP_CACHE_VERSION || header.sourceHash != sourceHash
+        || file.size() != sizeof(header) + (size_t)header.width * header.height * 2)
+        return false;
+    width = (int)header.width;
+    height = (int)header.height;
+    relief.assign(file.data() + sizeof(header), file.data() + file.size());
+    return true;
+}
+
+bool writeConeStepCache(const std::string& path, uint64_t sourceHash, const std::vector<unsigned char>& relief, int width, int height)
+{
+    PROFILE_ZONE("writeConeStepCache");
+    ConeStepCacheHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "LCSM", 4);
+    header.version = CONE_STEP_CACHE_VERSION;
+    header.sourceHash = sourceHash;
+    header.width = (uint32_t)width;
+    header.height = (uint32_t)height;
+
+    // written aside and renamed, so a reader never sees half a file
+    std::string temporary = path + ".tmp";
+    std::ofstream out(temporary, std::ios::binary);
+    if (!out)
+    {
+        std::cout << "ERROR::CONE_STEP_MAP:: could not write " << temporary << std::endl;
+        return false;
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(relief.data()), (std::streamsize)relief.size());
+    out.close();
+    if (!out)
+    {
+        std::cout << "ERROR::CONE_STEP_MAP:: could not write " << temporary << std::endl;
+        std::remove(temporary.c_str());
+        return false;
+    }
+    std::remove(path.c_str()); // rename doesn't replace existing files on windows
+    if (std::rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        std::cout << "ERROR::CONE_STEP_MAP:: could not replace " << path << std::endl;
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+// the relief map of the depth map at 'path', from its cache if still valid, computed and cached otherwise.
+// fromCache, if given, tells which
+bool cookConeStepMap(const std::string& path, std::vector<unsigned char>& relief, int& width, int& height, bool* fromCache = nullptr)
+{
+    PROFILE_ZONE("cookConeStepMap");
+    std::string source;
+    if (!FileSystem::readFile(path, source))
+    {
+        std::cout << "ERROR::CONE_STEP_MAP:: could not read " << path << std::endl;
+        return false;
+    }
+    uint64_t hash = fnv1a(&CONE_STEP_CACHE_VERSION, sizeof(CONE_STEP_CACHE_VERSION));
+    hash = fnv1a(source.data(), source.size(), hash);
+    std::string cache = coneStepCachePath(path);
+    bool cached = readConeStepCache(cache, hash, relief, width, height);
+    if (fromCache)
+        *fromCache = cached;
+    if (cached)
+        return true;
+
+    int components = 0;
+    unsigned char* depths = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(source.data()), (int)source.size(), &width, &height, &components, 1);
+    if (!depths)
+    {
+        std::cout << "ERROR::CONE_STEP_MAP:: could not decode " << path << std::endl;
+        return false;
+    }
+    bool computed = computeConeStepMap(depths, width, height, relief);
+    stbi_image_free(depths);
+    if (computed)
+        writeConeStepCache(cache, hash, relief, width, height);
+    return computed;
+}
+
+// the relief map of a depth map as a repeating two channel texture without mips, cooked on the thread pool
+// and streamed in like other textures. until it arrives the surface samples as flat
+class ConeStepMap
+{
+public:
+    unsigned int texture = 0;
+
+    explicit ConeStepMap(const std::string& path)
+    {
+        static const unsigned char FLAT[4] = { 0, 255, 0, 255 };
+        texture = TextureStreamer::instance().requestGenerated("cone step map " + path,
+            [path](int& width, int& height, int& components) -> unsigned char* {
+                std::vector<unsigned char> relief;
+                if (!cookConeStepMap(path, relief, width, height))
+                    return nullptr;
+                components = 2;
+                unsigned char* pixels = static_cast<unsigned char*>(std::malloc(relief.size()));
+                std::memcpy(pixels, relief.data(), relief.size());
+                return pixels;
+            }, 0, GL_REPEAT, FLAT);
+    }
+
+    ~ConeStepMap()
+    {
+        TextureStreamer::instance().cancel(texture);
+        glDeleteTextures(1, &texture);
+    }
+
+    ConeStepMap(const ConeStepMap&) = delete;
+    ConeStepMap& operator=(const ConeStepMap&) = delete;
+};
+#endif
@@ -0,0 +1,265 @@
+#ifndef CUBEMAP_H
+#define CUBEMAP_H
+
+#include <glad/glad.h>
+
+#include <stb_image.h>
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/profiler.h>
+#include <learnopengl/texture_compressor.h>
+#include <learnopengl/texture_streamer.h>
+#include <learnopengl/thread_pool.h>
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Cubemaps from six face images (a skybox), and the immutable storage every cubemap is created with.
+//
+// CubemapLoader decodes the faces on the thread pool, one task per face, instead of one after the other
+// on the main thread. with compression on (and S3TC in the driver) each face goes through
+// TextureCompressor, so it is cooked once into a BC1 mip chain cached as <face>.dds and read straight from
+// that cache afterwards: a 2048 pixel skybox takes 16 MB instead of 96 MB with its mips. the texture is
+// allocated in one go with glTexStorage2D where GL 4.2 is available, so the driver never has to check the
+// faces and levels for completeness.
+//
+// OpenGL only in createCubemapStorage, uploadCubemapFace and CubemapLoader::update.
+
+// skybox face names in GL order (+X -X +Y -Y +Z -Z), as "<directory>/<name>.jpg"
+const char* const CUBEMAP_FACE_NAMES[6] = { "right", "left", "top", "bottom", "front", "back" };
+
+// mips of a size x size face down to 1x1
+int cubemapLevelCount(int size)
+{
+    int levels = 1;
+    while (size > 1)
+    {
+        size >>= 1;
+        levels++;
+    }
+    return levels;
+}
+
+// a cubemap with 'levels' mips of size x size faces, left bound. immutable storage where the driver has
+// it; below GL 4.2 each level is allocated by the first uploadCubemapFace to it
+unsigned int createCubemapStorage(GLenum internalFormat, int size, int levels)
+{
+    unsigned int texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+    if (GLAD_GL_VERSION_4_2)
+        glTexStorage2D(GL_TEXTURE_CUBE_MAP, levels, internalFormat, size, size);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    return texture;
+}
+
+// one face of one level of the bound cubemap from createCubemapStorage. 'compressedSize' > 0 means the
+// pixels are blocks of 'internalFormat', otherwise they are in 'format' and 'type'
+void uploadCubemapFace(int face, int level, GLenum internalFormat, int size, const void* pixels, GLenum format, GLenum type, size_t compressedSize = 0)
+{
+    GLenum target = GL_TEXTURE_CUBE_MAP_POSITIVE_X + face;
+    if (compressedSize > 0 && GLAD_GL_VERSION_4_2)
+        glCompressedTexSubImage2D(target, level, 0, 0, size, size, internalFormat, (GLsizei)compressedSize, pixels);
+    else if (compressedSize > 0)
+        glCompressedTexImage2D(target, level, internalFormat, size, size, 0, (GLsizei)compressedSize, pixels);
+    else if (GLAD_GL_VERSION_4_2)
+        glTexSubImage2D(target, level, 0, 0, size, size, format, type, pixels);
+    else
+        glTexImage2D(target, level, internalFormat, size, size, 0, format, type, pixels);
+}
+
+// loads a cubemap from six images in the background and uploads it once they are decoded:
+//     loader.start(faces);
+//     every frame: if (loader.update()) ... loader.texture just became available
+class CubemapLoader
+{
+public:
+    unsigned int texture = 0;
+
+    ~CubemapLoader()
+    {
+        if (job)
+            job->cancelled = true;
+        glDeleteTextures(1, &texture);
+    }
+
+    // the six faces of "<directory>/<name><extension>" in CUBEMAP_FACE_NAMES order
+    static std::vector<std::string> facePaths(const std::string& directory, const std::string& extension = ".jpg")
+    {
+        std::vector<std::string> paths;
+        for (const char* name : CUBEMAP_FACE_NAMES)
+            paths.push_back(directory + "/" + name + extension);
+        return paths;
+    }
+
+    // starts loading the faces (GL order), once. 'compress' cooks them into BC1 if the driver samples it
+    // (GL thread, it asks the driver)
+    void start(const std::vector<std::string>& faces, bool compress = true)
+    {
+        if (job || faces.size() != 6)
+            return;
+        job = std::make_shared<Job>();
+        job->compress = compress && TextureStreamer::instance().compressionSupported(false);
+        std::shared_ptr<Job> running = job;
+        ThreadPool::instance().submit([running, faces]() {
+            std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+            ThreadPool::instance().parallelFor(6, [&](size_t face) {
+                if (!running->cancelled)
+                    running->faces[face].load(faces[face], running->compress);
+            });
+            running->loaded = !running->cancelled && running->check(faces);
+            running->milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+            running->done = true;
+        });
+    }
+
+    bool started() const { return job != nullptr; }
+    bool ready() const { return uploaded; }
+    bool failed() const { return job && job->done && !job->loaded; }
+    // how long decoding took, how big the faces are and whether they were compressed, once ready
+    double milliseconds() const { return job ? job->milliseconds : 0.0; }
+    int size() const { return faceSize; }
+    bool compressed() const { return codec != TEXTURE_CODEC_NONE; }
+    size_t bytes() const { return textureBytes; }
+
+    // uploads the cubemap once the faces are in, returns true on that call (GL thread)
+    bool update()
+    {
+        if (!job || uploaded || !job->done || !job->loaded)
+            return false;
+        PROFILE_ZONE("CubemapLoader upload");
+        Face* faces = job->faces;
+        faceSize = faces[0].width;
+        codec = faces[0].compressed.codec;
+        textureBytes = 0;
+        glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+        if (codec != TEXTURE_CODEC_NONE)
+        {
+            // the cooked mip chains, all faces of a level before the next level
+            GLenum format = TextureStreamer::compressedFormat(codec, false);
+            int levels = faces[0].compressed.levelCount();
+            texture = createCubemapStorage(format, faceSize, levels);
+            for (int level = 0; level < levels; level++)
+                for (int face = 0; face < 6; face++)
+                {
+                    const CompressedTexture& cooked = faces[face].compressed;
+                    uploadCubemapFace(face, level, format, cooked.levelWidth(level), cooked.level(level), GL_NONE, GL_NONE, cooked.levelSize(level));
+                    textureBytes += cooked.levelSize(level);
+                }
+        }
+        else
+        {
+            // the decoded faces, mips generated by the driver
+            int levels = cubemapLevelCount(faceSize);
+            texture = createCubemapStorage(GL_RGB8, faceSize, levels);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            for (int face = 0; face < 6; face++)
+                uploadCubemapFace(face, 0, GL_RGB8, faceSize, faces[face].pixels, GL_RGB, GL_UNSIGNED_BYTE);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+            textureBytes = (size_t)faceSize * faceSize * 3 * 6 * 4 / 3;
+        }
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        // the texture holds them now
+        for (int face = 0; face < 6; face++)
+            faces[face].clear();
+        uploaded = true;
+        return true;
+    }
+
+    // blocks until loading is done and uploads, e.g. before a benchmark
+    void finish()
+    {
+        if (!job)
+            return;
+        while (!job->done)
+            std::this_thread::yield();
+        update();
+    }
+
+private:
+    // a face's cooked mip chain, or its decoded RGB pixels when it isn't compressed
+    struct Face {
+        CompressedTexture compressed;
+        unsigned char* pixels = nullptr;
+        int width = 0, height = 0;
+
+        ~Face() { clear(); }
+
+        void load(const std::string& path, bool compress)
+        {
+            PROFILE_ZONE("CubemapLoader face");
+            int components = 0;
+            if (compress && TextureCompressor::load(path, compressed, pixels, width, height, components))
+            {
+                width = compressed.width;
+                height = compressed.height;
+                return;
+            }
+            // not compressed: decoded again as RGB if the compressor's try left other channels
+            compressed.clear();
+            if (pixels && components == 3)
+                return;
+            if (pixels)
+                stbi_image_free(pixels);
+            pixels = nullptr;
+            std::string source;
+            if (FileSystem::readFile(path, source))
+                pixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(source.data()), (int)source.size(), &width, &height, &components, 3);
+        }
+
+        void clear()
+        {
+            compressed.clear();
+            if (pixels)
+                stbi_image_free(pixels);
+            pixels = nullptr;
+        }
+    };
+
+    struct Job {
+        Face faces[6];
+        bool compress = false;
+        bool loaded = false;
+        double milliseconds = 0.0;
+        std::atomic<bool> done{ false };
+        std::atomic<bool> cancelled{ false };
+
+        // every face loaded, square, and like the first one
+        bool check(const std::vector<std::string>& paths) const
+        {
+            for (int face = 0; face < 6; face++)
+            {
+                const Face& f = faces[face];
+                if (f.compressed.codec == TEXTURE_CODEC_NONE && !f.pixels)
+                {
+                    std::cout << "ERROR::CUBEMAP:: could not load " << paths[face] << std::endl;
+                    return false;
+                }
+                if (f.width != f.height || f.width != faces[0].width || f.compressed.codec != faces[0].compressed.codec
+                    || f.compressed.levelCount() != faces[0].compressed.levelCount())
+                {
+                    std::cout << "ERROR::CUBEMAP:: " << paths[face] << " doesn't match the other faces (square, same size and format)" << std::endl;
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+    std::shared_ptr<Job> job;
+    bool uploaded = false;
+    int faceSize = 0;
+    TextureCodec codec = TEXTURE_CODEC_NONE;
+    size_t textureBytes = 0;
+};
+#endif
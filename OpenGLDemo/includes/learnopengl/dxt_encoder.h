@@ -0,0 +1,298 @@
+#ifndef DXT_ENCODER_H
+#define DXT_ENCODER_H
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DXT_ENCODER_SSE
+#endif
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// The kernels texture cooking spends its time in: BC1 color and BC4 alpha block encoding and the 2x2 box
+// filter between mips. They give the same bits as image_DXT's compress_DDS_color_block and
+// compress_DDS_alpha_block and image_helper's mipmap_image (kept as the reference, see src/Tools/TextureCook),
+// but work on the 16 pixels of a block 4 at a time and on 2 pixels of a mip row per step with SSE2 where
+// available. The integer sums are exact, and the float math keeps the reference's order of operations.
+//
+// blocks are 4x4 RGBA, row by row; no threading in here, callers split images by rows.
+
+// 8 bit to 'bits' bit with rounding, as image_DXT's convert_bit_range
+int dxtConvertBitRange(int c, int fromBits, int toBits)
+{
+    int b = (1 << (fromBits - 1)) + c * ((1 << toBits) - 1);
+    return (b + (b >> fromBits)) >> fromBits;
+}
+
+int dxtRgbTo565(int r, int g, int b)
+{
+    return (dxtConvertBitRange(r, 8, 5) << 11) | (dxtConvertBitRange(g, 8, 6) << 5) | dxtConvertBitRange(b, 8, 5);
+}
+
+void dxtRgbFrom565(int c, int rgb[3])
+{
+    rgb[0] = dxtConvertBitRange((c >> 11) & 31, 5, 8);
+    rgb[1] = dxtConvertBitRange((c >> 5) & 63, 6, 8);
+    rgb[2] = dxtConvertBitRange(c & 31, 5, 8);
+}
+
+// BC1: the two endpoints from the principal axis of the block's colors (3 power iterations on the
+// covariance matrix), every pixel projected onto the line between them. alpha is ignored
+void encodeColorBlock(const unsigned char block[64], unsigned char out[8])
+{
+    // the channels as floats, and the sums of the channels and their products. every sum stays below 2^24,
+    // so the float sums are exact whatever the order
+    alignas(16) float r[16], g[16], b[16];
+    float sums[9]; // r, g, b, rr, gg, bb, rg, rb, gb
+#ifdef DXT_ENCODER_SSE
+    {
+        const __m128i mask = _mm_set1_epi32(255);
+        __m128 total[9];
+        for (int k = 0; k < 9; k++)
+            total[k] = _mm_setzero_ps();
+        for (int i = 0; i < 16; i += 4)
+        {
+            __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i * 4));
+            __m128 vr = _mm_cvtepi32_ps(_mm_and_si128(pixels, mask));
+            __m128 vg = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixels, 8), mask));
+            __m128 vb = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixels, 16), mask));
+            _mm_store_ps(r + i, vr);
+            _mm_store_ps(g + i, vg);
+            _mm_store_ps(b + i, vb);
+            total[0] = _mm_add_ps(total[0], vr);
+            total[1] = _mm_add_ps(total[1], vg);
+            total[2] = _mm_add_ps(total[2], vb);
+            total[3] = _mm_add_ps(total[3], _mm_mul_ps(vr, vr));
+            total[4] = _mm_add_ps(total[4], _mm_mul_ps(vg, vg));
+            total[5] = _mm_add_ps(total[5], _mm_mul_ps(vb, vb));
+            total[6] = _mm_add_ps(total[6], _mm_mul_ps(vr, vg));
+            total[7] = _mm_add_ps(total[7], _mm_mul_ps(vr, vb));
+            total[8] = _mm_add_ps(total[8], _mm_mul_ps(vg, vb));
+        }
+        for (int k = 0; k < 9; k++)
+        {
+            __m128 t = _mm_add_ps(total[k], _mm_movehl_ps(total[k], total[k]));
+            sums[k] = _mm_cvtss_f32(_mm_add_ss(t, _mm_shuffle_ps(t, t, 1)));
+        }
+    }
+#else
+    for (int k = 0; k < 9; k++)
+        sums[k] = 0.0f;
+    for (int i = 0; i < 16; i++)
+    {
+        r[i] = (float)block[i * 4 + 0];
+        g[i] = (float)block[i * 4 + 1];
+        b[i] = (float)block[i * 4 + 2];
+        sums[0] += r[i]; sums[1] += g[i]; sums[2] += b[i];
+        sums[3] += r[i] * r[i]; sums[4] += g[i] * g[i]; sums[5] += b[i] * b[i];
+        sums[6] += r[i] * g[i]; sums[7] += r[i] * b[i]; sums[8] += g[i] * b[i];
+    }
+#endif
+
+    // covariance matrix around the mean
+    float point[3] = { sums[0] * (1.0f / 16.0f), sums[1] * (1.0f / 16.0f), sums[2] * (1.0f / 16.0f) };
+    float rr = sums[3] - 16.0f * point[0] * point[0];
+    float gg = sums[4] - 16.0f * point[1] * point[1];
+    float bb = sums[5] - 16.0f * point[2] * point[2];
+    float rg = sums[6] - 16.0f * point[0] * point[1];
+    float rb = sums[7] - 16.0f * point[0] * point[2];
+    float gb = sums[8] - 16.0f * point[1] * point[2];
+    float direction[3] = { 1.0f, 2.718281828f, 3.141592654f };
+    for (int iteration = 0; iteration < 3; iteration++)
+    {
+        float x = direction[0], y = direction[1], z = direction[2];
+        direction[0] = x * rr + y * rg + z * rb;
+        direction[1] = x * rg + y * gg + z * gb;
+        direction[2] = x * rb + y * gb + z * bb;
+    }
+    float lengthInverse = 1.0f / (0.00001f + direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+
+    // extent of the block along the axis
+    float dotMin, dotMax;
+#ifdef DXT_ENCODER_SSE
+    {
+        __m128 dx = _mm_set1_ps(direction[0]), dy = _mm_set1_ps(direction[1]), dz = _mm_set1_ps(direction[2]);
+        __m128 low = _mm_set1_ps(3.4e38f), high = _mm_set1_ps(-3.4e38f);
+        for (int i = 0; i < 16; i += 4)
+        {
+            __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, _mm_load_ps(r + i)), _mm_mul_ps(dy, _mm_load_ps(g + i))), _mm_mul_ps(dz, _mm_load_ps(b + i)));
+            low = _mm_min_ps(low, dot);
+            high = _mm_max_ps(high, dot);
+        }
+        low = _mm_min_ps(low, _mm_shuffle_ps(low, low, _MM_SHUFFLE(1, 0, 3, 2)));
+        low = _mm_min_ps(low, _mm_shuffle_ps(low, low, _MM_SHUFFLE(2, 3, 0, 1)));
+        high = _mm_max_ps(high, _mm_shuffle_ps(high, high, _MM_SHUFFLE(1, 0, 3, 2)));
+        high = _mm_max_ps(high, _mm_shuffle_ps(high, high, _MM_SHUFFLE(2, 3, 0, 1)));
+        dotMin = _mm_cvtss_f32(low);
+        dotMax = _mm_cvtss_f32(high);
+    }
+#else
+    dotMin = dotMax = direction[0] * r[0] + direction[1] * g[0] + direction[2] * b[0];
+    for (int i = 1; i < 16; i++)
+    {
+        float dot = direction[0] * r[i] + direction[1] * g[i] + direction[2] * b[i];
+        dotMin = std::min(dotMin, dot);
+        dotMax = std::max(dotMax, dot);
+    }
+#endif
+    float offset = direction[0] * point[0] + direction[1] * point[1] + direction[2] * point[2];
+    dotMin = (dotMin - offset) * lengthInverse;
+    dotMax = (dotMax - offset) * lengthInverse;
+
+    int c0[3], c1[3];
+    for (int i = 0; i < 3; i++)
+    {
+        c0[i] = std::min(255, std::max(0, (int)(0.5f + point[i] + dotMax * direction[i])));
+        c1[i] = std::min(255, std::max(0, (int)(0.5f + point[i] + dotMin * direction[i])));
+    }
+    int encoded0 = dxtRgbTo565(c0[0], c0[1], c0[2]);
+    int encoded1 = dxtRgbTo565(c1[0], c1[1], c1[2]);
+    if (encoded0 < encoded1)
+        std::swap(encoded0, encoded1);
+    out[0] = (unsigned char)(encoded0 & 255);
+    out[1] = (unsigned char)(encoded0 >> 8);
+    out[2] = (unsigned char)(encoded1 & 255);
+    out[3] = (unsigned char)(encoded1 >> 8);
+
+    // each pixel's position between the decoded endpoints, in quarters
+    dxtRgbFrom565(encoded0, c0);
+    dxtRgbFrom565(encoded1, c1);
+    float line[3];
+    float length = 0.0f;
+    for (int i = 0; i < 3; i++)
+    {
+        line[i] = (float)(c1[i] - c0[i]);
+        length += line[i] * line[i];
+    }
+    if (length > 0.0f)
+        length = 1.0f / length;
+    for (int i = 0; i < 3; i++)
+        line[i] *= length;
+    float lineOffset = line[0] * c0[0] + line[1] * c0[1] + line[2] * c0[2];
+
+    alignas(16) int32_t steps[16];
+#ifdef DXT_ENCODER_SSE
+    {
+        __m128 lx = _mm_set1_ps(line[0]), ly = _mm_set1_ps(line[1]), lz = _mm_set1_ps(line[2]), lo = _mm_set1_ps(lineOffset);
+        __m128 three = _mm_set1_ps(3.0f), half = _mm_set1_ps(0.5f);
+        __m128i zero = _mm_setzero_si128(), top = _mm_set1_epi32(3);
+        for (int i = 0; i < 16; i += 4)
+        {
+            __m128 dot = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(lx, _mm_load_ps(r + i)), _mm_mul_ps(ly, _mm_load_ps(g + i))), _mm_mul_ps(lz, _mm_load_ps(b + i))), lo);
+            __m128i step = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(dot, three), half));
+            // clamp to [0, 3], SSE2 has no 32 bit min/max
+            step = _mm_and_si128(step, _mm_cmpgt_epi32(step, zero));
+            __m128i over = _mm_cmpgt_epi32(step, top);
+            step = _mm_or_si128(_mm_and_si128(over, top), _mm_andnot_si128(over, step));
+            _mm_store_si128(reinterpret_cast<__m128i*>(steps + i), step);
+        }
+    }
+#else
+    for (int i = 0; i < 16; i++)
+    {
+        float dot = line[0] * r[i] + line[1] * g[i] + line[2] * b[i] - lineOffset;
+        steps[i] = std::min(3, std::max(0, (int)(dot * 3.0f + 0.5f)));
+    }
+#endif
+    // BC1 orders the palette endpoint 0, endpoint 1, then the two in between
+    static const uint32_t SWIZZLE[4] = { 0, 2, 3, 1 };
+    uint32_t indices = 0;
+    for (int i = 0; i < 16; i++)
+        indices |= SWIZZLE[steps[i]] << (i * 2);
+    out[4] = (unsigned char)indices;
+    out[5] = (unsigned char)(indices >> 8);
+    out[6] = (unsigned char)(indices >> 16);
+    out[7] = (unsigned char)(indices >> 24);
+}
+
+// BC4 (the alpha half of BC3, each half of BC5): the block's range split into 8 steps
+void encodeAlphaBlock(const unsigned char values[16], unsigned char out[8])
+{
+    int high = values[0], low = values[0];
+    alignas(16) int32_t steps[16];
+#ifdef DXT_ENCODER_SSE
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values));
+        __m128i maximum = _mm_max_epu8(v, _mm_srli_si128(v, 8));
+        __m128i minimum = _mm_min_epu8(v, _mm_srli_si128(v, 8));
+        maximum = _mm_max_epu8(maximum, _mm_srli_si128(maximum, 4));
+        minimum = _mm_min_epu8(minimum, _mm_srli_si128(minimum, 4));
+        maximum = _mm_max_epu8(maximum, _mm_srli_si128(maximum, 2));
+        minimum = _mm_min_epu8(minimum, _mm_srli_si128(minimum, 2));
+        maximum = _mm_max_epu8(maximum, _mm_srli_si128(maximum, 1));
+        minimum = _mm_min_epu8(minimum, _mm_srli_si128(minimum, 1));
+        high = _mm_cvtsi128_si32(maximum) & 255;
+        low = _mm_cvtsi128_si32(minimum) & 255;
+
+        // the reference divides by zero for flat blocks, any step decodes to the same value then
+        __m128 scale = _mm_set1_ps(high > low ? 7.9999f / (float)(high - low) : 0.0f);
+        __m128i zero = _mm_setzero_si128(), base = _mm_set1_epi32(low);
+        __m128i words[2] = { _mm_unpacklo_epi8(v, zero), _mm_unpackhi_epi8(v, zero) };
+        for (int i = 0; i < 4; i++)
+        {
+            __m128i value = i & 1 ? _mm_unpackhi_epi16(words[i >> 1], zero) : _mm_unpacklo_epi16(words[i >> 1], zero);
+            __m128 delta = _mm_cvtepi32_ps(_mm_sub_epi32(value, base));
+            _mm_store_si128(reinterpret_cast<__m128i*>(steps + i * 4), _mm_cvttps_epi32(_mm_mul_ps(delta, scale)));
+        }
+    }
+#else
+    for (int i = 1; i < 16; i++)
+    {
+        high = std::max(high, (int)values[i]);
+        low = std::min(low, (int)values[i]);
+    }
+    float scale = high > low ? 7.9999f / (float)(high - low) : 0.0f;
+    for (int i = 0; i < 16; i++)
+        steps[i] = (int)((float)(values[i] - low) * scale);
+#endif
+    // BC4 orders the palette endpoint 0, endpoint 1, then the six in between from endpoint 0 on
+    static const uint64_t SWIZZLE[8] = { 1, 7, 6, 5, 4, 3, 2, 0 };
+    uint64_t indices = 0;
+    for (int i = 0; i < 16; i++)
+        indices |= SWIZZLE[steps[i] & 7] << (i * 3);
+    out[0] = (unsigned char)high;
+    out[1] = (unsigned char)low;
+    for (int i = 0; i < 6; i++)
+        out[2 + i] = (unsigned char)(indices >> (i * 8));
+}
+
+// rows [firstRow, firstRow + rowCount) of the next smaller mip: every pixel the rounded mean of a 2x2
+// block, sizes halved and rounded down. a dimension that is already 1 averages a 1x2 or 2x1 block
+void downsample2x2(const unsigned char* source, int width, int height, int components, unsigned char* destination, int firstRow, int rowCount)
+{
+    int outWidth = std::max(1, width / 2);
+    size_t rowSize = (size_t)width * components, outRowSize = (size_t)outWidth * components;
+    for (int y = firstRow; y < firstRow + rowCount; y++)
+    {
+        const unsigned char* a = source + (size_t)std::min(2 * y, height - 1) * rowSize;
+        const unsigned char* b = source + (size_t)std::min(2 * y + 1, height - 1) * rowSize;
+        unsigned char* out = destination + (size_t)y * outRowSize;
+        int x = 0;
+#ifdef DXT_ENCODER_SSE
+        if (components == 4 && width > 1)
+        {
+            // 4 source pixels from each row to 2 destination pixels
+            const __m128i zero = _mm_setzero_si128(), two = _mm_set1_epi16(2);
+            for (; x + 2 <= outWidth && 2 * x + 4 <= width; x += 2)
+            {
+                __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + x * 8));
+                __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + x * 8));
+                __m128i left = _mm_add_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero));   // pixels 0, 1
+                __m128i right = _mm_add_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero));  // pixels 2, 3
+                __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(left, right), _mm_unpackhi_epi64(left, right));
+                sum = _mm_srli_epi16(_mm_add_epi16(sum, two), 2);
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(out + x * 4), _mm_packus_epi16(sum, sum));
+            }
+        }
+#endif
+        for (; x < outWidth; x++)
+        {
+            int x0 = std::min(2 * x, width - 1) * components, x1 = std::min(2 * x + 1, width - 1) * components;
+            for (int c = 0; c < components; c++)
+                out[x * components + c] = (unsigned char)((a[x0 + c] + a[x1 + c] + b[x0 + c] + b[x1 + c] + 2) >> 2);
+        }
+    }
+}
+#endif
@@ -344,19 +344,12 @@ Frustum createFrustumFromCamera(const Camera& cam, float aspect, float fovY, flo
 AABB generateAABB(const Model& model)
 {
 	glm::vec3 minAABB = glm::vec3(std::numeric_limits<float>::max());
-	glm::vec3 maxAABB = glm::vec3(std::numeric_limits<float>::min());
+	glm::vec3 maxAABB = glm::vec3(std::numeric_limits<float>::lowest());
+	// the mesh bounds outlive the vertices, see Mesh::releaseCpuGeometry
 	for (auto&& mesh : model.meshes)
 	{
-		for (auto&& vertex : mesh.vertices)
-		{
-			minAABB.x = std::min(minAABB.x, vertex.Position.x);
-			minAABB.y = std::min(minAABB.y, vertex.Position.y);
-			minAABB.z = std::min(minAABB.z, vertex.Position.z);
-
-			maxAABB.x = std::max(maxAABB.x, vertex.Position.x);
-			maxAABB.y = std::max(maxAABB.y, vertex.Position.y);
-			maxAABB.z = std::max(maxAABB.z, vertex.Position.z);
-		}
+		minAABB = glm::min(minAABB, mesh.boundsMin);
+		maxAABB = glm::max(maxAABB, mesh.boundsMax);
 	}
 	return AABB(minAABB, maxAABB);
 }
@@ -364,19 +357,12 @@ AABB generateAABB(const Model& model)
 Sphere generateSphereBV(const Model& model)
 {
 	glm::vec3 minAABB = glm::vec3(std::numeric_limits<float>::max());
-	glm::vec3 maxAABB = glm::vec3(std::numeric_limits<float>::min());
+	glm::vec3 maxAABB = glm::vec3(std::numeric_limits<float>::lowest());
+	// the mesh bounds outlive the vertices, see Mesh::releaseCpuGeometry
 	for (auto&& mesh : model.meshes)
 	{
-		for (auto&& vertex : mesh.vertices)
-		{
-			minAABB.x = std::min(minAABB.x, vertex.Position.x);
-			minAABB.y = std::min(minAABB.y, vertex.Position.y);
-			minAABB.z = std::min(minAABB.z, vertex.Position.z);
-
-			maxAABB.x = std::max(maxAABB.x, vertex.Position.x);
-			maxAABB.y = std::max(maxAABB.y, vertex.Position.y);
-			maxAABB.z = std::max(maxAABB.z, vertex.Position.z);
-		}
+		minAABB = glm::min(minAABB, mesh.boundsMin);
+		maxAABB = glm::max(maxAABB, mesh.boundsMax);
 	}
 
 	return Sphere((maxAABB + minAABB) * 0.5f, glm::length(minAABB - maxAABB));
@@ -475,5 +461,22 @@ public:
 			child->drawSelfAndChild(frustum, ourShader, display, total);
 		}
 	}
+
+	//Same, with the meshes of each model drawn at the LOD their projected bounding sphere calls for and culled per meshlet (see Model::Draw).
+	void drawSelfAndChild(const Frustum& frustum, Shader& ourShader, const glm::mat4& view, const glm::mat4& projection, float viewportHeight, unsigned int& display, unsigned int& total)
+	{
+		if (boundingVolume->isOnFrustum(frustum, transform))
+		{
+			ourShader.setMat4("model", transform.getModelMatrix());
+			pModel->Draw(ourShader, transform.getModelMatrix(), view, projection, viewportHeight, LOD_PIXEL_ERROR, true);
+			display++;
+		}
+		total++;
+
+		for (auto&& child : children)
+		{
+			child->drawSelfAndChild(frustum, ourShader, view, projection, viewportHeight, display, total);
+		}
+	}
 };
 #endif
@@ -2,9 +2,16 @@
 #define FILESYSTEM_H
 
 #include <string>
+#include <algorithm>
 #include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
 #include "root_directory.h" // This is a configuration file generated by CMake.
 
+#include <learnopengl/pack_file.h>
+
 class FileSystem
 {
 private:
@@ -17,7 +24,97 @@ public:
     return (*pathBuilder)(path);
   }
 
+  // from now on, files under the root that are in the pack (pack_file.h, built by Tools__PackBuild) are
+  // read from its mapping; the others, and loose files changed since the pack was built, still come from
+  // disk. call before the loaders start
+  static bool mountPack(const std::string& packPath)
+  {
+    if (!pack().open(packPath))
+      return false;
+    std::cout << "PACK:: reading " << pack().entryCount() << " files from " << packPath << ", loose files changed since it was built win" << std::endl;
+    return true;
+  }
+
+  static const PackReader& mountedPack()
+  {
+    return pack();
+  }
+
+  // the mounted pack's entry for the file at 'path' (a getPath result), null if it has none or the loose
+  // file differs from what was packed (size or last write time): an edited asset is never shadowed by
+  // a stale pack. a pack without the loose files is always used
+  static const PackEntryRecord* findInPack(const std::string& path)
+  {
+    if (!pack().isOpen())
+      return nullptr;
+    const PackEntryRecord* entry = pack().find(packName(path));
+    if (!entry)
+      return nullptr;
+    std::error_code error;
+    uint64_t size = std::filesystem::file_size(path, error);
+    if (error)
+      return entry;
+    int64_t modified = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+    if (error || (size == entry->size && modified == entry->modified))
+      return entry;
+    std::cout << "PACK:: " << packName(path) << " changed since the pack was built, reading the loose file" << std::endl;
+    return nullptr;
+  }
+
+  // whether there is a file at 'path' (a getPath result), loose or in the mounted pack
+  static bool exists(const std::string& path)
+  {
+    std::error_code error;
+    return findInPack(path) || std::filesystem::is_regular_file(path, error);
+  }
+
+  // the whole file at 'path' (a getPath result), from the mounted pack if it has it
+  static bool readFile(const std::string& path, std::string& content)
+  {
+    if (const PackEntryRecord* entry = findInPack(path))
+      return pack().read(*entry, content);
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+      return false;
+    content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return true;
+  }
+
+  // the first 'bytes' of the file at 'path' (all of it if it is shorter), from the mounted pack if it
+  // has it: a header without reading the rest of the file
+  static bool readFileHead(const std::string& path, size_t bytes, std::string& content)
+  {
+    if (const PackEntryRecord* entry = findInPack(path))
+    {
+      content.resize((size_t)std::min<uint64_t>(bytes, entry->size));
+      return pack().read(*entry, 0, content.size(), reinterpret_cast<unsigned char*>(&content[0]));
+    }
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+      return false;
+    content.resize(bytes);
+    in.read(&content[0], (std::streamsize)bytes);
+    content.resize((size_t)in.gcount());
+    return true;
+  }
+
+  // what the pack calls the file at 'path': the path relative to the root
+  static std::string packName(const std::string& path)
+  {
+    std::string root = std::filesystem::path(getPath("")).lexically_normal().generic_string();
+    std::string name = std::filesystem::path(path).lexically_normal().generic_string();
+    if (!root.empty() && root.back() != '/')
+      root += '/';
+    return name.compare(0, root.size(), root) == 0 ? name.substr(root.size()) : name;
+  }
+
 private:
+  static PackReader& pack()
+  {
+    static PackReader reader;
+    return reader;
+  }
+
   static std::string const & getRoot()
   {
     static char const * envRoot = getenv("LOGL_ROOT_PATH");
@@ -0,0 +1,320 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// The vertices and indices of all meshes of a model in one vertex buffer and one index buffer per vertex
+// format, with one VAO each. Meshes keep their own indices and are placed with a base vertex, so a pool
+// uses 16 bit indices as long as every mesh in it would on its own.
+//
+// Draws are queued per mesh (a LOD, or ranges of it like visible meshlets) and submitted by flush():
+// sorted by pool and material, every run of draws sharing both goes out as one
+// glMultiDrawElementsIndirect from a buffer of DrawElementsIndirectCommand on GL 4.3, or one
+// glMultiDrawElementsBaseVertex from client arrays below that. A model then costs a few calls however
+// many meshes it has. Meshes with the same textures share a material; materials change between calls
+// since there are no bindless textures to pick them per draw.
+//
+// Quantized positions are relative to the bounds of the whole pool, so the positionScale / positionOffset
+// uniforms are set once per pool.
+//
+// GL thread only.
+
+// the layout glMultiDrawElementsIndirect reads
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+class GeometryArena
+{
+public:
+    GeometryArena() {}
+
+    ~GeometryArena()
+    {
+        clear();
+    }
+
+    // owns GL objects
+    GeometryArena(const GeometryArena&) = delete;
+    GeometryArena& operator=(const GeometryArena&) = delete;
+
+    // uploads the meshes, each into the pool of its format. meshes are referred to by their position in
+    // the vector from then on; they need their CPU copies only for this call, see Mesh::releaseCpuGeometry.
+    void build(const vector<Mesh>& meshes)
+    {
+        clear();
+        slots.resize(meshes.size());
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            const Mesh& mesh = meshes[i];
+            Pool& pool = pools[mesh.format];
+            pool.format = mesh.format;
+            if (pool.vertexCount == 0)
+            {
+                pool.boundsMin = mesh.boundsMin;
+                pool.boundsMax = mesh.boundsMax;
+            }
+            pool.boundsMin = glm::min(pool.boundsMin, mesh.boundsMin);
+            pool.boundsMax = glm::max(pool.boundsMax, mesh.boundsMax);
+
+            Slot& slot = slots[i];
+            slot.pool = mesh.format;
+            slot.material = addMaterial(mesh.textures);
+            slot.baseVertex = (GLint)pool.vertexCount;
+            slot.firstIndex.push_back((GLuint)pool.indexCount);
+            slot.indexCount.push_back((GLuint)mesh.indices.size());
+            pool.indexCount += mesh.indices.size();
+            for (const MeshLod& lod : mesh.lods)
+            {
+                slot.firstIndex.push_back((GLuint)pool.indexCount);
+                slot.indexCount.push_back((GLuint)lod.indices.size());
+                pool.indexCount += lod.indices.size();
+            }
+            pool.vertexCount += mesh.vertices.size();
+            pool.largestMesh = std::max(pool.largestMesh, mesh.vertices.size());
+        }
+
+        for (int format = 0; format < VERTEX_FORMAT_COUNT; format++)
+        {
+            Pool& pool = pools[format];
+            if (pool.vertexCount == 0)
+                continue;
+            pool.indexType = pool.largestMesh <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+            size_t indexSize = pool.indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
+            size_t vertexSize = vertexFormatSize(pool.format);
+
+            glGenVertexArrays(1, &pool.VAO);
+            glGenBuffers(1, &pool.VBO);
+            glGenBuffers(1, &pool.EBO);
+            glBindVertexArray(pool.VAO);
+            glBindBuffer(GL_ARRAY_BUFFER, pool.VBO);
+            glBufferData(GL_ARRAY_BUFFER, pool.vertexCount * vertexSize, NULL, GL_STATIC_DRAW);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pool.EBO);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, pool.indexCount * indexSize, NULL, GL_STATIC_DRAW);
+
+            // every mesh packed straight into the mapped buffers
+            fillBuffer(GL_ARRAY_BUFFER, 0, pool.vertexCount * vertexSize, [&](void* destination) {
+                unsigned char* out = static_cast<unsigned char*>(destination);
+                for (size_t i = 0; i < meshes.size(); i++)
+                    if ((int)slots[i].pool == format)
+                        packVertices(meshes[i].vertices.data(), meshes[i].vertices.size(), pool.format, pool.boundsMin, pool.boundsMax,
+                                     out + slots[i].baseVertex * vertexSize);
+            });
+            fillBuffer(GL_ELEMENT_ARRAY_BUFFER, 0, pool.indexCount * indexSize, [&](void* destination) {
+                unsigned char* out = static_cast<unsigned char*>(destination);
+                for (size_t i = 0; i < meshes.size(); i++)
+                {
+                    const Slot& slot = slots[i];
+                    if ((int)slot.pool != format)
+                        continue;
+                    for (size_t lod = 0; lod < slot.firstIndex.size(); lod++)
+                    {
+                        const vector<unsigned int>& indices = lod == 0 ? meshes[i].indices : meshes[i].lods[lod - 1].indices;
+                        packIndices(indices.data(), indices.size(), pool.indexType, out + slot.firstIndex[lod] * indexSize);
+                    }
+                }
+            });
+            setupVertexAttributes(pool.format);
+            glBindVertexArray(0);
+        }
+
+        if (GLAD_GL_VERSION_4_3)
+            glGenBuffers(1, &indirectBuffer);
+    }
+
+    // deletes the GL objects, back to an empty arena
+    void clear()
+    {
+        for (Pool& pool : pools)
+        {
+            if (pool.VAO)
+            {
+                glDeleteVertexArrays(1, &pool.VAO);
+                glDeleteBuffers(1, &pool.VBO);
+                glDeleteBuffers(1, &pool.EBO);
+            }
+            pool = Pool();
+        }
+        if (indirectBuffer)
+            glDeleteBuffers(1, &indirectBuffer);
+        indirectBuffer = 0;
+        slots.clear();
+        materials.clear();
+        queued.clear();
+    }
+
+    // queues a mesh at a LOD
+    void draw(size_t mesh, unsigned int lod = 0)
+    {
+        const Slot& slot = slots[mesh];
+        lod = std::min(lod, (unsigned int)slot.firstIndex.size() - 1);
+        queue(slot, slot.firstIndex[lod], slot.indexCount[lod]);
+    }
+
+    // queues index ranges of a mesh's full detail indices, e.g. Mesh::culledRanges()
+    void draw(size_t mesh, const vector<Meshlet>& ranges)
+    {
+        const Slot& slot = slots[mesh];
+        for (const Meshlet& range : ranges)
+            queue(slot, slot.firstIndex[0] + range.firstIndex, range.indexCount);
+    }
+
+    // submits everything queued since the last flush
+    void flush(Shader &shader)
+    {
+        drawCalls = 0;
+        if (queued.empty())
+            return;
+        std::stable_sort(queued.begin(), queued.end(), [](const QueuedDraw& a, const QueuedDraw& b) {
+            return a.pool != b.pool ? a.pool < b.pool : a.material < b.material;
+        });
+        bool indirect = indirectBuffer != 0;
+        if (indirect)
+        {
+            commands.clear();
+            for (const QueuedDraw& draw : queued)
+                commands.push_back(draw.command);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+            // orphaned every frame, the driver may still read last frame's commands
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STREAM_DRAW);
+        }
+
+        int boundPool = -1;
+        for (size_t begin = 0, end; begin < queued.size(); begin = end)
+        {
+            const QueuedDraw& first = queued[begin];
+            for (end = begin + 1; end < queued.size() && queued[end].pool == first.pool && queued[end].material == first.material; end++)
+                ;
+            const Pool& pool = pools[first.pool];
+            if (boundPool != (int)first.pool)
+            {
+                boundPool = (int)first.pool;
+                glBindVertexArray(pool.VAO);
+                if (pool.format == VERTEX_FORMAT_QUANTIZED)
+                {
+                    shader.setVec3("positionScale", pool.boundsMax - pool.boundsMin);
+                    shader.setVec3("positionOffset", pool.boundsMin);
+                }
+                else
+                {
+                    shader.setVec3("positionScale", glm::vec3(1.0f));
+                    shader.setVec3("positionOffset", glm::vec3(0.0f));
+                }
+            }
+            bindTextures(shader, materials[first.material]);
+
+            GLsizei count = (GLsizei)(end - begin);
+            if (indirect)
+                glMultiDrawElementsIndirect(GL_TRIANGLES, pool.indexType, (const void*)(begin * sizeof(DrawElementsIndirectCommand)), count, 0);
+            else
+            {
+                size_t indexSize = pool.indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
+                counts.clear();
+                offsets.clear();
+                baseVertices.clear();
+                for (size_t i = begin; i < end; i++)
+                {
+                    counts.push_back((GLsizei)queued[i].command.count);
+                    offsets.push_back((const void*)(queued[i].command.firstIndex * indexSize));
+                    baseVertices.push_back(queued[i].command.baseVertex);
+                }
+                glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), pool.indexType, offsets.data(), count, baseVertices.data());
+            }
+            drawCalls++;
+        }
+
+        glBindVertexArray(0);
+        if (indirect)
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        shader.setVec3("positionScale", glm::vec3(1.0f));
+        shader.setVec3("positionOffset", glm::vec3(0.0f));
+        glActiveTexture(GL_TEXTURE0);
+        queued.clear();
+    }
+
+    // multi-draw calls the last flush() made
+    unsigned int lastDrawCalls() const { return drawCalls; }
+
+    // whether draws go through glMultiDrawElementsIndirect
+    bool indirect() const { return indirectBuffer != 0; }
+
+    size_t materialCount() const { return materials.size(); }
+
+private:
+    static const int VERTEX_FORMAT_COUNT = VERTEX_FORMAT_QUANTIZED + 1;
+
+    struct Pool {
+        VertexFormat format = VERTEX_FORMAT_FULL;
+        unsigned int VAO = 0, VBO = 0, EBO = 0;
+        GLenum indexType = GL_UNSIGNED_INT;
+        size_t vertexCount = 0, indexCount = 0;
+        size_t largestMesh = 0;
+        glm::vec3 boundsMin = glm::vec3(0.0f), boundsMax = glm::vec3(0.0f);
+    };
+
+    // where a mesh is: its pool, base vertex, and first index / index count of every LOD in the pool
+    struct Slot {
+        unsigned int pool;
+        unsigned int material;
+        GLint baseVertex;
+        vector<GLuint> firstIndex;
+        vector<GLuint> indexCount;
+    };
+
+    struct QueuedDraw {
+        unsigned int pool;
+        unsigned int material;
+        DrawElementsIndirectCommand command;
+    };
+
+    Pool pools[VERTEX_FORMAT_COUNT];
+    vector<Slot> slots;
+    vector<vector<Texture>> materials;
+    unsigned int indirectBuffer = 0;
+    unsigned int drawCalls = 0;
+    vector<QueuedDraw> queued;
+    // per flush scratch
+    vector<DrawElementsIndirectCommand> commands;
+    vector<GLsizei> counts;
+    vector<const void*> offsets;
+    vector<GLint> baseVertices;
+
+    void queue(const Slot& slot, GLuint firstIndex, GLuint indexCount)
+    {
+        if (indexCount == 0)
+            return;
+        QueuedDraw draw;
+        draw.pool = slot.pool;
+        draw.material = slot.material;
+        draw.command = { indexCount, 1, firstIndex, slot.baseVertex, 0 };
+        queued.push_back(draw);
+    }
+
+    // the material with exactly these textures, added if it's new
+    unsigned int addMaterial(const vector<Texture>& textures)
+    {
+        for (size_t i = 0; i < materials.size(); i++)
+        {
+            const vector<Texture>& other = materials[i];
+            bool same = other.size() == textures.size();
+            for (size_t t = 0; same && t < textures.size(); t++)
+                same = other[t].id == textures[t].id && other[t].type == textures[t].type;
+            if (same)
+                return (unsigned int)i;
+        }
+        materials.push_back(textures);
+        return (unsigned int)(materials.size() - 1);
+    }
+};
+#endif
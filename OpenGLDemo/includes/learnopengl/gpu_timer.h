@@ -0,0 +1,134 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/profiler.h>
+
+#include <vector>
+
+// Per-pass GPU timings from GL_TIMESTAMP queries. Query results are read back a few frames late so timing
+// never stalls the pipeline; collect() hands out the oldest finished frame. Resolved passes are also
+// written to a "gpu" track of the CPU profiler so they line up with the CPU zones in the exported trace.
+//
+// usage:
+//     timer.beginFrame();
+//     timer.beginPass("gbuffer"); ...draw... timer.endPass();
+//     timer.endFrame();
+//     if (timer.collect(timings)) ...
+class GpuTimer
+{
+public:
+    static const int FRAME_LATENCY = 4;
+    static const int MAX_PASSES = 16;
+
+    struct PassTiming {
+        const char* name;
+        double ms;
+    };
+
+    ~GpuTimer()
+    {
+        if (initialized)
+            for (int i = 0; i < FRAME_LATENCY; i++)
+                glDeleteQueries(MAX_PASSES * 2, frames[i].queries);
+    }
+
+    // must be called with a current GL context
+    void beginFrame()
+    {
+        if (!initialized)
+        {
+            for (int i = 0; i < FRAME_LATENCY; i++)
+                glGenQueries(MAX_PASSES * 2, frames[i].queries);
+            gpuTrack = Profiler::instance().createTrack("gpu");
+            initialized = true;
+        }
+        // the ring is full, block on the oldest frame rather than overwriting its queries
+        std::vector<PassTiming> dropped;
+        if (frames[writeIndex].pending)
+            collect(dropped, true);
+
+        Frame& frame = frames[writeIndex];
+        frame.passCount = 0;
+        frame.cpuBase = Profiler::instance().now();
+        glGetInteger64v(GL_TIMESTAMP, &frame.gpuBase);
+        inFrame = true;
+    }
+
+    void beginPass(const char* name)
+    {
+        Frame& frame = frames[writeIndex];
+        if (!inFrame || frame.passCount >= MAX_PASSES)
+            return;
+        frame.names[frame.passCount] = name;
+        glQueryCounter(frame.queries[frame.passCount * 2], GL_TIMESTAMP);
+    }
+
+    void endPass()
+    {
+        Frame& frame = frames[writeIndex];
+        if (!inFrame || frame.passCount >= MAX_PASSES)
+            return;
+        glQueryCounter(frame.queries[frame.passCount * 2 + 1], GL_TIMESTAMP);
+        frame.passCount++;
+    }
+
+    void endFrame()
+    {
+        if (!inFrame)
+            return;
+        frames[writeIndex].pending = true;
+        writeIndex = (writeIndex + 1) % FRAME_LATENCY;
+        inFrame = false;
+    }
+
+    // retrieves the pass timings of the oldest pending frame. returns false if none is ready yet (or,
+    // with wait, if no frame is pending at all).
+    bool collect(std::vector<PassTiming>& timings, bool wait = false)
+    {
+        Frame& frame = frames[readIndex];
+        if (!frame.pending)
+            return false;
+        if (frame.passCount > 0 && !wait)
+        {
+            GLint available = 0;
+            glGetQueryObjectiv(frame.queries[frame.passCount * 2 - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                return false;
+        }
+
+        timings.clear();
+        for (int i = 0; i < frame.passCount; i++)
+        {
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(frame.queries[i * 2], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(frame.queries[i * 2 + 1], GL_QUERY_RESULT, &end);
+            timings.push_back({ frame.names[i], (end - begin) / 1000000.0 });
+            // map the gpu clock onto the profiler clock using the pair sampled at beginFrame
+            if (Profiler::instance().isEnabled())
+                gpuTrack->push({ frame.names[i], frame.cpuBase + (begin - frame.gpuBase), frame.cpuBase + (end - frame.gpuBase) });
+        }
+        frame.pending = false;
+        readIndex = (readIndex + 1) % FRAME_LATENCY;
+        return true;
+    }
+
+private:
+    struct Frame {
+        GLuint queries[MAX_PASSES * 2];
+        const char* names[MAX_PASSES];
+        int passCount = 0;
+        bool pending = false;
+        uint64_t cpuBase = 0;
+        GLint64 gpuBase = 0;
+    };
+
+    Frame frames[FRAME_LATENCY];
+    int writeIndex = 0;
+    int readIndex = 0;
+    bool initialized = false;
+    bool inFrame = false;
+    ProfileThreadBuffer* gpuTrack = nullptr;
+};
+#endif
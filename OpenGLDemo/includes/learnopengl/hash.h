@@ -0,0 +1,29 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 64 bit FNV-1a, used to key cooked asset caches on the content they were built from. Not a
+// cryptographic hash, only meant to notice that a source file changed.
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+const uint64_t FNV_PRIME = 1099511628211ull;
+
+// hashes 'size' bytes, pass the previous result as 'hash' to continue over several buffers
+uint64_t fnv1a(const void* data, size_t size, uint64_t hash = FNV_OFFSET_BASIS)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+uint64_t fnv1a(const std::string& text, uint64_t hash = FNV_OFFSET_BASIS)
+{
+    return fnv1a(text.data(), text.size(), hash);
+}
+#endif
@@ -0,0 +1,129 @@
+#ifndef HEADLESS_CONTEXT_H
+#define HEADLESS_CONTEXT_H
+
+#include <glad/glad.h>
+
+#ifdef LOGL_HAS_EGL
+#define EGL_NO_X11 // keep Xlib's macros (None, Bool, Status...) out of the demos
+#define MESA_EGL_NO_X11_HEADERS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <cstring>
+#include <iostream>
+
+// An OpenGL 3.3 core context without a window, for benchmarking on machines without a display.
+// Uses EGL, preferring Mesa's surfaceless platform (works with llvmpipe and no X server) and falling
+// back to the default display with a pbuffer surface. Only available when built with LOGL_HAS_EGL.
+// There might be no default framebuffer, so everything has to be rendered into framebuffer objects.
+class HeadlessContext
+{
+public:
+    ~HeadlessContext()
+    {
+        destroy();
+    }
+
+    // creates the context, makes it current and loads the GL function pointers
+    bool create(int width, int height)
+    {
+#ifdef LOGL_HAS_EGL
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+        if (getPlatformDisplay && clientExtensions && std::strstr(clientExtensions, "EGL_MESA_platform_surfaceless"))
+            display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+        if (display == EGL_NO_DISPLAY)
+            display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+        EGLint major, minor;
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+        {
+            std::cout << "ERROR::EGL:: failed to initialize a display" << std::endl;
+            return false;
+        }
+        if (!eglBindAPI(EGL_OPENGL_API))
+        {
+            std::cout << "ERROR::EGL:: desktop OpenGL is not supported" << std::endl;
+            return false;
+        }
+
+        // a pbuffer capable config first, then anything that can do GL (surfaceless)
+        const EGLint pbufferAttribs[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_DEPTH_SIZE, 24,
+            EGL_NONE
+        };
+        const EGLint anyAttribs[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+        EGLConfig config = nullptr;
+        EGLint numConfigs = 0;
+        bool pbuffer = eglChooseConfig(display, pbufferAttribs, &config, 1, &numConfigs) && numConfigs > 0;
+        if (!pbuffer && (!eglChooseConfig(display, anyAttribs, &config, 1, &numConfigs) || numConfigs == 0))
+        {
+            std::cout << "ERROR::EGL:: no OpenGL capable config" << std::endl;
+            return false;
+        }
+
+        const EGLint contextAttribs[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 3,
+            EGL_CONTEXT_MINOR_VERSION, 3,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+        if (context == EGL_NO_CONTEXT)
+        {
+            std::cout << "ERROR::EGL:: failed to create a 3.3 core context" << std::endl;
+            return false;
+        }
+
+        if (pbuffer)
+        {
+            const EGLint surfaceAttribs[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+            surface = eglCreatePbufferSurface(display, config, surfaceAttribs);
+        }
+        if (!eglMakeCurrent(display, surface, surface, context))
+        {
+            std::cout << "ERROR::EGL:: failed to make the context current" << std::endl;
+            return false;
+        }
+
+        if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress))
+        {
+            std::cout << "Failed to initialize GLAD" << std::endl;
+            return false;
+        }
+        return true;
+#else
+        (void)width; (void)height;
+        std::cout << "ERROR::HEADLESS:: built without EGL, headless mode is unavailable" << std::endl;
+        return false;
+#endif
+    }
+
+    void destroy()
+    {
+#ifdef LOGL_HAS_EGL
+        if (display == EGL_NO_DISPLAY)
+            return;
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (surface != EGL_NO_SURFACE)
+            eglDestroySurface(display, surface);
+        if (context != EGL_NO_CONTEXT)
+            eglDestroyContext(display, context);
+        eglTerminate(display);
+        display = EGL_NO_DISPLAY;
+        surface = EGL_NO_SURFACE;
+        context = EGL_NO_CONTEXT;
+#endif
+    }
+
+private:
+#ifdef LOGL_HAS_EGL
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLSurface surface = EGL_NO_SURFACE;
+    EGLContext context = EGL_NO_CONTEXT;
+#endif
+};
+#endif
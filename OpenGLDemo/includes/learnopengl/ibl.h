@@ -0,0 +1,724 @@
+#ifndef IBL_H
+#define IBL_H
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IBL_SSE
+#endif
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/packing.hpp>
+#include <stb_image.h>
+
+#include <learnopengl/cubemap.h>
+#include <learnopengl/hash.h>
+#include <learnopengl/mapped_file.h>
+#include <learnopengl/profiler.h>
+#include <learnopengl/thread_pool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Image based lighting inputs precomputed on the CPU from an equirectangular HDR environment:
+//   - the environment as a cubemap
+//   - its diffuse irradiance as 9 spherical harmonics coefficients (L2), so the lighting pass evaluates a
+//     polynomial of the normal instead of fetching an irradiance cubemap
+//   - a GGX prefiltered cubemap, one roughness per mip (Karis' split sum, N = V = R, filtered importance
+//     sampling from the environment's mips)
+//   - the split sum BRDF lookup table, scale and bias of F0 by NdotV and roughness
+//
+// every stage splits its texels (by face rows) over the thread pool, and the color math goes 4 floats at
+// a time through SSE2 where available; sums are reduced in a fixed order, so the result doesn't depend on
+// the thread count. everything is cached as "<image>.ibl" next to the HDR, half floats, valid while the
+// hash of the image and the settings match. IblPrecompute runs all of it in the background and uploads the
+// textures once done.
+//
+// no OpenGL except in IblPrecompute.
+
+const uint32_t IBL_CACHE_VERSION = 1;
+
+struct IblSettings {
+    int environmentSize = 512;  // cubemap face size
+    int prefilterSize = 256;    // face size of the prefiltered cubemap's first mip (roughness 0)
+    int prefilterLevels = 6;    // roughness 0 to 1 over this many mips
+    int prefilterSamples = 256; // GGX samples per texel
+    int brdfLutSize = 128;
+    int brdfSamples = 512;
+};
+
+struct IblData {
+    IblSettings settings;
+    glm::vec3 sh[9];                  // irradiance / pi: evaluateIrradianceSH gives the diffuse light for an albedo of 1
+    std::vector<uint16_t> environment; // RGB half floats, 6 faces (GL order +X -X +Y -Y +Z -Z), top row first
+    std::vector<uint16_t> prefiltered; // RGB half floats, the faces of mip 0, then those of mip 1...
+    std::vector<uint16_t> brdfLut;     // RG half floats, a row per roughness, a column per NdotV
+};
+
+// an RGBA float color
+#ifdef IBL_SSE
+typedef __m128 IblColor;
+IblColor iblZero() { return _mm_setzero_ps(); }
+IblColor iblLoad(const float* color) { return _mm_loadu_ps(color); }
+void iblStore(float* color, IblColor value) { _mm_storeu_ps(color, value); }
+IblColor iblAdd(IblColor a, IblColor b) { return _mm_add_ps(a, b); }
+IblColor iblScale(IblColor a, float s) { return _mm_mul_ps(a, _mm_set1_ps(s)); }
+IblColor iblMultiplyAdd(IblColor sum, IblColor a, float s) { return _mm_add_ps(sum, _mm_mul_ps(a, _mm_set1_ps(s))); }
+IblColor iblLerp(IblColor a, IblColor b, float f) { return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), _mm_set1_ps(f))); }
+#else
+typedef glm::vec4 IblColor;
+IblColor iblZero() { return glm::vec4(0.0f); }
+IblColor iblLoad(const float* color) { return glm::vec4(color[0], color[1], color[2], color[3]); }
+void iblStore(float* color, IblColor value) { std::memcpy(color, &value, sizeof(float) * 4); }
+IblColor iblAdd(IblColor a, IblColor b) { return a + b; }
+IblColor iblScale(IblColor a, float s) { return a * s; }
+IblColor iblMultiplyAdd(IblColor sum, IblColor a, float s) { return sum + a * s; }
+IblColor iblLerp(IblColor a, IblColor b, float f) { return a + (b - a) * f; }
+#endif
+
+// a cubemap level: 6 faces of size x size RGBA float texels
+struct IblCube {
+    int size = 0;
+    std::vector<float> texels;
+
+    float* texel(int face, int x, int y) { return texels.data() + (((size_t)face * size + y) * size + x) * 4; }
+    const float* texel(int face, int x, int y) const { return texels.data() + (((size_t)face * size + y) * size + x) * 4; }
+};
+
+// the direction through a face at s, t in [-1, 1] (t grows with the rows), as GL samples cubemaps
+glm::vec3 cubeFaceDirection(int face, float s, float t)
+{
+    switch (face)
+    {
+    case 0: return glm::vec3(1.0f, -t, -s);
+    case 1: return glm::vec3(-1.0f, -t, s);
+    case 2: return glm::vec3(s, 1.0f, t);
+    case 3: return glm::vec3(s, -1.0f, -t);
+    case 4: return glm::vec3(s, -t, 1.0f);
+    default: return glm::vec3(-s, -t, -1.0f);
+    }
+}
+
+// the inverse: face and s, t in [0, 1] of a direction
+int cubeFaceCoordinates(const glm::vec3& direction, float& s, float& t)
+{
+    glm::vec3 a = glm::abs(direction);
+    int face;
+    float major, sc, tc;
+    if (a.x >= a.y && a.x >= a.z)
+    {
+        face = direction.x > 0.0f ? 0 : 1;
+        major = a.x;
+        sc = direction.x > 0.0f ? -direction.z : direction.z;
+        tc = -direction.y;
+    }
+    else if (a.y >= a.z)
+    {
+        face = direction.y > 0.0f ? 2 : 3;
+        major = a.y;
+        sc = direction.x;
+        tc = direction.y > 0.0f ? direction.z : -direction.z;
+    }
+    else
+    {
+        face = direction.z > 0.0f ? 4 : 5;
+        major = a.z;
+        sc = direction.z > 0.0f ? direction.x : -direction.x;
+        tc = -direction.y;
+    }
+    s = 0.5f * (sc / major + 1.0f);
+    t = 0.5f * (tc / major + 1.0f);
+    return face;
+}
+
+// bilinear within the face, clamped at its edges
+IblColor sampleCubeLevel(const IblCube& cube, const glm::vec3& direction)
+{
+    float s, t;
+    int face = cubeFaceCoordinates(direction, s, t);
+    float x = glm::clamp(s * cube.size - 0.5f, 0.0f, (float)(cube.size - 1));
+    float y = glm::clamp(t * cube.size - 0.5f, 0.0f, (float)(cube.size - 1));
+    int x0 = (int)x, y0 = (int)y;
+    int x1 = std::min(x0 + 1, cube.size - 1), y1 = std::min(y0 + 1, cube.size - 1);
+    float fx = x - x0, fy = y - y0;
+    IblColor top = iblLerp(iblLoad(cube.texel(face, x0, y0)), iblLoad(cube.texel(face, x1, y0)), fx);
+    IblColor bottom = iblLerp(iblLoad(cube.texel(face, x0, y1)), iblLoad(cube.texel(face, x1, y1)), fx);
+    return iblLerp(top, bottom, fy);
+}
+
+// trilinear over a mip chain
+IblColor sampleCube(const std::vector<IblCube>& mips, const glm::vec3& direction, float lod)
+{
+    lod = glm::clamp(lod, 0.0f, (float)(mips.size() - 1));
+    int level = (int)lod;
+    IblColor color = sampleCubeLevel(mips[level], direction);
+    if (level + 1 < (int)mips.size() && lod > level)
+        color = iblLerp(color, sampleCubeLevel(mips[level + 1], direction), lod - level);
+    return color;
+}
+
+// calls body(face, y) for every row of every face of a size x size cube, spread over the thread pool
+template <typename Body>
+void forCubeRows(int size, Body body)
+{
+    ThreadPool::instance().parallelFor((size_t)6 * size, [&](size_t row) {
+        body((int)(row / size), (int)(row % size));
+    });
+}
+
+// the face texel's center as s, t in [-1, 1]
+glm::vec2 cubeTexelCenter(int size, int x, int y)
+{
+    return glm::vec2(2.0f * (x + 0.5f) / size - 1.0f, 2.0f * (y + 0.5f) / size - 1.0f);
+}
+
+// resamples an equirectangular RGBA float image (top row first) into a cube
+void equirectangularToCube(const float* image, int width, int height, IblCube& cube)
+{
+    PROFILE_ZONE("equirectangularToCube");
+    cube.texels.resize((size_t)6 * cube.size * cube.size * 4);
+    const float pi = glm::pi<float>();
+    forCubeRows(cube.size, [&](int face, int y) {
+        for (int x = 0; x < cube.size; x++)
+        {
+            glm::vec2 st = cubeTexelCenter(cube.size, x, y);
+            glm::vec3 direction = glm::normalize(cubeFaceDirection(face, st.x, st.y));
+            float u = std::atan2(direction.z, direction.x) / (2.0f * pi) + 0.5f;
+            float v = 0.5f - std::asin(glm::clamp(direction.y, -1.0f, 1.0f)) / pi;
+            // repeats around, clamps at the poles
+            float sx = u * width - 0.5f, sy = glm::clamp(v * height - 0.5f, 0.0f, (float)(height - 1));
+            int x0 = (int)std::floor(sx), y0 = (int)sy;
+            float fx = sx - x0, fy = sy - y0;
+            int x1 = (x0 + 1) % width, y1 = std::min(y0 + 1, height - 1);
+            x0 = (x0 + width) % width;
+            const float* row0 = image + (size_t)y0 * width * 4;
+            const float* row1 = image + (size_t)y1 * width * 4;
+            IblColor top = iblLerp(iblLoad(row0 + x0 * 4), iblLoad(row0 + x1 * 4), fx);
+            IblColor bottom = iblLerp(iblLoad(row1 + x0 * 4), iblLoad(row1 + x1 * 4), fx);
+            iblStore(cube.texel(face, x, y), iblLerp(top, bottom, fy));
+        }
+    });
+}
+
+// box filtered mips of mips[0] down to 1x1
+void buildCubeMips(std::vector<IblCube>& mips)
+{
+    PROFILE_ZONE("buildCubeMips");
+    mips.resize(1);
+    while (mips.back().size > 1)
+    {
+        const IblCube& source = mips.back();
+        IblCube next;
+        next.size = source.size / 2;
+        next.texels.resize((size_t)6 * next.size * next.size * 4);
+        forCubeRows(next.size, [&](int face, int y) {
+            for (int x = 0; x < next.size; x++)
+            {
+                IblColor sum = iblAdd(iblAdd(iblLoad(source.texel(face, 2 * x, 2 * y)), iblLoad(source.texel(face, 2 * x + 1, 2 * y))),
+                    iblAdd(iblLoad(source.texel(face, 2 * x, 2 * y + 1)), iblLoad(source.texel(face, 2 * x + 1, 2 * y + 1))));
+                iblStore(next.texel(face, x, y), iblScale(sum, 0.25f));
+            }
+        });
+        mips.push_back(std::move(next));
+    }
+}
+
+// the 9 real spherical harmonics basis functions (bands 0-2) of a unit direction
+void shBasis(const glm::vec3& d, float basis[9])
+{
+    basis[0] = 0.282095f;
+    basis[1] = 0.488603f * d.y;
+    basis[2] = 0.488603f * d.z;
+    basis[3] = 0.488603f * d.x;
+    basis[4] = 1.092548f * d.x * d.y;
+    basis[5] = 1.092548f * d.y * d.z;
+    basis[6] = 0.315392f * (3.0f * d.z * d.z - 1.0f);
+    basis[7] = 1.092548f * d.x * d.z;
+    basis[8] = 0.546274f * (d.x * d.x - d.y * d.y);
+}
+
+// projects the cube's radiance onto SH, each texel weighted by its solid angle, then convolves with the
+// clamped cosine (Ramamoorthi and Hanrahan) and divides by pi, so the result is the diffuse light
+void projectIrradianceSH(const IblCube& cube, glm::vec3 sh[9])
+{
+    PROFILE_ZONE("projectIrradianceSH");
+    // a sum per row, added up in order afterwards
+    std::vector<float> rows((size_t)6 * cube.size * 9 * 4);
+    forCubeRows(cube.size, [&](int face, int y) {
+        IblColor sums[9];
+        for (int k = 0; k < 9; k++)
+            sums[k] = iblZero();
+        float basis[9];
+        for (int x = 0; x < cube.size; x++)
+        {
+            glm::vec2 st = cubeTexelCenter(cube.size, x, y);
+            float r2 = 1.0f + st.x * st.x + st.y * st.y;
+            float solidAngle = 4.0f / ((float)cube.size * cube.size * r2 * std::sqrt(r2));
+            shBasis(glm::normalize(cubeFaceDirection(face, st.x, st.y)), basis);
+            IblColor color = iblLoad(cube.texel(face, x, y));
+            for (int k = 0; k < 9; k++)
+                sums[k] = iblMultiplyAdd(sums[k], color, basis[k] * solidAngle);
+        }
+        float* out = rows.data() + ((size_t)face * cube.size + y) * 9 * 4;
+        for (int k = 0; k < 9; k++)
+            iblStore(out + k * 4, sums[k]);
+    });
+
+    const float band[9] = { 1.0f, 2.0f / 3.0f, 2.0f / 3.0f, 2.0f / 3.0f, 0.25f, 0.25f, 0.25f, 0.25f, 0.25f }; // A_l / pi
+    for (int k = 0; k < 9; k++)
+    {
+        glm::dvec3 total(0.0);
+        for (size_t row = 0; row < (size_t)6 * cube.size; row++)
+        {
+            const float* sum = rows.data() + (row * 9 + k) * 4;
+            total += glm::dvec3(sum[0], sum[1], sum[2]);
+        }
+        sh[k] = glm::vec3(total) * band[k];
+    }
+}
+
+// the diffuse light from SH coefficients, as ssao_lighting.fs evaluates it
+glm::vec3 evaluateIrradianceSH(const glm::vec3 sh[9], const glm::vec3& normal)
+{
+    float basis[9];
+    shBasis(normal, basis);
+    glm::vec3 light(0.0f);
+    for (int k = 0; k < 9; k++)
+        light += sh[k] * basis[k];
+    return glm::max(light, glm::vec3(0.0f));
+}
+
+float radicalInverse(uint32_t bits)
+{
+    bits = (bits << 16u) | (bits >> 16u);
+    bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+    bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+    bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+    bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+    return (float)bits * 2.3283064365386963e-10f;
+}
+
+// the i-th of 'count' GGX distributed half vectors around +Z (Hammersley points)
+glm::vec3 importanceSampleGGX(int i, int count, float roughness)
+{
+    float a = roughness * roughness;
+    float phi = 2.0f * glm::pi<float>() * (float)i / count;
+    float u = radicalInverse((uint32_t)i);
+    float cosTheta = std::sqrt((1.0f - u) / (1.0f + (a * a - 1.0f) * u));
+    float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+    return glm::vec3(std::cos(phi) * sinTheta, std::sin(phi) * sinTheta, cosTheta);
+}
+
+// prefilters the environment (with its mips) for each roughness. the GGX samples are the same around
+// every texel's direction, so each level computes them, their weights and source mips once
+void prefilterGGX(const std::vector<IblCube>& environment, const IblSettings& settings, std::vector<IblCube>& levels)
+{
+    PROFILE_ZONE("prefilterGGX");
+    struct Sample {
+        glm::vec3 direction; // around +Z
+        float weight;        // NdotL
+        float lod;
+    };
+    const float sourceTexelAngle = 4.0f * glm::pi<float>() / (6.0f * environment[0].size * environment[0].size);
+    levels.resize(settings.prefilterLevels);
+    for (int level = 0; level < settings.prefilterLevels; level++)
+    {
+        IblCube& cube = levels[level];
+        cube.size = std::max(1, settings.prefilterSize >> level);
+        cube.texels.resize((size_t)6 * cube.size * cube.size * 4);
+        float roughness = settings.prefilterLevels > 1 ? (float)level / (settings.prefilterLevels - 1) : 0.0f;
+        // never finer than the output's own texels
+        float minimumLod = std::max(0.0f, std::log2((float)environment[0].size / cube.size));
+
+        std::vector<Sample> samples;
+        float totalWeight = 0.0f;
+        if (roughness == 0.0f)
+            samples.push_back(Sample{ glm::vec3(0.0f, 0.0f, 1.0f), 1.0f, minimumLod });
+        else
+        {
+            float a2 = roughness * roughness * roughness * roughness;
+            for (int i = 0; i < settings.prefilterSamples; i++)
+            {
+                glm::vec3 h = importanceSampleGGX(i, settings.prefilterSamples, roughness);
+                glm::vec3 l = 2.0f * h.z * h - glm::vec3(0.0f, 0.0f, 1.0f);
+                if (l.z <= 0.0f)
+                    continue;
+                // pdf of l is D * NdotH / (4 * VdotH), with N = V that is D / 4
+                float d = h.z * h.z * (a2 - 1.0f) + 1.0f;
+                float pdf = a2 / (glm::pi<float>() * d * d) * 0.25f;
+                float sampleAngle = 1.0f / (settings.prefilterSamples * pdf + 0.0001f);
+                samples.push_back(Sample{ l, l.z, std::max(minimumLod, 0.5f * std::log2(sampleAngle / sourceTexelAngle)) });
+            }
+        }
+        for (const Sample& sample : samples)
+            totalWeight += sample.weight;
+
+        forCubeRows(cube.size, [&](int face, int y) {
+            for (int x = 0; x < cube.size; x++)
+            {
+                glm::vec2 st = cubeTexelCenter(cube.size, x, y);
+                glm::vec3 n = glm::normalize(cubeFaceDirection(face, st.x, st.y));
+                glm::vec3 up = std::abs(n.z) < 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+                glm::vec3 tangent = glm::normalize(glm::cross(up, n));
+                glm::vec3 bitangent = glm::cross(n, tangent);
+                IblColor sum = iblZero();
+                for (const Sample& sample : samples)
+                {
+                    glm::vec3 direction = tangent * sample.direction.x + bitangent * sample.direction.y + n * sample.direction.z;
+                    sum = iblMultiplyAdd(sum, sampleCube(environment, direction, sample.lod), sample.weight);
+                }
+                iblStore(cube.texel(face, x, y), iblScale(sum, 1.0f / totalWeight));
+            }
+        });
+    }
+}
+
+// the split sum's second term: F0 scale (red) and bias (green) by NdotV (columns) and roughness (rows)
+void integrateBrdfLut(const IblSettings& settings, std::vector<glm::vec2>& lut)
+{
+    PROFILE_ZONE("integrateBrdfLut");
+    int size = settings.brdfLutSize;
+    lut.resize((size_t)size * size);
+    ThreadPool::instance().parallelFor((size_t)size, [&](size_t row) {
+        float roughness = (row + 0.5f) / size;
+        float k = roughness * roughness / 2.0f;
+        std::vector<glm::vec3> halfVectors(settings.brdfSamples);
+        for (int i = 0; i < settings.brdfSamples; i++)
+            halfVectors[i] = importanceSampleGGX(i, settings.brdfSamples, roughness);
+        for (int x = 0; x < size; x++)
+        {
+            float NdotV = (x + 0.5f) / size;
+            glm::vec3 v(std::sqrt(1.0f - NdotV * NdotV), 0.0f, NdotV);
+            float scale = 0.0f, bias = 0.0f;
+            for (const glm::vec3& h : halfVectors)
+            {
+                float VdotH = glm::dot(v, h);
+                glm::vec3 l = 2.0f * VdotH * h - v;
+                float NdotL = l.z;
+                if (NdotL <= 0.0f)
+                    continue;
+                VdotH = std::max(VdotH, 0.0f);
+                float g = NdotV / (NdotV * (1.0f - k) + k) * NdotL / (NdotL * (1.0f - k) + k);
+                float visibility = g * VdotH / (h.z * NdotV);
+                float fresnel = std::pow(1.0f - VdotH, 5.0f);
+                scale += (1.0f - fresnel) * visibility;
+                bias += fresnel * visibility;
+            }
+            lut[row * size + x] = glm::vec2(scale, bias) / (float)settings.brdfSamples;
+        }
+    });
+}
+
+// RGB half floats of a cube's texels, appended
+void appendCubeHalves(const IblCube& cube, std::vector<uint16_t>& halves)
+{
+    size_t texels = (size_t)6 * cube.size * cube.size;
+    size_t offset = halves.size();
+    halves.resize(offset + texels * 3);
+    ThreadPool::instance().parallelFor((texels + 4095) / 4096, [&](size_t chunk) {
+        for (size_t i = chunk * 4096; i < std::min(texels, (chunk + 1) * 4096); i++)
+            for (int c = 0; c < 3; c++)
+                halves[offset + i * 3 + c] = glm::packHalf1x16(cube.texels[i * 4 + c]);
+    });
+}
+
+// everything above from the HDR at 'path', without the cache. false if it can't be read
+bool computeIbl(const std::string& path, const IblSettings& settings, IblData& data)
+{
+    PROFILE_ZONE("computeIbl");
+    int width, height, components;
+    float* image = stbi_loadf(path.c_str(), &width, &height, &components, 4);
+    if (!image)
+    {
+        std::cout << "ERROR::IBL:: could not load " << path << std::endl;
+        return false;
+    }
+    data.settings = settings;
+    std::vector<IblCube> environment(1);
+    environment[0].size = settings.environmentSize;
+    equirectangularToCube(image, width, height, environment[0]);
+    stbi_image_free(image);
+    buildCubeMips(environment);
+
+    projectIrradianceSH(environment[0], data.sh);
+    std::vector<IblCube> prefiltered;
+    prefilterGGX(environment, settings, prefiltered);
+    std::vector<glm::vec2> lut;
+    integrateBrdfLut(settings, lut);
+
+    data.environment.clear();
+    appendCubeHalves(environment[0], data.environment);
+    data.prefiltered.clear();
+    for (const IblCube& level : prefiltered)
+        appendCubeHalves(level, data.prefiltered);
+    data.brdfLut.resize(lut.size() * 2);
+    for (size_t i = 0; i < lut.size(); i++)
+    {
+        data.brdfLut[i * 2] = glm::packHalf1x16(lut[i].x);
+        data.brdfLut[i * 2 + 1] = glm::packHalf1x16(lut[i].y);
+    }
+    return true;
+}
+
+// half floats of each output for 'settings'
+size_t iblEnvironmentHalves(const IblSettings& settings)
+{
+    return (size_t)6 * settings.environmentSize * settings.environmentSize * 3;
+}
+
+size_t iblPrefilteredHalves(const IblSettings& settings)
+{
+    size_t halves = 0;
+    for (int level = 0; level < settings.prefilterLevels; level++)
+    {
+        size_t size = (size_t)std::max(1, settings.prefilterSize >> level);
+        halves += 6 * size * size * 3;
+    }
+    return halves;
+}
+
+size_t iblBrdfLutHalves(const IblSettings& settings)
+{
+    return (size_t)settings.brdfLutSize * settings.brdfLutSize * 2;
+}
+
+struct IblCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceHash;
+    IblSettings settings;
+    float sh[27];
+};
+
+std::string iblCachePath(const std::string& path)
+{
+    return path + ".ibl";
+}
+
+bool readIblCache(const std::string& path, uint64_t sourceHash, const IblSettings& settings, IblData& data)
+{
+    PROFILE_ZONE("readIblCache");
+    MappedFile file;
+    if (!file.open(path) || file.size() < sizeof(IblCacheHeader))
+        return false;
+    IblCacheHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    size_t environment = iblEnvironmentHalves(settings), prefiltered = iblPrefilteredHalves(settings), lut = iblBrdfLutHalves(settings);
+    if (std::memcmp(header.magic, "LIBL", 4) != 0 || header.version != IBL_CACHE_VERSION || header.sourceHash != sourceHash
+        || std::memcmp(&header.settings, &settings, sizeof(IblSettings)) != 0
+        || file.size() != sizeof(header) + (environment + prefiltered + lut) * sizeof(uint16_t))
+        return false;
+
+    data.settings = settings;
+    for (int k = 0; k < 9; k++)
+        data.sh[k] = glm::vec3(header.sh[k * 3], header.sh[k * 3 + 1], header.sh[k * 3 + 2]);
+    const uint16_t* halves = reinterpret_cast<const uint16_t*>(file.data() + sizeof(header));
+    data.environment.assign(halves, halves + environment);
+    data.prefiltered.assign(halves + environment, halves + environment + prefiltered);
+    data.brdfLut.assign(halves + environment + prefiltered, halves + environment + prefiltered + lut);
+    return true;
+}
+
+bool writeIblCache(const std::string& path, uint64_t sourceHash, const IblData& data)
+{
+    PROFILE_ZONE("writeIblCache");
+    IblCacheHeader header;
+    std::memset(static_cast<void*>(&header), 0, sizeof(header)); // padding included, the same inputs write the same file
+    std::memcpy(header.magic, "LIBL", 4);
+    header.version = IBL_CACHE_VERSION;
+    header.sourceHash = sourceHash;
+    header.settings = data.settings;
+    for (int k = 0; k < 9; k++)
+        for (int c = 0; c < 3; c++)
+            header.sh[k * 3 + c] = data.sh[k][c];
+
+    // written aside and renamed, so a reader never sees half a file
+    std::string temporary = path + ".tmp";
+    std::ofstream out(temporary, std::ios::binary);
+    if (!out)
+    {
+        std::cout << "ERROR::IBL:: could not write " << temporary << std::endl;
+        return false;
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(data.environment.data()), (std::streamsize)(data.environment.size() * sizeof(uint16_t)));
+    out.write(reinterpret_cast<const char*>(data.prefiltered.data()), (std::streamsize)(data.prefiltered.size() * sizeof(uint16_t)));
+    out.write(reinterpret_cast<const char*>(data.brdfLut.data()), (std::streamsize)(data.brdfLut.size() * sizeof(uint16_t)));
+    out.close();
+    if (!out)
+    {
+        std::cout << "ERROR::IBL:: could not write " << temporary << std::endl;
+        std::remove(temporary.c_str());
+        return false;
+    }
+    std::remove(path.c_str()); // rename doesn't replace existing files on windows
+    if (std::rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        std::cout << "ERROR::IBL:: could not replace " << path << std::endl;
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+// the IBL inputs of the HDR at 'path', from its cache if still valid, computed and cached otherwise
+bool loadIbl(const std::string& path, const IblSettings& settings, IblData& data, bool* fromCache = nullptr)
+{
+    PROFILE_ZONE("loadIbl");
+    uint64_t hash = 0;
+    {
+        MappedFile source;
+        if (!source.open(path))
+        {
+            std::cout << "ERROR::IBL:: could not load " << path << std::endl;
+            return false;
+        }
+        hash = fnv1a(source.data(), source.size());
+    }
+    std::string cache = iblCachePath(path);
+    if (fromCache)
+        *fromCache = true;
+    if (readIblCache(cache, hash, settings, data))
+        return true;
+    if (fromCache)
+        *fromCache = false;
+    if (!computeIbl(path, settings, data))
+        return false;
+    writeIblCache(cache, hash, data);
+    return true;
+}
+
+// loads (or computes) the IBL inputs of an HDR on the thread pool and uploads them as textures once
+// they are ready:
+//     ibl.start(path);
+//     every frame: if (ibl.update()) ... the textures and sh just became available
+class IblPrecompute
+{
+public:
+    unsigned int environmentMap = 0;  // RGB16F cubemap with mips
+    unsigned int prefilteredMap = 0;  // RGB16F cubemap, roughness (level / (levels - 1)) per mip
+    unsigned int brdfLut = 0;         // RG16F
+    glm::vec3 sh[9];                  // see IblData
+
+    ~IblPrecompute()
+    {
+        if (job)
+            job->cancelled = true;
+        unsigned int textures[3] = { environmentMap, prefilteredMap, brdfLut };
+        glDeleteTextures(3, textures);
+    }
+
+    // starts loading, once
+    void start(const std::string& path, const IblSettings& settings = IblSettings())
+    {
+        if (job)
+            return;
+        job = std::make_shared<Job>();
+        std::shared_ptr<Job> running = job;
+        ThreadPool::instance().submit([running, path, settings]() {
+            std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+            if (!running->cancelled)
+                running->loaded = loadIbl(path, settings, running->data, &running->fromCache);
+            running->milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+            running->done = true;
+        });
+    }
+
+    bool started() const { return job != nullptr; }
+    bool ready() const { return uploaded; }
+    bool failed() const { return job && job->done && !job->loaded; }
+    // how long loading took and whether it came from the cache, once ready
+    double milliseconds() const { return job ? job->milliseconds : 0.0; }
+    bool fromCache() const { return job && job->fromCache; }
+
+    // uploads the textures once the data is in, returns true on that call (GL thread)
+    bool update()
+    {
+        if (!job || uploaded || !job->done || !job->loaded)
+            return false;
+        PROFILE_ZONE("IblPrecompute upload");
+        const IblData& data = job->data;
+        std::copy(data.sh, data.sh + 9, sh);
+        glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+        // the environment's mips are filtered by the driver, the prefiltered map brings its own
+        environmentMap = createCubemap(data.environment.data(), data.settings.environmentSize, 1, cubemapLevelCount(data.settings.environmentSize));
+        glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+        prefilteredMap = createCubemap(data.prefiltered.data(), data.settings.prefilterSize, data.settings.prefilterLevels, data.settings.prefilterLevels);
+
+        glGenTextures(1, &brdfLut);
+        glBindTexture(GL_TEXTURE_2D, brdfLut);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, data.settings.brdfLutSize, data.settings.brdfLutSize, 0, GL_RG, GL_HALF_FLOAT, data.brdfLut.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        // the textures hold it now
+        job->data = IblData();
+        uploaded = true;
+        return true;
+    }
+
+    // blocks until loading is done and uploads, e.g. before a benchmark
+    void finish()
+    {
+        if (!job)
+            return;
+        while (!job->done)
+            std::this_thread::yield();
+        update();
+    }
+
+private:
+    struct Job {
+        IblData data;
+        bool loaded = false;
+        bool fromCache = false;
+        double milliseconds = 0.0;
+        std::atomic<bool> done{ false };
+        std::atomic<bool> cancelled{ false };
+    };
+    std::shared_ptr<Job> job;
+    bool uploaded = false;
+
+    // a cubemap with storage for 'storageLevels' mips, the first 'levels' uploaded from RGB half floats,
+    // all faces of a level before the next level
+    static unsigned int createCubemap(const uint16_t* halves, int size, int levels, int storageLevels)
+    {
+        unsigned int texture = createCubemapStorage(GL_RGB16F, size, storageLevels);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+        for (int level = 0; level < levels; level++)
+        {
+            int levelSize = std::max(1, size >> level);
+            for (int face = 0; face < 6; face++)
+            {
+                uploadCubemapFace(face, level, GL_RGB16F, levelSize, halves, GL_RGB, GL_HALF_FLOAT);
+                halves += (size_t)levelSize * levelSize * 3;
+            }
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        return texture;
+    }
+};
+#endif
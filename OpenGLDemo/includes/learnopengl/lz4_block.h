@@ -0,0 +1,157 @@
+#ifndef LZ4_BLOCK_H
+#define LZ4_BLOCK_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Compressor and decompressor for the LZ4 block format (lz4's lz4_Block_format.md), so packed assets
+// decode at memory speed without a library: a block is a run of sequences, each a token (literal count
+// and match length, 4 bits each, extended by 255 bytes), the literals, and a match as a 16 bit backward
+// offset. blocks written here decode with LZ4_decompress_safe and the other way round.
+//
+// the compressor is the greedy single hash table of lz4's fast mode: a 4 byte match is looked up at every
+// position, and found matches are extended forward. no state between blocks, so blocks can be
+// (de)compressed independently and in parallel.
+
+const int LZ4_MIN_MATCH = 4;
+const int LZ4_LAST_LITERALS = 5; // the last 5 bytes of a block are always literals
+const int LZ4_MATCH_LIMIT = 12;  // and the last match starts at least 12 bytes before its end
+const int LZ4_HASH_BITS = 16;
+const size_t LZ4_MAX_OFFSET = 65535;
+
+// the most a block of 'size' bytes can grow to
+size_t lz4CompressBound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+// appends a length continued past the 4 bits of the token
+unsigned char* lz4WriteLength(unsigned char* out, size_t length)
+{
+    for (; length >= 255; length -= 255)
+        *out++ = 255;
+    *out++ = (unsigned char)length;
+    return out;
+}
+
+// compresses 'size' bytes into 'output' (resized to fit), returns its size
+size_t lz4Compress(const unsigned char* input, size_t size, std::vector<unsigned char>& output)
+{
+    output.resize(lz4CompressBound(size));
+    unsigned char* out = output.data();
+    size_t anchor = 0;
+    if (size > (size_t)LZ4_MATCH_LIMIT)
+    {
+        std::vector<int32_t> table((size_t)1 << LZ4_HASH_BITS, -1);
+        size_t matchEnd = size - LZ4_LAST_LITERALS;
+        size_t last = size - LZ4_MATCH_LIMIT;
+        size_t position = 0;
+        while (position < last)
+        {
+            uint32_t sequence;
+            std::memcpy(&sequence, input + position, 4);
+            uint32_t hash = (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+            int32_t candidate = table[hash];
+            table[hash] = (int32_t)position;
+            uint32_t match;
+            if (candidate < 0 || position - candidate > LZ4_MAX_OFFSET || (std::memcpy(&match, input + candidate, 4), match != sequence))
+            {
+                position++;
+                continue;
+            }
+
+            size_t length = LZ4_MIN_MATCH;
+            while (position + length < matchEnd && input[candidate + length] == input[position + length])
+                length++;
+
+            size_t literals = position - anchor;
+            size_t matchLength = length - LZ4_MIN_MATCH;
+            unsigned char* token = out++;
+            *token = (unsigned char)((std::min<size_t>(literals, 15) << 4) | std::min<size_t>(matchLength, 15));
+            if (literals >= 15)
+                out = lz4WriteLength(out, literals - 15);
+            std::memcpy(out, input + anchor, literals);
+            out += literals;
+            size_t offset = position - candidate;
+            *out++ = (unsigned char)offset;
+            *out++ = (unsigned char)(offset >> 8);
+            if (matchLength >= 15)
+                out = lz4WriteLength(out, matchLength - 15);
+
+            position += length;
+            anchor = position;
+        }
+    }
+
+    // the rest as literals
+    size_t literals = size - anchor;
+    *out++ = (unsigned char)(std::min<size_t>(literals, 15) << 4);
+    if (literals >= 15)
+        out = lz4WriteLength(out, literals - 15);
+    std::memcpy(out, input + anchor, literals);
+    out += literals;
+    output.resize(out - output.data());
+    return output.size();
+}
+
+// decompresses a block into exactly 'outputSize' bytes. false if the block is malformed or doesn't fill
+// the output exactly; never reads or writes out of bounds
+bool lz4Decompress(const unsigned char* input, size_t inputSize, unsigned char* output, size_t outputSize)
+{
+    size_t in = 0, out = 0;
+    while (in < inputSize)
+    {
+        unsigned char token = input[in++];
+        size_t literals = token >> 4;
+        if (literals == 15)
+        {
+            unsigned char more;
+            do
+            {
+                if (in >= inputSize)
+                    return false;
+                more = input[in++];
+                literals += more;
+            } while (more == 255);
+        }
+        if (literals > inputSize - in || literals > outputSize - out)
+            return false;
+        std::memcpy(output + out, input + in, literals);
+        in += literals;
+        out += literals;
+        if (in == inputSize)
+            break; // the last sequence has no match
+
+        if (inputSize - in < 2)
+            return false;
+        size_t offset = input[in] | ((size_t)input[in + 1] << 8);
+        in += 2;
+        size_t length = token & 15;
+        if (length == 15)
+        {
+            unsigned char more;
+            do
+            {
+                if (in >= inputSize)
+                    return false;
+                more = input[in++];
+                length += more;
+            } while (more == 255);
+        }
+        length += LZ4_MIN_MATCH;
+        if (offset == 0 || offset > out || length > outputSize - out)
+            return false;
+        const unsigned char* source = output + out - offset;
+        if (offset >= length)
+            std::memcpy(output + out, source, length);
+        else
+            for (size_t i = 0; i < length; i++) // overlapping: repeats the last 'offset' bytes
+                output[out + i] = source[i];
+        out += length;
+    }
+    return out == outputSize;
+}
+#endif
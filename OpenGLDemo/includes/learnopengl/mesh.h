@@ -5,9 +5,13 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
 
 #include <learnopengl/shader.h>
+#include <learnopengl/meshlet.h>
 
+#include <algorithm>
+#include <cstdint>
 #include <string>
 #include <vector>
 using namespace std;
@@ -31,76 +35,509 @@ struct Vertex {
 	float m_Weights[MAX_BONE_INFLUENCE];
 };
 
+// Layouts a mesh can keep its vertices in on the GPU, picked when the mesh is created. Vertex stays the
+// CPU side layout for all of them; the smaller ones are packed from it on upload and feed the same
+// attribute locations, so shaders don't need to know which one a mesh uses. The one exception is
+// VERTEX_FORMAT_QUANTIZED: its positions are in [0, 1] across the mesh bounds, and the vertex shader
+// has to scale them back with the positionScale / positionOffset uniforms Mesh::Draw sets.
+enum VertexFormat {
+    VERTEX_FORMAT_FULL,         // Vertex as is, 88 bytes
+    VERTEX_FORMAT_STATIC,       // float attributes without the bone data, 56 bytes
+    VERTEX_FORMAT_PACKED,       // float position, snorm 10:10:10:2 normal/tangent/bitangent, half float uv, 28 bytes
+    VERTEX_FORMAT_QUANTIZED     // as packed, with 16 bit unorm positions relative to the mesh bounds, 24 bytes
+};
+
+struct StaticVertex {
+    glm::vec3 Position;
+    glm::vec3 Normal;
+    glm::vec2 TexCoords;
+    glm::vec3 Tangent;
+    glm::vec3 Bitangent;
+};
+
+struct PackedVertex {
+    glm::vec3 Position;
+    uint32_t Normal;        // GL_INT_2_10_10_10_REV
+    uint32_t TexCoords;     // 2 x GL_HALF_FLOAT
+    uint32_t Tangent;
+    uint32_t Bitangent;
+};
+
+struct QuantizedVertex {
+    uint16_t Position[4];   // GL_UNSIGNED_SHORT, normalized; the 4th one pads to 4 byte alignment
+    uint32_t Normal;
+    uint32_t TexCoords;
+    uint32_t Tangent;
+    uint32_t Bitangent;
+};
+
+inline size_t vertexFormatSize(VertexFormat format)
+{
+    switch (format)
+    {
+    case VERTEX_FORMAT_STATIC: return sizeof(StaticVertex);
+    case VERTEX_FORMAT_PACKED: return sizeof(PackedVertex);
+    case VERTEX_FORMAT_QUANTIZED: return sizeof(QuantizedVertex);
+    default: return sizeof(Vertex);
+    }
+}
+
+inline const char* vertexFormatName(VertexFormat format)
+{
+    switch (format)
+    {
+    case VERTEX_FORMAT_STATIC: return "static";
+    case VERTEX_FORMAT_PACKED: return "packed";
+    case VERTEX_FORMAT_QUANTIZED: return "quantized";
+    default: return "full";
+    }
+}
+
+// a simplified version of a mesh, drawn from the same vertex buffer
+struct MeshLod {
+    vector<unsigned int> indices;
+    float error;    // how far the surface moved, relative to the largest extent of the mesh bounds
+};
+
+// the projected error, in pixels, Mesh::selectLod lets a LOD have
+const float LOD_PIXEL_ERROR = 1.0f;
+
 struct Texture {
     unsigned int id;
     string type;
     string path;
 };
 
+// what a mesh keeps in memory once its buffers are on the GPU, see Mesh::releaseCpuGeometry
+enum CpuGeometry {
+    CPU_GEOMETRY_FULL,          // vertices, indices and LOD indices, for code that reads them
+    CPU_GEOMETRY_COLLISION,     // positions (collisionPositions) and full detail indices only
+    CPU_GEOMETRY_NONE           // nothing but the bounds, meshlets and counts
+};
+
+// snorm 10:10:10:2, unit length directions keep about 3 decimal digits per component
+uint32_t packDirection(const glm::vec3& direction)
+{
+    return glm::packSnorm3x10_1x2(glm::vec4(direction, 0.0f));
+}
+
+// normal, uv, tangent and bitangent of the packed layouts, which share their order
+void setupPackedAttributes(size_t stride, size_t normalOffset)
+{
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, (GLsizei)stride, (void*)normalOffset);
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, (GLsizei)stride, (void*)(normalOffset + 4));
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 4, GL_INT_2_10_10_10_REV, GL_TRUE, (GLsizei)stride, (void*)(normalOffset + 8));
+    glEnableVertexAttribArray(4);
+    glVertexAttribPointer(4, 4, GL_INT_2_10_10_10_REV, GL_TRUE, (GLsizei)stride, (void*)(normalOffset + 12));
+}
+
+// writes vertices in a format to destination, vertexFormatSize(format) bytes each. quantized positions are
+// relative to the given bounds.
+void packVertices(const Vertex* vertexData, size_t vertexCount, VertexFormat format, const glm::vec3& boundsMin, const glm::vec3& boundsMax, void* destination)
+{
+    unsigned char* packed = static_cast<unsigned char*>(destination);
+    if (format == VERTEX_FORMAT_FULL)
+    {
+        std::copy(vertexData, vertexData + vertexCount, reinterpret_cast<Vertex*>(packed));
+        return;
+    }
+    glm::vec3 extent = boundsMax - boundsMin;
+    glm::vec3 inverseExtent(extent.x > 0.0f ? 1.0f / extent.x : 0.0f, extent.y > 0.0f ? 1.0f / extent.y : 0.0f, extent.z > 0.0f ? 1.0f / extent.z : 0.0f);
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        const Vertex& vertex = vertexData[i];
+        if (format == VERTEX_FORMAT_STATIC)
+        {
+            StaticVertex& out = reinterpret_cast<StaticVertex*>(packed)[i];
+            out.Position = vertex.Position;
+            out.Normal = vertex.Normal;
+            out.TexCoords = vertex.TexCoords;
+            out.Tangent = vertex.Tangent;
+            out.Bitangent = vertex.Bitangent;
+        }
+        else if (format == VERTEX_FORMAT_PACKED)
+        {
+            PackedVertex& out = reinterpret_cast<PackedVertex*>(packed)[i];
+            out.Position = vertex.Position;
+            out.Normal = packDirection(vertex.Normal);
+            out.TexCoords = glm::packHalf2x16(vertex.TexCoords);
+            out.Tangent = packDirection(vertex.Tangent);
+            out.Bitangent = packDirection(vertex.Bitangent);
+        }
+        else
+        {
+            QuantizedVertex& out = reinterpret_cast<QuantizedVertex*>(packed)[i];
+            glm::vec3 position = glm::clamp((vertex.Position - boundsMin) * inverseExtent, 0.0f, 1.0f);
+            for (int axis = 0; axis < 3; axis++)
+                out.Position[axis] = (uint16_t)(position[axis] * 65535.0f + 0.5f);
+            out.Position[3] = 0;
+            out.Normal = packDirection(vertex.Normal);
+            out.TexCoords = glm::packHalf2x16(vertex.TexCoords);
+            out.Tangent = packDirection(vertex.Tangent);
+            out.Bitangent = packDirection(vertex.Bitangent);
+        }
+    }
+}
+
+// writes indices to destination as GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+void packIndices(const unsigned int* indexData, size_t indexCount, GLenum indexType, void* destination)
+{
+    if (indexType == GL_UNSIGNED_SHORT)
+        std::copy(indexData, indexData + indexCount, static_cast<uint16_t*>(destination));
+    else
+        std::copy(indexData, indexData + indexCount, static_cast<unsigned int*>(destination));
+}
+
+// fills size bytes at offset of the buffer bound to target, which has its storage already, with what
+// fill(void*) writes. the buffer is mapped so the data is written once, straight where the driver wants
+// it; a temporary array is the fallback if it can't be.
+template <typename Fill>
+void fillBuffer(GLenum target, size_t offset, size_t size, Fill fill)
+{
+    if (size == 0)
+        return;
+    void* mapped = glMapBufferRange(target, (GLintptr)offset, (GLsizeiptr)size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+    if (mapped)
+    {
+        fill(mapped);
+        if (glUnmapBuffer(target) == GL_TRUE)
+            return;
+        // the contents were lost while mapped (e.g. a display mode change), write them again below
+    }
+    vector<unsigned char> staging(size);
+    fill(staging.data());
+    glBufferSubData(target, (GLintptr)offset, (GLsizeiptr)size, staging.data());
+}
+
+// sets the attribute pointers of a vertex buffer in the given format, bound to GL_ARRAY_BUFFER, on the
+// bound VAO
+void setupVertexAttributes(VertexFormat format)
+{
+    switch (format)
+    {
+    case VERTEX_FORMAT_STATIC:
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(StaticVertex), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(StaticVertex), (void*)offsetof(StaticVertex, Normal));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(StaticVertex), (void*)offsetof(StaticVertex, TexCoords));
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(StaticVertex), (void*)offsetof(StaticVertex, Tangent));
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(StaticVertex), (void*)offsetof(StaticVertex, Bitangent));
+        break;
+    case VERTEX_FORMAT_PACKED:
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)0);
+        setupPackedAttributes(sizeof(PackedVertex), offsetof(PackedVertex, Normal));
+        break;
+    case VERTEX_FORMAT_QUANTIZED:
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(QuantizedVertex), (void*)0);
+        setupPackedAttributes(sizeof(QuantizedVertex), offsetof(QuantizedVertex, Normal));
+        break;
+    default:
+        // vertex Positions
+        glEnableVertexAttribArray(0);	
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+        // vertex normals
+        glEnableVertexAttribArray(1);	
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+        // vertex texture coords
+        glEnableVertexAttribArray(2);	
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+        // vertex tangent
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
+        // vertex bitangent
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+        // ids
+        glEnableVertexAttribArray(5);
+        glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, m_BoneIDs));
+        // weights
+        glEnableVertexAttribArray(6);
+        glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
+        break;
+    }
+}
+
+// binds the textures of a mesh to consecutive units and points the samplers following the
+// texture_diffuseN / texture_specularN / texture_normalN / texture_heightN convention at them
+void bindTextures(Shader &shader, const vector<Texture> &textures)
+{
+    unsigned int diffuseNr  = 1;
+    unsigned int specularNr = 1;
+    unsigned int normalNr   = 1;
+    unsigned int heightNr   = 1;
+    for(unsigned int i = 0; i < textures.size(); i++)
+    {
+        glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
+        // retrieve texture number (the N in diffuse_textureN)
+        string number;
+        string name = textures[i].type;
+        if(name == "texture_diffuse")
+            number = std::to_string(diffuseNr++);
+        else if(name == "texture_specular")
+            number = std::to_string(specularNr++); // transfer unsigned int to string
+        else if(name == "texture_normal")
+            number = std::to_string(normalNr++); // transfer unsigned int to string
+         else if(name == "texture_height")
+            number = std::to_string(heightNr++); // transfer unsigned int to string
+
+        // now set the sampler to the correct texture unit
+        glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
+        // and finally bind the texture
+        glBindTexture(GL_TEXTURE_2D, textures[i].id);
+    }
+}
+
 class Mesh {
 public:
-    // mesh Data
+    // mesh Data. empty once released, see releaseCpuGeometry
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
-    unsigned int VAO;
+    vector<glm::vec3>    collisionPositions;    // with CPU_GEOMETRY_COLLISION, what's left of vertices
+    unsigned int VAO = 0;   // 0 for meshes drawn through a GeometryArena, which holds their buffers
+    // layout of the vertex buffer, and the object space bounds of the vertices
+    VertexFormat format;
+    GLenum indexType;   // GL_UNSIGNED_SHORT when every index fits, GL_UNSIGNED_INT otherwise
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    // coarser versions of indices, from fine to coarse. LOD 0 is the mesh itself, LOD i is lods[i - 1].
+    vector<MeshLod> lods;
+    // clusters of the full detail indices, for culling parts of the mesh (see meshlet.h)
+    vector<Meshlet> meshlets;
+    MeshletBounds meshletBounds;
 
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    // constructor. format is what the mesh would like to be stored as, meshes with bone weights stay
+    // VERTEX_FORMAT_FULL since the compact layouts have no room for them.
+    // meshlets are runs of indices built by buildMeshlets(), without them they are cut from the index order.
+    // without createBuffers the mesh gets no GL objects of its own and is only drawn through a GeometryArena.
+    // the arrays are taken over, pass them with std::move to have them end up in the mesh without a copy.
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, VertexFormat format = VERTEX_FORMAT_FULL,
+         vector<MeshLod> lods = vector<MeshLod>(), vector<Meshlet> meshlets = vector<Meshlet>(), bool createBuffers = true)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        this->vertices = std::move(vertices);
+        this->indices = std::move(indices);
+        this->textures = std::move(textures);
+        this->format = format;
+        this->lods = std::move(lods);
+        this->meshlets = std::move(meshlets);
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        setupMesh(this->vertices.data(), this->vertices.size(), this->indices.data(), this->indices.size(), createBuffers);
+    }
+
+    // constructor for data that lives elsewhere, e.g. in a memory mapped mesh cache: the buffers are filled
+    // straight from it, the mesh keeps its own copy for code that reads the vertices on the CPU (and for a
+    // GeometryArena to upload from) until releaseCpuGeometry. bounds, if given, are the vertices' bounds
+    // as cooked (min, max) and aren't computed again
+    Mesh(const Vertex* vertexData, size_t vertexCount, const unsigned int* indexData, size_t indexCount, vector<Texture> textures,
+         VertexFormat format = VERTEX_FORMAT_FULL, vector<MeshLod> lods = vector<MeshLod>(), vector<Meshlet> meshlets = vector<Meshlet>(),
+         bool createBuffers = true, const glm::vec3* bounds = nullptr)
+    {
+        this->textures = std::move(textures);
+        this->format = format;
+        this->lods = std::move(lods);
+        this->meshlets = std::move(meshlets);
+        setupMesh(vertexData, vertexCount, indexData, indexCount, createBuffers, bounds);
+        this->vertices.assign(vertexData, vertexData + vertexCount);
+        this->indices.assign(indexData, indexData + indexCount);
+    }
+
+    unsigned int lodCount() const
+    {
+        return static_cast<unsigned int>(lods.size()) + 1;
+    }
+
+    // the coarsest LOD whose error stays below maxPixelError when the mesh's bounding sphere covers
+    // projectedRadius pixels on screen
+    unsigned int selectLod(float projectedRadius, float maxPixelError = LOD_PIXEL_ERROR) const
+    {
+        glm::vec3 extent = boundsMax - boundsMin;
+        float radius = 0.5f * glm::length(extent);
+        if (radius <= 0.0f)
+            return 0;
+        // errors are relative to the largest extent, turn them into pixels via the sphere
+        float pixelsPerError = std::max(std::max(extent.x, extent.y), extent.z) / radius * projectedRadius;
+        unsigned int lod = 0;
+        while (lod < lods.size() && lods[lod].error * pixelsPerError <= maxPixelError)
+            lod++;
+        return lod;
+    }
+
+    // triangles drawn at a LOD
+    size_t triangleCount(unsigned int lod = 0) const
+    {
+        return lodIndexCounts[lod] / 3;
+    }
+
+    size_t vertexCount() const
+    {
+        return uploadedVertexCount;
+    }
+
+    // frees what the GPU copy makes redundant. everything drawing and culling needs stays, code reading
+    // vertices or indices afterwards gets what keep asks for. the buffers must be uploaded by then, which
+    // for meshes without their own means a GeometryArena built from them.
+    void releaseCpuGeometry(CpuGeometry keep)
+    {
+        if (keep == CPU_GEOMETRY_FULL)
+            return;
+        if (keep == CPU_GEOMETRY_COLLISION)
+        {
+            collisionPositions.resize(vertices.size());
+            for (size_t i = 0; i < vertices.size(); i++)
+                collisionPositions[i] = vertices[i].Position;
+        }
+        else
+            vector<unsigned int>().swap(indices);
+        // swapped with empty ones, clear() would keep the capacity
+        vector<Vertex>().swap(vertices);
+        for (MeshLod& lod : lods)
+            vector<unsigned int>().swap(lod.indices);
     }
 
     // render the mesh
-    void Draw(Shader &shader) 
-    {
-        // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
-        for(unsigned int i = 0; i < textures.size(); i++)
+    void Draw(Shader &shader, unsigned int lod = 0)
+    {
+        if (VAO == 0)
+            return;
+        beginDraw(shader);
+        lod = std::min(lod, lodCount() - 1);
+        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(triangleCount(lod) * 3), indexType, (void*)lodOffsets[lod]);
+        endDraw(shader);
+    }
+
+    // culls the meshlets against a view and prepares DrawCulled() to draw the visible ones, returns their
+    // triangle count. CPU only, meshes can be culled in parallel.
+    size_t cullMeshlets(const MeshletCullParams &params)
+    {
+        ::cullMeshlets(meshletBounds, params, meshletVisible);
+        // neighbouring visible meshlets are neighbouring index ranges, merge them into one draw
+        visibleRanges.clear();
+        size_t visibleIndices = 0;
+        for (size_t i = 0; i < meshlets.size(); i++)
+        {
+            if (!meshletVisible[i])
+                continue;
+            const Meshlet &meshlet = meshlets[i];
+            if (i > 0 && meshletVisible[i - 1])
+                visibleRanges.back().indexCount += meshlet.indexCount;
+            else
+                visibleRanges.push_back(meshlet);
+            visibleIndices += meshlet.indexCount;
+        }
+        return visibleIndices / 3;
+    }
+
+    // the index ranges the last cullMeshlets() call found visible
+    const vector<Meshlet>& culledRanges() const
+    {
+        return visibleRanges;
+    }
+
+    // draws the meshlets the last cullMeshlets() call found visible, at full detail
+    void DrawCulled(Shader &shader)
+    {
+        if (VAO == 0 || visibleRanges.empty())
+            return;
+        size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
+        drawCounts.clear();
+        drawOffsets.clear();
+        for (const Meshlet &range : visibleRanges)
+        {
+            drawCounts.push_back(range.indexCount);
+            drawOffsets.push_back((const void*)(range.firstIndex * indexSize));
+        }
+        beginDraw(shader);
+        glMultiDrawElements(GL_TRIANGLES, drawCounts.data(), indexType, drawOffsets.data(), static_cast<GLsizei>(drawCounts.size()));
+        endDraw(shader);
+    }
+
+private:
+    // render data 
+    unsigned int VBO = 0, EBO = 0;
+    vector<size_t> lodOffsets; // byte offset of every LOD's indices in EBO
+    vector<size_t> lodIndexCounts;
+    size_t uploadedVertexCount = 0;
+    // result of the last cullMeshlets()
+    vector<unsigned char> meshletVisible;
+    vector<Meshlet> visibleRanges;
+    vector<GLsizei> drawCounts;
+    vector<const void*> drawOffsets;
+
+    // binds the textures and sets the uniforms the mesh needs, then its VAO
+    void beginDraw(Shader &shader)
+    {
+        bindTextures(shader, textures);
+
+        // quantized positions are scaled back into the bounds by the vertex shader
+        if (format == VERTEX_FORMAT_QUANTIZED)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if(name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to string
-            else if(name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to string
-             else if(name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to string
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            shader.setVec3("positionScale", boundsMax - boundsMin);
+            shader.setVec3("positionOffset", boundsMin);
         }
-        
-        // draw mesh
+
         glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
+    }
+
+    void endDraw(Shader &shader)
+    {
         glBindVertexArray(0);
 
+        // back to the identity for whatever is drawn with the shader next
+        if (format == VERTEX_FORMAT_QUANTIZED)
+        {
+            shader.setVec3("positionScale", glm::vec3(1.0f));
+            shader.setVec3("positionOffset", glm::vec3(0.0f));
+        }
+
         // always good practice to set everything back to defaults once configured.
         glActiveTexture(GL_TEXTURE0);
     }
 
-private:
-    // render data 
-    unsigned int VBO, EBO;
-
     // initializes all the buffer objects/arrays
-    void setupMesh()
+    void setupMesh(const Vertex* vertexData, size_t vertexCount, const unsigned int* indexData, size_t indexCount, bool createBuffers,
+                   const glm::vec3* bounds = nullptr)
     {
+        boundsMin = boundsMax = vertexCount > 0 ? vertexData[0].Position : glm::vec3(0.0f);
+        if (bounds)
+        {
+            boundsMin = bounds[0];
+            boundsMax = bounds[1];
+        }
+        bool hasBones = false;
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            if (!bounds)
+            {
+                boundsMin = glm::min(boundsMin, vertexData[i].Position);
+                boundsMax = glm::max(boundsMax, vertexData[i].Position);
+            }
+            for (int j = 0; j < MAX_BONE_INFLUENCE; j++)
+                hasBones = hasBones || vertexData[i].m_Weights[j] != 0.0f;
+        }
+        if (hasBones)
+            format = VERTEX_FORMAT_FULL;
+        if (meshlets.empty())
+            splitMeshlets(indexData, indexCount, meshlets);
+        if (vertexCount > 0)
+            computeMeshletBounds(indexData, &vertexData[0].Position.x, sizeof(Vertex), meshlets, meshletBounds);
+        indexType = vertexCount <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        uploadedVertexCount = vertexCount;
+        lodIndexCounts.assign(1, indexCount);
+        for (const MeshLod& lod : lods)
+            lodIndexCounts.push_back(lod.indices.size());
+        if (!createBuffers)
+            return;
+
         // create buffers/arrays
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
@@ -112,34 +549,40 @@ private:
         // A great thing about structs is that their memory layout is sequential for all its items.
         // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
         // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);  
+        // The compact formats are packed straight into the mapped buffer.
+        size_t vertexBytes = vertexCount * vertexFormatSize(format);
+        glBufferData(GL_ARRAY_BUFFER, vertexBytes, NULL, GL_STATIC_DRAW);
+        fillBuffer(GL_ARRAY_BUFFER, 0, vertexBytes, [&](void* destination) {
+            packVertices(vertexData, vertexCount, format, boundsMin, boundsMax, destination);
+        });
 
+        // all LODs go into one index buffer, one after the other. the CPU copy stays 32 bit, the GPU gets
+        // half the index bandwidth whenever the vertices allow it
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-        // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);	
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);	
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);	
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-		// ids
-		glEnableVertexAttribArray(5);
-		glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, m_BoneIDs));
+        size_t indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(unsigned int);
+        size_t totalIndexCount = indexCount;
+        for (const MeshLod& lod : lods)
+            totalIndexCount += lod.indices.size();
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, totalIndexCount * indexSize, NULL, GL_STATIC_DRAW);
+        fillBuffer(GL_ELEMENT_ARRAY_BUFFER, 0, totalIndexCount * indexSize, [&](void* destination) {
+            unsigned char* out = static_cast<unsigned char*>(destination);
+            packIndices(indexData, indexCount, indexType, out);
+            out += indexCount * indexSize;
+            for (const MeshLod& lod : lods)
+            {
+                packIndices(lod.indices.data(), lod.indices.size(), indexType, out);
+                out += lod.indices.size() * indexSize;
+            }
+        });
+        lodOffsets.assign(1, 0);
+        size_t offset = indexCount * indexSize;
+        for (const MeshLod& lod : lods)
+        {
+            lodOffsets.push_back(offset);
+            offset += lod.indices.size() * indexSize;
+        }
 
-		// weights
-		glEnableVertexAttribArray(6);
-		glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
+        setupVertexAttributes(format);
         glBindVertexArray(0);
     }
 };
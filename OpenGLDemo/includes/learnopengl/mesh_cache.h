@@ -0,0 +1,396 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/filesystem.h>
+#include <learnopengl/hash.h>
+#include <learnopengl/mapped_file.h>
+#include <learnopengl/profiler.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Cooked meshes, so a model only goes through assimp the first time it is loaded. The cache is written
+// next to the source ("backpack.obj" -> "backpack.obj.meshcache") and stays valid as long as the hash of
+// the source (plus the material libraries an OBJ references) and the import flags match.
+//
+//     MeshCacheHeader
+//     MeshCacheEntry[meshCount]          per mesh: where its vertices and indices are, its textures, its bounds
+//     MeshCacheTexture[textureCount]     texture references, as offsets into the string block
+//     MeshCacheLod[lodCount]             simplified index lists of the meshes
+//     Meshlet[meshletCount]              meshlets of the meshes, as runs of their own indices
+//     char[stringsSize]                  texture types and paths
+//     per mesh: Vertex[vertexCount], unsigned int[indexCount], unsigned int[lod indexCount]...
+//                                        each array 16 byte aligned
+//
+// the vertices are kept in the full layout whatever format the meshes use on the GPU, so one cache serves
+// every VertexFormat; the compact ones are packed from it on upload.
+//
+// everything little endian, laid out so a mapped file can be used in place.
+
+const char MESH_CACHE_MAGIC[4] = { 'L', 'M', 'S', 'H' };
+const uint32_t MESH_CACHE_VERSION = 4;  // 2: meshes are optimized (see mesh_optimizer.h) before cooking, 3: LODs, 4: meshlets
+
+struct MeshCacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceHash;
+    uint32_t vertexSize;    // sizeof(Vertex) when cooked, a changed Vertex layout invalidates the cache
+    uint32_t meshCount;
+    uint32_t textureCount;
+    uint32_t lodCount;
+    uint32_t stringsSize;
+    uint32_t meshletCount;
+    uint64_t fileSize;
+};
+
+struct MeshCacheEntry {
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t firstTexture;
+    uint32_t textureCount;
+    uint32_t firstLod;
+    uint32_t lodCount;
+    uint32_t firstMeshlet;
+    uint32_t meshletCount;
+    float boundsMin[3];
+    float boundsMax[3];
+};
+
+struct MeshCacheTexture {
+    uint32_t typeOffset;
+    uint32_t typeLength;
+    uint32_t pathOffset;
+    uint32_t pathLength;
+};
+
+struct MeshCacheLod {
+    uint64_t indexOffset;
+    uint32_t indexCount;
+    float error;
+};
+
+// a mesh as stored in the cache, vertices and indices point into the mapping
+struct CookedMesh {
+    const Vertex* vertices;
+    uint32_t vertexCount;
+    const unsigned int* indices;
+    uint32_t indexCount;
+    vector<Texture> textures; // type and path only, the textures still have to be loaded
+    vector<MeshLod> lods;
+    vector<Meshlet> meshlets;
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+};
+
+class MeshCache
+{
+public:
+    static string cachePath(const string& sourcePath)
+    {
+        return sourcePath + ".meshcache";
+    }
+
+    // hash of everything the cooked meshes are derived from: the source file, the material libraries
+    // of an OBJ and the assimp import flags. returns 0 if the source can't be read.
+    static uint64_t sourceHash(const string& sourcePath, unsigned int importFlags)
+    {
+        PROFILE_ZONE("MeshCache::sourceHash");
+        string source;
+        if (!FileSystem::readFile(sourcePath, source))
+            return 0;
+        uint64_t hash = fnv1a(source);
+        hash = fnv1a(&importFlags, sizeof(importFlags), hash);
+
+        string extension = sourcePath.substr(sourcePath.find_last_of('.') + 1);
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        if (extension == "obj")
+        {
+            string directory = sourcePath.substr(0, sourcePath.find_last_of('/'));
+            std::istringstream lines(source);
+            string line;
+            while (std::getline(lines, line))
+            {
+                if (line.compare(0, 7, "mtllib ") != 0)
+                    continue;
+                string library = line.substr(7);
+                library.erase(library.find_last_not_of(" \t\r") + 1);
+                string material;
+                if (FileSystem::readFile(directory + '/' + library, material))
+                    hash = fnv1a(material, hash);
+            }
+        }
+        return hash;
+    }
+
+    // maps a cache and checks it belongs to the given source hash, false on a miss
+    bool open(const string& path, uint64_t sourceHash)
+    {
+        PROFILE_ZONE("MeshCache::open");
+        if (!file.open(path))
+            return false;
+        if (!validate(sourceHash))
+        {
+            file.close();
+            return false;
+        }
+        return true;
+    }
+
+    size_t meshCount() const
+    {
+        return header()->meshCount;
+    }
+
+    CookedMesh mesh(size_t index) const
+    {
+        const MeshCacheEntry& entry = entries()[index];
+        CookedMesh mesh;
+        mesh.vertices = reinterpret_cast<const Vertex*>(file.data() + entry.vertexOffset);
+        mesh.vertexCount = entry.vertexCount;
+        mesh.indices = reinterpret_cast<const unsigned int*>(file.data() + entry.indexOffset);
+        mesh.indexCount = entry.indexCount;
+        mesh.boundsMin = glm::vec3(entry.boundsMin[0], entry.boundsMin[1], entry.boundsMin[2]);
+        mesh.boundsMax = glm::vec3(entry.boundsMax[0], entry.boundsMax[1], entry.boundsMax[2]);
+        for (uint32_t i = 0; i < entry.textureCount; i++)
+        {
+            const MeshCacheTexture& reference = textures()[entry.firstTexture + i];
+            Texture texture;
+            texture.id = 0;
+            texture.type.assign(strings() + reference.typeOffset, reference.typeLength);
+            texture.path.assign(strings() + reference.pathOffset, reference.pathLength);
+            mesh.textures.push_back(texture);
+        }
+        for (uint32_t i = 0; i < entry.lodCount; i++)
+        {
+            const MeshCacheLod& lod = lods()[entry.firstLod + i];
+            const unsigned int* indices = reinterpret_cast<const unsigned int*>(file.data() + lod.indexOffset);
+            mesh.lods.push_back(MeshLod{ vector<unsigned int>(indices, indices + lod.indexCount), lod.error });
+        }
+        mesh.meshlets.assign(meshlets() + entry.firstMeshlet, meshlets() + entry.firstMeshlet + entry.meshletCount);
+        return mesh;
+    }
+
+    // cooks the meshes of a model into a cache file. writes to a temporary file first, so a crash
+    // or a concurrent loader never sees a half written cache.
+    static bool write(const string& path, uint64_t sourceHash, const vector<Mesh>& meshes)
+    {
+        PROFILE_ZONE("MeshCache::write");
+        vector<MeshCacheEntry> entries(meshes.size());
+        vector<MeshCacheTexture> references;
+        vector<MeshCacheLod> lods;
+        vector<Meshlet> meshlets;
+        string strings;
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            const Mesh& mesh = meshes[i];
+            MeshCacheEntry& entry = entries[i];
+            entry.vertexCount = (uint32_t)mesh.vertices.size();
+            entry.indexCount = (uint32_t)mesh.indices.size();
+            entry.firstTexture = (uint32_t)references.size();
+            entry.textureCount = (uint32_t)mesh.textures.size();
+            entry.firstLod = (uint32_t)lods.size();
+            entry.lodCount = (uint32_t)mesh.lods.size();
+            for (const MeshLod& lod : mesh.lods)
+                lods.push_back(MeshCacheLod{ 0, (uint32_t)lod.indices.size(), lod.error });
+            entry.firstMeshlet = (uint32_t)meshlets.size();
+            entry.meshletCount = (uint32_t)mesh.meshlets.size();
+            meshlets.insert(meshlets.end(), mesh.meshlets.begin(), mesh.meshlets.end());
+            for (int axis = 0; axis < 3; axis++)
+            {
+                entry.boundsMin[axis] = mesh.boundsMin[axis];
+                entry.boundsMax[axis] = mesh.boundsMax[axis];
+            }
+            for (const Texture& texture : mesh.textures)
+            {
+                MeshCacheTexture reference;
+                reference.typeOffset = (uint32_t)strings.size();
+                reference.typeLength = (uint32_t)texture.type.size();
+                strings += texture.type;
+                reference.pathOffset = (uint32_t)strings.size();
+                reference.pathLength = (uint32_t)texture.path.size();
+                strings += texture.path;
+                references.push_back(reference);
+            }
+        }
+
+        // lay out the vertex and index arrays behind the tables
+        uint64_t offset = align(sizeof(MeshCacheHeader) + entries.size() * sizeof(MeshCacheEntry)
+            + references.size() * sizeof(MeshCacheTexture) + lods.size() * sizeof(MeshCacheLod)
+            + meshlets.size() * sizeof(Meshlet) + strings.size());
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            entries[i].vertexOffset = offset;
+            offset = align(offset + (uint64_t)entries[i].vertexCount * sizeof(Vertex));
+            entries[i].indexOffset = offset;
+            offset = align(offset + (uint64_t)entries[i].indexCount * sizeof(unsigned int));
+            for (uint32_t j = 0; j < entries[i].lodCount; j++)
+            {
+                MeshCacheLod& lod = lods[entries[i].firstLod + j];
+                lod.indexOffset = offset;
+                offset = align(offset + (uint64_t)lod.indexCount * sizeof(unsigned int));
+            }
+        }
+
+        MeshCacheHeader header;
+        std::memcpy(header.magic, MESH_CACHE_MAGIC, 4);
+        header.version = MESH_CACHE_VERSION;
+        header.sourceHash = sourceHash;
+        header.vertexSize = sizeof(Vertex);
+        header.meshCount = (uint32_t)meshes.size();
+        header.textureCount = (uint32_t)references.size();
+        header.lodCount = (uint32_t)lods.size();
+        header.meshletCount = (uint32_t)meshlets.size();
+        header.stringsSize = (uint32_t)strings.size();
+        header.fileSize = offset;
+
+        // a model read from the resource pack may not have its directory on disk yet
+        std::error_code error;
+        std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+        string temporary = path + ".tmp";
+        std::ofstream out(temporary, std::ios::binary);
+        if (!out)
+        {
+            std::cout << "ERROR::MESH_CACHE:: could not write " << temporary << std::endl;
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(MeshCacheEntry));
+        out.write(reinterpret_cast<const char*>(references.data()), references.size() * sizeof(MeshCacheTexture));
+        out.write(reinterpret_cast<const char*>(lods.data()), lods.size() * sizeof(MeshCacheLod));
+        out.write(reinterpret_cast<const char*>(meshlets.data()), meshlets.size() * sizeof(Meshlet));
+        out.write(strings.data(), strings.size());
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            pad(out, entries[i].vertexOffset);
+            out.write(reinterpret_cast<const char*>(meshes[i].vertices.data()), meshes[i].vertices.size() * sizeof(Vertex));
+            pad(out, entries[i].indexOffset);
+            out.write(reinterpret_cast<const char*>(meshes[i].indices.data()), meshes[i].indices.size() * sizeof(unsigned int));
+            for (uint32_t j = 0; j < entries[i].lodCount; j++)
+            {
+                pad(out, lods[entries[i].firstLod + j].indexOffset);
+                const vector<unsigned int>& indices = meshes[i].lods[j].indices;
+                out.write(reinterpret_cast<const char*>(indices.data()), indices.size() * sizeof(unsigned int));
+            }
+        }
+        pad(out, offset);
+        out.close();
+        if (!out)
+        {
+            std::cout << "ERROR::MESH_CACHE:: could not write " << temporary << std::endl;
+            std::remove(temporary.c_str());
+            return false;
+        }
+        std::remove(path.c_str()); // rename doesn't replace existing files on windows
+        if (std::rename(temporary.c_str(), path.c_str()) != 0)
+        {
+            std::cout << "ERROR::MESH_CACHE:: could not replace " << path << std::endl;
+            std::remove(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    MappedFile file;
+
+    const MeshCacheHeader* header() const { return reinterpret_cast<const MeshCacheHeader*>(file.data()); }
+    const MeshCacheEntry* entries() const { return reinterpret_cast<const MeshCacheEntry*>(file.data() + sizeof(MeshCacheHeader)); }
+    const MeshCacheTexture* textures() const { return reinterpret_cast<const MeshCacheTexture*>(entries() + header()->meshCount); }
+    const MeshCacheLod* lods() const { return reinterpret_cast<const MeshCacheLod*>(textures() + header()->textureCount); }
+    const Meshlet* meshlets() const { return reinterpret_cast<const Meshlet*>(lods() + header()->lodCount); }
+    const char* strings() const { return reinterpret_cast<const char*>(meshlets() + header()->meshletCount); }
+
+    // checks the header, that every table and array lies within the file, that every index (of every LOD)
+    // names one of its mesh's vertices and that the bounds are usable
+    bool validate(uint64_t sourceHash) const
+    {
+        size_t size = file.size();
+        if (size < sizeof(MeshCacheHeader))
+            return false;
+        const MeshCacheHeader* h = header();
+        if (std::memcmp(h->magic, MESH_CACHE_MAGIC, 4) != 0 || h->version != MESH_CACHE_VERSION
+            || h->sourceHash != sourceHash || h->vertexSize != sizeof(Vertex) || h->fileSize != size)
+            return false;
+        uint64_t tables = sizeof(MeshCacheHeader) + (uint64_t)h->meshCount * sizeof(MeshCacheEntry)
+            + (uint64_t)h->textureCount * sizeof(MeshCacheTexture) + (uint64_t)h->lodCount * sizeof(MeshCacheLod)
+            + (uint64_t)h->meshletCount * sizeof(Meshlet) + h->stringsSize;
+        if (tables > size)
+            return false;
+        for (uint32_t i = 0; i < h->meshCount; i++)
+        {
+            const MeshCacheEntry& entry = entries()[i];
+            if (entry.vertexOffset % 16 != 0 || entry.indexOffset % 16 != 0
+                || entry.vertexOffset + (uint64_t)entry.vertexCount * sizeof(Vertex) > size
+                || entry.indexOffset + (uint64_t)entry.indexCount * sizeof(unsigned int) > size
+                || (uint64_t)entry.firstTexture + entry.textureCount > h->textureCount
+                || (uint64_t)entry.firstLod + entry.lodCount > h->lodCount
+                || (uint64_t)entry.firstMeshlet + entry.meshletCount > h->meshletCount)
+                return false;
+            for (uint32_t j = 0; j < entry.meshletCount; j++)
+            {
+                const Meshlet& meshlet = meshlets()[entry.firstMeshlet + j];
+                if ((uint64_t)meshlet.firstIndex + meshlet.indexCount > entry.indexCount)
+                    return false;
+            }
+            for (int axis = 0; axis < 3; axis++)
+                if (!std::isfinite(entry.boundsMin[axis]) || !std::isfinite(entry.boundsMax[axis]) || entry.boundsMin[axis] > entry.boundsMax[axis])
+                    return false;
+            if (!indicesBelow(entry.indexOffset, entry.indexCount, entry.vertexCount))
+                return false;
+            for (uint32_t j = 0; j < entry.lodCount; j++)
+            {
+                const MeshCacheLod& lod = lods()[entry.firstLod + j];
+                if (lod.indexOffset % 16 != 0 || lod.indexOffset + (uint64_t)lod.indexCount * sizeof(unsigned int) > size
+                    || !indicesBelow(lod.indexOffset, lod.indexCount, entry.vertexCount))
+                    return false;
+            }
+        }
+        for (uint32_t i = 0; i < h->textureCount; i++)
+        {
+            const MeshCacheTexture& reference = textures()[i];
+            if ((uint64_t)reference.typeOffset + reference.typeLength > h->stringsSize
+                || (uint64_t)reference.pathOffset + reference.pathLength > h->stringsSize)
+                return false;
+        }
+        return true;
+    }
+
+    // whether the count indices at offset (already known to lie within the file) are all below vertexCount
+    bool indicesBelow(uint64_t offset, uint32_t count, uint32_t vertexCount) const
+    {
+        const unsigned int* indices = reinterpret_cast<const unsigned int*>(file.data() + offset);
+        unsigned int largest = 0;
+        for (uint32_t i = 0; i < count; i++)
+            largest = std::max(largest, indices[i]);
+        return count == 0 || largest < vertexCount;
+    }
+
+    static uint64_t align(uint64_t offset)
+    {
+        return (offset + 15) & ~(uint64_t)15;
+    }
+
+    static void pad(std::ofstream& out, uint64_t offset)
+    {
+        static const char zeros[16] = {};
+        uint64_t position = (uint64_t)out.tellp();
+        if (offset > position)
+            out.write(zeros, (std::streamsize)(offset - position));
+    }
+};
+#endif
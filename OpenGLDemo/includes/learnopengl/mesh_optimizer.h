@@ -0,0 +1,330 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/meshlet.h>
+
+#include <algorithm>
+#include <vector>
+
+// Load time reordering of triangle lists for the GPU, run on imported meshes before they are cooked:
+//
+//     optimizeVertexCache    Tipsify (Sander et al. 2007): walks the mesh fanning around recently used
+//                            vertices so the post-transform cache hits more often. also returns the
+//                            clusters it walked, which overdraw optimization reorders.
+//     optimizeOverdraw       sorts those clusters so the ones facing away from the mesh centre come first,
+//                            view independent, letting early z reject more of the triangles drawn later
+//     buildMeshlets          (optional, see meshlet.h) regroups the triangles into compact meshlets, which
+//                            then take the place of Tipsify's clusters in the overdraw sort
+//     optimizeVertexFetch    renumbers vertices in the order the triangles first use them, so vertex
+//                            fetch walks the buffer (nearly) linearly. drops unreferenced vertices.
+//
+// the index buffer keeps describing the same triangles with the same winding, only their order changes.
+// CPU only, safe to call from worker threads.
+
+const unsigned int VERTEX_CACHE_SIZE = 16;  // post-transform cache entries the ordering optimizes for
+const float OVERDRAW_THRESHOLD = 1.05f;     // how much worse than Tipsify's cache misses overdraw clusters may get
+
+// average cache miss ratio: transformed vertices per triangle with a FIFO cache of cacheSize entries.
+// 0.5 is the ideal for large regular meshes, 3 means no reuse at all.
+float averageCacheMissRatio(const vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize = VERTEX_CACHE_SIZE)
+{
+    if (indices.empty())
+        return 0.0f;
+    vector<unsigned int> timestamps(vertexCount, 0);
+    unsigned int time = cacheSize + 1;
+    size_t misses = 0;
+    for (unsigned int index : indices)
+    {
+        if (time - timestamps[index] > cacheSize)
+        {
+            timestamps[index] = time++;
+            misses++;
+        }
+    }
+    return (float)misses / (float)(indices.size() / 3);
+}
+
+// reorders the triangles for the post-transform cache. clusters receives the index (into triangles, not
+// indices) where each run of spatially connected triangles starts; pass nullptr if not needed.
+void optimizeVertexCache(vector<unsigned int>& indices, size_t vertexCount, vector<unsigned int>* clusters = nullptr, unsigned int cacheSize = VERTEX_CACHE_SIZE)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (clusters)
+        clusters->clear();
+    if (triangleCount == 0 || vertexCount == 0)
+        return;
+
+    // vertex -> triangles adjacency, as offsets into one array
+    vector<unsigned int> liveTriangles(vertexCount, 0);
+    for (unsigned int index : indices)
+        liveTriangles[index]++;
+    vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+    vector<unsigned int> adjacency(indices.size());
+    {
+        vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t t = 0; t < triangleCount; t++)
+            for (int k = 0; k < 3; k++)
+                adjacency[fill[indices[t * 3 + k]]++] = (unsigned int)t;
+    }
+
+    vector<unsigned int> timestamps(vertexCount, 0);
+    vector<bool> emitted(triangleCount, false);
+    vector<unsigned int> deadEnds;  // recently used vertices, to continue from when a fan runs out
+    vector<unsigned int> candidates;
+    vector<unsigned int> result;
+    result.reserve(indices.size());
+    unsigned int time = cacheSize + 1;
+    size_t cursor = 0;              // scan position for when the dead end stack is exhausted too
+
+    int fanning = 0;
+    bool newCluster = true;
+    while (fanning >= 0)
+    {
+        unsigned int emittedCount = (unsigned int)(result.size() / 3);
+        if (newCluster && clusters && (clusters->empty() || clusters->back() != emittedCount))
+            clusters->push_back(emittedCount);
+        newCluster = false;
+
+        // emit every remaining triangle around the fanning vertex
+        candidates.clear();
+        for (unsigned int a = adjacencyOffsets[fanning]; a < adjacencyOffsets[fanning + 1]; a++)
+        {
+            unsigned int triangle = adjacency[a];
+            if (emitted[triangle])
+                continue;
+            emitted[triangle] = true;
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int v = indices[triangle * 3 + k];
+                result.push_back(v);
+                deadEnds.push_back(v);
+                candidates.push_back(v);
+                liveTriangles[v]--;
+                if (time - timestamps[v] > cacheSize)
+                    timestamps[v] = time++;
+            }
+        }
+
+        // next fan: the candidate that stays in the cache longest while its fan is emitted
+        int next = -1;
+        int bestPriority = -1;
+        for (unsigned int v : candidates)
+        {
+            if (liveTriangles[v] == 0)
+                continue;
+            int priority = 0;
+            if (time - timestamps[v] + 2 * liveTriangles[v] <= cacheSize)
+                priority = (int)(time - timestamps[v]);
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                next = (int)v;
+            }
+        }
+        if (next == -1)
+        {
+            // dead end: go back to a recently used vertex, or else the next unfinished one in the mesh
+            while (!deadEnds.empty() && next == -1)
+            {
+                unsigned int v = deadEnds.back();
+                deadEnds.pop_back();
+                if (liveTriangles[v] > 0)
+                    next = (int)v;
+            }
+            while (next == -1 && cursor < vertexCount)
+            {
+                if (liveTriangles[cursor] > 0)
+                    next = (int)cursor;
+                cursor++;
+            }
+            newCluster = true;
+        }
+        fanning = next;
+    }
+    indices.swap(result);
+
+    if (!clusters)
+        return;
+    // Tipsify only breaks clusters at dead ends, which leaves few and large ones. split them further
+    // wherever the cache misses so far are within the threshold of the whole cluster's, so the overdraw
+    // sort has something to work with without losing much of the cache efficiency.
+    vector<unsigned int> hard;
+    hard.swap(*clusters);
+    hard.push_back((unsigned int)triangleCount);
+    std::fill(timestamps.begin(), timestamps.end(), 0);
+    time = cacheSize + 1;
+    for (size_t c = 0; c + 1 < hard.size(); c++)
+    {
+        unsigned int begin = hard[c], end = hard[c + 1];
+        // misses of the whole cluster starting with a cold cache
+        time += cacheSize + 1;
+        size_t clusterMisses = 0;
+        for (size_t i = begin * 3; i < end * 3; i++)
+            if (time - timestamps[indices[i]] > cacheSize)
+            {
+                timestamps[indices[i]] = time++;
+                clusterMisses++;
+            }
+        float clusterRatio = (float)clusterMisses / (float)(end - begin);
+
+        clusters->push_back(begin);
+        time += cacheSize + 1;
+        size_t misses = 0;
+        unsigned int start = begin;
+        for (unsigned int t = begin; t < end; t++)
+        {
+            for (int k = 0; k < 3; k++)
+                if (time - timestamps[indices[t * 3 + k]] > cacheSize)
+                {
+                    timestamps[indices[t * 3 + k]] = time++;
+                    misses++;
+                }
+            unsigned int count = t + 1 - start;
+            if (t + 1 < end && (float)misses / (float)count <= clusterRatio * OVERDRAW_THRESHOLD)
+            {
+                clusters->push_back(t + 1);
+                start = t + 1;
+                misses = 0;
+                time += cacheSize + 1; // a new cluster can end up anywhere, assume it starts cold
+            }
+        }
+    }
+}
+
+// sorts the clusters from optimizeVertexCache front to back as seen from outside the mesh: a cluster whose
+// normal points away from the mesh centre is likely in front of the surfaces behind it. clusters is updated
+// to where each cluster starts afterwards, in the new order.
+void optimizeOverdraw(vector<unsigned int>& indices, const vector<Vertex>& vertices, vector<unsigned int>& clusters)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (clusters.size() < 2)
+        return;
+
+    // area weighted centroid of the whole mesh
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        const glm::vec3& a = vertices[indices[t * 3]].Position;
+        const glm::vec3& b = vertices[indices[t * 3 + 1]].Position;
+        const glm::vec3& c = vertices[indices[t * 3 + 2]].Position;
+        float area = glm::length(glm::cross(b - a, c - a));
+        meshCentroid += (a + b + c) * (area / 3.0f);
+        meshArea += area;
+    }
+    if (meshArea > 0.0f)
+        meshCentroid /= meshArea;
+
+    struct Cluster {
+        unsigned int begin, end;
+        float sortKey;
+    };
+    vector<Cluster> sorted(clusters.size());
+    for (size_t c = 0; c < clusters.size(); c++)
+    {
+        Cluster& cluster = sorted[c];
+        cluster.begin = clusters[c];
+        cluster.end = c + 1 < clusters.size() ? clusters[c + 1] : (unsigned int)triangleCount;
+        glm::vec3 centroid(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (unsigned int t = cluster.begin; t < cluster.end; t++)
+        {
+            const glm::vec3& a = vertices[indices[t * 3]].Position;
+            const glm::vec3& b = vertices[indices[t * 3 + 1]].Position;
+            const glm::vec3& c = vertices[indices[t * 3 + 2]].Position;
+            glm::vec3 scaledNormal = glm::cross(b - a, c - a); // length is twice the area
+            float triangleArea = glm::length(scaledNormal);
+            centroid += (a + b + c) * (triangleArea / 3.0f);
+            normal += scaledNormal;
+            area += triangleArea;
+        }
+        if (area > 0.0f)
+            centroid /= area;
+        float normalLength = glm::length(normal);
+        cluster.sortKey = normalLength > 0.0f ? glm::dot(centroid - meshCentroid, normal / normalLength) : 0.0f;
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+    vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (size_t c = 0; c < sorted.size(); c++)
+    {
+        clusters[c] = (unsigned int)(result.size() / 3);
+        result.insert(result.end(), indices.begin() + sorted[c].begin * 3, indices.begin() + sorted[c].end * 3);
+    }
+    indices.swap(result);
+}
+
+// renumbers the vertices in order of first use and drops the ones no triangle references
+void optimizeVertexFetch(vector<Vertex>& vertices, vector<unsigned int>& indices)
+{
+    const unsigned int unused = ~0u;
+    vector<unsigned int> remap(vertices.size(), unused);
+    vector<Vertex> result;
+    result.reserve(vertices.size());
+    for (unsigned int& index : indices)
+    {
+        if (remap[index] == unused)
+        {
+            remap[index] = (unsigned int)result.size();
+            result.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(result);
+}
+
+// all of the above, in the order they have to run in. with meshlets, the triangles are grouped into
+// meshlets that end up as runs of the index buffer, described by *meshlets.
+void optimizeMesh(vector<Vertex>& vertices, vector<unsigned int>& indices, vector<Meshlet>* meshlets = nullptr)
+{
+    vector<unsigned int> clusters;
+    optimizeVertexCache(indices, vertices.size(), &clusters);
+    if (meshlets)
+    {
+        buildMeshlets(indices, &vertices[0].Position.x, sizeof(Vertex), vertices.size(), *meshlets);
+        // meshlets grow outwards from their centre, which the cache doesn't like: reorder each one on its
+        // own, with its vertices numbered locally so that stays cheap
+        vector<unsigned int> local, localToGlobal;
+        vector<unsigned int> globalToLocal(vertices.size(), ~0u);
+        clusters.clear();
+        for (const Meshlet& meshlet : *meshlets)
+        {
+            clusters.push_back(meshlet.firstIndex / 3);
+            local.clear();
+            localToGlobal.clear();
+            for (unsigned int i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i++)
+            {
+                unsigned int& slot = globalToLocal[indices[i]];
+                if (slot == ~0u)
+                {
+                    slot = (unsigned int)localToGlobal.size();
+                    localToGlobal.push_back(indices[i]);
+                }
+                local.push_back(slot);
+            }
+            optimizeVertexCache(local, localToGlobal.size());
+            for (size_t i = 0; i < local.size(); i++)
+                indices[meshlet.firstIndex + i] = localToGlobal[local[i]];
+            for (unsigned int v : localToGlobal)
+                globalToLocal[v] = ~0u;
+        }
+    }
+    optimizeOverdraw(indices, vertices, clusters);
+    if (meshlets && !clusters.empty())
+    {
+        // clusters are meshlets in their new order
+        for (size_t m = 0; m < clusters.size(); m++)
+        {
+            unsigned int end = m + 1 < clusters.size() ? clusters[m + 1] : (unsigned int)(indices.size() / 3);
+            (*meshlets)[m] = { clusters[m] * 3, (end - clusters[m]) * 3 };
+        }
+    }
+    optimizeVertexFetch(vertices, indices);
+}
+#endif
@@ -0,0 +1,388 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+
+// Quadric error edge collapse (Garland & Heckbert) for building LODs. Only the index buffer is simplified:
+// vertices collapse onto other existing vertices, so every LOD of a mesh shares its vertex buffer and keeps
+// the original normals and uvs at the vertices that remain.
+//
+// Vertices at the same position with different attributes (uv seams, hard normal edges) are treated as one
+// point of the surface. Each vertex is classified once up front:
+//
+//     manifold    one wedge, closed fan        can collapse onto any neighbour
+//     border      one wedge, on an open edge   only along the border, onto another border (or locked) vertex
+//     seam        two wedges, closed surface   only along the seam, both wedges together, so the seam survives
+//     locked      anything else                never moves
+//
+// CPU only, safe to call from worker threads.
+
+const float SIMPLIFY_BORDER_WEIGHT = 10.0f;  // how strongly borders keep their shape, relative to the surface
+const float SIMPLIFY_SEAM_WEIGHT = 1.0f;     // same for seams, which are inside the surface but still visible
+
+enum SimplifyVertexKind {
+    SIMPLIFY_MANIFOLD,
+    SIMPLIFY_BORDER,
+    SIMPLIFY_SEAM,
+    SIMPLIFY_LOCKED
+};
+
+// symmetric 4x4 error quadric: Q(p) = p^T A p + 2 b.p + c, summed over weighted planes
+struct Quadric {
+    double a00 = 0, a11 = 0, a22 = 0, a01 = 0, a02 = 0, a12 = 0;
+    double b0 = 0, b1 = 0, b2 = 0;
+    double c = 0;
+    double weight = 0;
+
+    void addPlane(const glm::vec3& normal, float distance, float planeWeight)
+    {
+        double n0 = normal.x, n1 = normal.y, n2 = normal.z, d = distance, w = planeWeight;
+        a00 += w * n0 * n0; a11 += w * n1 * n1; a22 += w * n2 * n2;
+        a01 += w * n0 * n1; a02 += w * n0 * n2; a12 += w * n1 * n2;
+        b0 += w * n0 * d; b1 += w * n1 * d; b2 += w * n2 * d;
+        c += w * d * d;
+        weight += w;
+    }
+
+    void add(const Quadric& other)
+    {
+        a00 += other.a00; a11 += other.a11; a22 += other.a22;
+        a01 += other.a01; a02 += other.a02; a12 += other.a12;
+        b0 += other.b0; b1 += other.b1; b2 += other.b2;
+        c += other.c;
+        weight += other.weight;
+    }
+
+    // weighted mean squared distance of p to the planes
+    double error(const glm::vec3& p) const
+    {
+        if (weight <= 0.0)
+            return 0.0;
+        double x = p.x, y = p.y, z = p.z;
+        double e = a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+            + 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+        return std::max(e, 0.0) / weight;
+    }
+};
+
+// returns the indices of a simplified version of the mesh with at most targetIndexCount indices, or fewer
+// collapses if that would move the surface further than targetError. errors are relative to the largest
+// extent of the mesh bounds; resultError receives the one the result ended up with.
+vector<unsigned int> simplifyMesh(const vector<Vertex>& vertices, const vector<unsigned int>& indices, size_t targetIndexCount, float targetError, float* resultError = nullptr)
+{
+    size_t vertexCount = vertices.size();
+    vector<unsigned int> result = indices;
+    if (resultError)
+        *resultError = 0.0f;
+    if (vertexCount == 0 || indices.size() <= targetIndexCount)
+        return result;
+
+    // positions scaled to a unit box, so errors are relative and the quadrics well conditioned
+    glm::vec3 boundsMin = vertices[0].Position, boundsMax = vertices[0].Position;
+    for (const Vertex& vertex : vertices)
+    {
+        boundsMin = glm::min(boundsMin, vertex.Position);
+        boundsMax = glm::max(boundsMax, vertex.Position);
+    }
+    glm::vec3 extent = boundsMax - boundsMin;
+    float scale = std::max(std::max(extent.x, extent.y), extent.z);
+    scale = scale > 0.0f ? 1.0f / scale : 1.0f;
+    vector<glm::vec3> positions(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++)
+        positions[i] = (vertices[i].Position - boundsMin) * scale;
+
+    // wedges: vertices sharing a position. position[] maps every vertex to the first one at its position,
+    // wedge[] links the vertices of a position into a cycle.
+    vector<unsigned int> position(vertexCount), wedge(vertexCount);
+    {
+        vector<unsigned int> order(vertexCount);
+        for (size_t i = 0; i < vertexCount; i++)
+            order[i] = (unsigned int)i;
+        auto less = [&](unsigned int a, unsigned int b) {
+            const glm::vec3& pa = vertices[a].Position;
+            const glm::vec3& pb = vertices[b].Position;
+            if (pa.x != pb.x) return pa.x < pb.x;
+            if (pa.y != pb.y) return pa.y < pb.y;
+            if (pa.z != pb.z) return pa.z < pb.z;
+            return a < b;
+        };
+        std::sort(order.begin(), order.end(), less);
+        for (size_t begin = 0; begin < vertexCount;)
+        {
+            size_t end = begin + 1;
+            while (end < vertexCount && vertices[order[end]].Position == vertices[order[begin]].Position)
+                end++;
+            for (size_t i = begin; i < end; i++)
+            {
+                position[order[i]] = order[begin];
+                wedge[order[i]] = order[i + 1 < end ? i + 1 : begin];
+            }
+            begin = end;
+        }
+    }
+
+    auto edgeKey = [](unsigned int a, unsigned int b) { return ((uint64_t)a << 32) | b; };
+    std::unordered_set<uint64_t> edges, positionEdges;
+    auto buildEdges = [&]() {
+        edges.clear();
+        positionEdges.clear();
+        for (size_t i = 0; i < result.size(); i += 3)
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int a = result[i + k], b = result[i + (k + 1) % 3];
+                edges.insert(edgeKey(a, b));
+                positionEdges.insert(edgeKey(position[a], position[b]));
+            }
+    };
+    // for an edge a->b of a triangle: open if no triangle has the opposite edge, border if that holds
+    // for the positions too (a seam is open, but not a border)
+    auto isOpen = [&](unsigned int a, unsigned int b) { return !edges.count(edgeKey(b, a)); };
+    auto isBorder = [&](unsigned int a, unsigned int b) { return !positionEdges.count(edgeKey(position[b], position[a])); };
+    buildEdges();
+
+    // classify the vertices
+    vector<unsigned int> openOut(vertexCount, 0), openIn(vertexCount, 0);
+    vector<bool> borderPosition(vertexCount, false);
+    for (size_t i = 0; i < result.size(); i += 3)
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int a = result[i + k], b = result[i + (k + 1) % 3];
+            if (!edges.count(edgeKey(b, a)))
+            {
+                openOut[a]++;
+                openIn[b]++;
+            }
+            if (!positionEdges.count(edgeKey(position[b], position[a])))
+                borderPosition[position[a]] = borderPosition[position[b]] = true;
+        }
+    vector<unsigned char> kind(vertexCount, SIMPLIFY_LOCKED);
+    for (size_t v = 0; v < vertexCount; v++)
+    {
+        unsigned int sibling = wedge[v];
+        if (sibling == v)
+        {
+            if (openOut[v] == 0 && openIn[v] == 0)
+                kind[v] = SIMPLIFY_MANIFOLD;
+            else if (openOut[v] == 1 && openIn[v] == 1)
+                kind[v] = SIMPLIFY_BORDER;
+        }
+        else if (wedge[sibling] == v && !borderPosition[position[v]]
+            && openOut[v] == 1 && openIn[v] == 1 && openOut[sibling] == 1 && openIn[sibling] == 1)
+            kind[v] = SIMPLIFY_SEAM;
+    }
+
+    // quadrics per position: the planes of the triangles around it, plus planes perpendicular to the
+    // surface through border and seam edges so those keep their outline
+    vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i < result.size(); i += 3)
+    {
+        const glm::vec3& p0 = positions[result[i]];
+        const glm::vec3& p1 = positions[result[i + 1]];
+        const glm::vec3& p2 = positions[result[i + 2]];
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float area = glm::length(normal);
+        if (area <= 0.0f)
+            continue;
+        normal /= area;
+        for (int k = 0; k < 3; k++)
+            quadrics[position[result[i + k]]].addPlane(normal, -glm::dot(normal, p0), area);
+
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int a = result[i + k], b = result[i + (k + 1) % 3];
+            float edgeWeight;
+            if (isBorder(a, b))
+                edgeWeight = SIMPLIFY_BORDER_WEIGHT;
+            else if (isOpen(a, b))
+                edgeWeight = SIMPLIFY_SEAM_WEIGHT;
+            else
+                continue;
+            glm::vec3 edge = positions[b] - positions[a];
+            float length = glm::length(edge);
+            if (length <= 0.0f)
+                continue;
+            glm::vec3 edgeNormal = glm::normalize(glm::cross(edge, normal));
+            float distance = -glm::dot(edgeNormal, positions[a]);
+            quadrics[position[a]].addPlane(edgeNormal, distance, edgeWeight * length * length);
+            quadrics[position[b]].addPlane(edgeNormal, distance, edgeWeight * length * length);
+        }
+    }
+
+    struct Collapse {
+        unsigned int from, to;
+        double cost;
+    };
+    vector<Collapse> collapses;
+    vector<unsigned int> remap(vertexCount);
+    vector<bool> lockedThisPass(vertexCount);
+    vector<unsigned int> adjacencyOffsets(vertexCount + 1), adjacency;
+    vector<unsigned int> neighbours, apexes;
+    double errorLimit = (double)targetError * targetError;
+    double maxError = 0.0;
+
+    // collapses in passes: cheapest first, each position touched at most once per pass, then rebuild
+    while (result.size() > targetIndexCount)
+    {
+        // position -> triangles
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+        for (unsigned int index : result)
+            adjacencyOffsets[position[index] + 1]++;
+        for (size_t v = 0; v < vertexCount; v++)
+            adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+        adjacency.resize(result.size());
+        {
+            vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (size_t i = 0; i < result.size(); i++)
+                adjacency[fill[position[result[i]]]++] = (unsigned int)(i / 3);
+        }
+
+        collapses.clear();
+        for (size_t i = 0; i < result.size(); i += 3)
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int a = result[i + k], b = result[i + (k + 1) % 3];
+                for (int direction = 0; direction < 2; direction++)
+                {
+                    unsigned int from = direction == 0 ? a : b, to = direction == 0 ? b : a;
+                    bool allowed;
+                    switch (kind[from])
+                    {
+                    case SIMPLIFY_MANIFOLD: allowed = true; break;
+                    case SIMPLIFY_BORDER: allowed = isBorder(a, b) && (kind[to] == SIMPLIFY_BORDER || kind[to] == SIMPLIFY_LOCKED); break;
+                    case SIMPLIFY_SEAM: allowed = !isBorder(a, b) && isOpen(a, b) && (kind[to] == SIMPLIFY_SEAM || kind[to] == SIMPLIFY_LOCKED); break;
+                    default: allowed = false; break;
+                    }
+                    if (allowed)
+                        collapses.push_back(Collapse{ from, to, quadrics[position[from]].error(positions[to]) });
+                }
+            }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+        for (size_t v = 0; v < vertexCount; v++)
+            remap[v] = (unsigned int)v;
+        std::fill(lockedThisPass.begin(), lockedThisPass.end(), false);
+        size_t trianglesToRemove = (result.size() - targetIndexCount) / 3;
+        size_t removed = 0;
+        size_t performed = 0;
+        for (const Collapse& collapse : collapses)
+        {
+            if (collapse.cost > errorLimit || removed >= trianglesToRemove)
+                break;
+            unsigned int p0 = position[collapse.from], p1 = position[collapse.to];
+            if (p0 == p1 || lockedThisPass[p0] || lockedThisPass[p1])
+                continue;
+
+            // the collapse must not flip a triangle that survives it, and (link condition) the two
+            // positions may only share the neighbours opposite the edge, or the surface pinches
+            bool valid = true;
+            size_t shared = 0;
+            neighbours.clear();
+            apexes.clear();
+            for (unsigned int a = adjacencyOffsets[p0]; a < adjacencyOffsets[p0 + 1] && valid; a++)
+            {
+                unsigned int triangle = adjacency[a];
+                unsigned int corners[3] = { position[result[triangle * 3]], position[result[triangle * 3 + 1]], position[result[triangle * 3 + 2]] };
+                if (corners[0] == p1 || corners[1] == p1 || corners[2] == p1)
+                {
+                    for (int k = 0; k < 3; k++)
+                        if (corners[k] != p0 && corners[k] != p1)
+                            apexes.push_back(corners[k]);
+                    shared++;
+                    continue;
+                }
+                glm::vec3 before[3], after[3];
+                for (int k = 0; k < 3; k++)
+                {
+                    before[k] = positions[corners[k]];
+                    after[k] = corners[k] == p0 ? positions[p1] : before[k];
+                    if (corners[k] != p0)
+                        neighbours.push_back(corners[k]);
+                }
+                glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+                if (glm::dot(normalBefore, normalAfter) <= 0.25f * glm::length(normalBefore) * glm::length(normalAfter))
+                    valid = false;
+            }
+            if (!valid)
+                continue;
+            neighbours.insert(neighbours.end(), apexes.begin(), apexes.end());
+            std::sort(neighbours.begin(), neighbours.end());
+            neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+            std::sort(apexes.begin(), apexes.end());
+            apexes.erase(std::unique(apexes.begin(), apexes.end()), apexes.end());
+            for (unsigned int a = adjacencyOffsets[p1]; a < adjacencyOffsets[p1 + 1] && valid; a++)
+            {
+                unsigned int triangle = adjacency[a];
+                for (int k = 0; k < 3; k++)
+                {
+                    unsigned int corner = position[result[triangle * 3 + k]];
+                    if (corner != p0 && corner != p1 && std::binary_search(neighbours.begin(), neighbours.end(), corner)
+                        && !std::binary_search(apexes.begin(), apexes.end(), corner))
+                        valid = false;
+                }
+            }
+            if (!valid)
+                continue;
+
+            // a seam moves both its wedges, each onto the wedge of the target it shares an edge with
+            if (kind[collapse.from] == SIMPLIFY_SEAM)
+            {
+                unsigned int sibling = wedge[collapse.from];
+                unsigned int siblingTarget = collapse.to;
+                bool found = false;
+                for (unsigned int w = wedge[collapse.to];; w = wedge[w])
+                {
+                    if (w != collapse.to && (edges.count(edgeKey(sibling, w)) || edges.count(edgeKey(w, sibling))))
+                    {
+                        siblingTarget = w;
+                        found = true;
+                        break;
+                    }
+                    if (w == collapse.to)
+                        break;
+                }
+                if (!found)
+                    continue;
+                remap[sibling] = siblingTarget;
+            }
+            remap[collapse.from] = collapse.to;
+
+            quadrics[p1].add(quadrics[p0]);
+            for (unsigned int a = adjacencyOffsets[p0]; a < adjacencyOffsets[p0 + 1]; a++)
+                for (int k = 0; k < 3; k++)
+                    lockedThisPass[position[result[adjacency[a] * 3 + k]]] = true;
+            removed += shared;
+            performed++;
+            maxError = std::max(maxError, collapse.cost);
+        }
+        if (performed == 0)
+            break;
+
+        // apply, dropping the triangles that collapsed
+        size_t write = 0;
+        for (size_t i = 0; i < result.size(); i += 3)
+        {
+            unsigned int a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+            if (position[a] == position[b] || position[b] == position[c] || position[a] == position[c])
+                continue;
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+        buildEdges();
+    }
+
+    if (resultError)
+        *resultError = (float)std::sqrt(maxError);
+    return result;
+}
+#endif
@@ -0,0 +1,335 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MESHLET_CULL_SSE
+#endif
+
+// Meshlets: small clusters of a triangle list that can be culled on their own. Each is a run of the index
+// buffer with at most MESHLET_MAX_VERTICES distinct vertices and MESHLET_MAX_TRIANGLES triangles, and gets
+// a bounding sphere for frustum culling and a normal cone for culling it as a whole when all its triangles
+// face away from the camera.
+//
+// buildMeshlets() grows compact patches over the surface and reorders the index buffer so each patch is one
+// run; it runs when a mesh is imported and the result is cooked. splitMeshlets() only cuts the index buffer
+// as it is, for meshes that come without meshlets.
+//
+// The bounds are kept as a structure of arrays, padded to a multiple of 4 with clusters that never pass,
+// so the culler tests 4 clusters per step with SSE where available.
+
+const unsigned int MESHLET_MAX_VERTICES = 64;
+const unsigned int MESHLET_MAX_TRIANGLES = 124;
+
+struct Meshlet {
+    unsigned int firstIndex;
+    unsigned int indexCount;
+};
+
+struct MeshletBounds {
+    // bounding spheres
+    std::vector<float> centerX, centerY, centerZ, radius;
+    // normal cones: the cluster faces away from a camera at c when dot(center - c, axis) >= cutoff * |center - c| + radius.
+    // cutoff 1 disables the test for clusters whose normals spread too far.
+    std::vector<float> axisX, axisY, axisZ, cutoff;
+
+    size_t size() const { return centerX.size(); }
+};
+
+// what the culler needs of the camera, in the object space of the mesh
+struct MeshletCullParams {
+    glm::vec4 planes[6];        // normalized, inside where dot(plane.xyz, p) + plane.w >= 0
+    glm::vec3 cameraPosition;
+};
+
+// object space frustum planes and camera position for a mesh drawn with the given matrices
+MeshletCullParams meshletCullParams(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection)
+{
+    MeshletCullParams params;
+    glm::mat4 clip = projection * view * model;
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++)
+        rows[i] = glm::vec4(clip[0][i], clip[1][i], clip[2][i], clip[3][i]);
+    params.planes[0] = rows[3] + rows[0];   // left
+    params.planes[1] = rows[3] - rows[0];   // right
+    params.planes[2] = rows[3] + rows[1];   // bottom
+    params.planes[3] = rows[3] - rows[1];   // top
+    params.planes[4] = rows[3] + rows[2];   // near
+    params.planes[5] = rows[3] - rows[2];   // far
+    for (glm::vec4& plane : params.planes)
+        plane /= glm::length(glm::vec3(plane));
+    params.cameraPosition = glm::vec3(glm::inverse(view * model) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    return params;
+}
+
+// reorders the triangles into meshlets that are compact patches of the surface. each meshlet starts from a
+// triangle next to the previous one and grows by the neighbouring triangle adding the fewest vertices,
+// closest to its centre, so the input order (e.g. from optimizeVertexCache) is roughly kept between
+// meshlets. positions are read as 3 floats every positionStride bytes.
+void buildMeshlets(std::vector<unsigned int>& indices, const float* positions, size_t positionStride, size_t vertexCount, std::vector<Meshlet>& meshlets)
+{
+    meshlets.clear();
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+    auto position = [&](unsigned int index) {
+        const float* p = reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + index * positionStride);
+        return glm::vec3(p[0], p[1], p[2]);
+    };
+    auto centroid = [&](size_t triangle) {
+        return (position(indices[triangle * 3]) + position(indices[triangle * 3 + 1]) + position(indices[triangle * 3 + 2])) / 3.0f;
+    };
+
+    // vertex -> triangles
+    std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+    for (unsigned int index : indices)
+        adjacencyOffsets[index + 1]++;
+    for (size_t v = 0; v < vertexCount; v++)
+        adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+    std::vector<unsigned int> adjacency(indices.size());
+    {
+        std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++)
+            adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+    }
+
+    std::vector<bool> emitted(triangleCount, false), inMeshlet(vertexCount, false);
+    std::vector<unsigned int> result, vertices;
+    result.reserve(indices.size());
+    vertices.reserve(MESHLET_MAX_VERTICES);
+    size_t cursor = 0;
+    glm::vec3 center(0.0f);
+
+    // the unemitted triangle around the current vertices that adds the fewest vertices (within the limit),
+    // closest to the centre. -1 if there is none.
+    auto nextTriangle = [&](bool limitVertices) {
+        long best = -1;
+        unsigned int bestExtra = 4;
+        float bestDistance = 0.0f;
+        for (unsigned int v : vertices)
+            for (unsigned int a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1]; a++)
+            {
+                unsigned int triangle = adjacency[a];
+                if (emitted[triangle])
+                    continue;
+                unsigned int extra = 0;
+                for (int k = 0; k < 3; k++)
+                    extra += inMeshlet[indices[triangle * 3 + k]] ? 0 : 1;
+                if (limitVertices && vertices.size() + extra > MESHLET_MAX_VERTICES)
+                    continue;
+                float distance = glm::length(centroid(triangle) - center);
+                if (extra < bestExtra || (extra == bestExtra && distance < bestDistance))
+                {
+                    best = triangle;
+                    bestExtra = extra;
+                    bestDistance = distance;
+                }
+            }
+        return best;
+    };
+
+    size_t emittedCount = 0;
+    while (emittedCount < triangleCount)
+    {
+        // seed: next to the meshlet just finished, or else the first triangle left in input order
+        long seed = vertices.empty() ? -1 : nextTriangle(false);
+        for (unsigned int v : vertices)
+            inMeshlet[v] = false;
+        vertices.clear();
+        if (seed < 0)
+        {
+            while (emitted[cursor])
+                cursor++;
+            seed = (long)cursor;
+        }
+
+        Meshlet meshlet = { (unsigned int)result.size(), 0 };
+        glm::vec3 centroidSum(0.0f);
+        for (long triangle = seed; triangle >= 0; triangle = nextTriangle(true))
+        {
+            emitted[triangle] = true;
+            emittedCount++;
+            for (int k = 0; k < 3; k++)
+            {
+                unsigned int index = indices[triangle * 3 + k];
+                result.push_back(index);
+                if (!inMeshlet[index])
+                {
+                    inMeshlet[index] = true;
+                    vertices.push_back(index);
+                }
+            }
+            meshlet.indexCount += 3;
+            centroidSum += centroid(triangle);
+            center = centroidSum / (float)(meshlet.indexCount / 3);
+            if (meshlet.indexCount / 3 == MESHLET_MAX_TRIANGLES)
+                break;
+        }
+        meshlets.push_back(meshlet);
+    }
+    indices.swap(result);
+}
+
+// cuts a triangle list into meshlets in the order it is in
+void splitMeshlets(const unsigned int* indices, size_t indexCount, std::vector<Meshlet>& meshlets)
+{
+    meshlets.clear();
+    unsigned int used[MESHLET_MAX_VERTICES];
+    unsigned int usedCount = 0;
+    Meshlet current = { 0, 0 };
+    for (size_t t = 0; t + 2 < indexCount; t += 3)
+    {
+        unsigned int added = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            unsigned int index = indices[t + k];
+            bool known = std::find(used, used + usedCount, index) != used + usedCount;
+            for (int j = 0; j < k && !known; j++)
+                known = indices[t + j] == index;
+            added += known ? 0 : 1;
+        }
+        if (usedCount + added > MESHLET_MAX_VERTICES || current.indexCount / 3 == MESHLET_MAX_TRIANGLES)
+        {
+            meshlets.push_back(current);
+            current = { (unsigned int)t, 0 };
+            usedCount = 0;
+        }
+        for (int k = 0; k < 3; k++)
+            if (std::find(used, used + usedCount, indices[t + k]) == used + usedCount)
+                used[usedCount++] = indices[t + k];
+        current.indexCount += 3;
+    }
+    if (current.indexCount > 0)
+        meshlets.push_back(current);
+}
+
+// bounding spheres and normal cones of meshlets, padded to a multiple of 4 with clusters outside every frustum
+void computeMeshletBounds(const unsigned int* indices, const float* positions, size_t positionStride, const std::vector<Meshlet>& meshlets, MeshletBounds& bounds)
+{
+    auto position = [&](unsigned int index) {
+        const float* p = reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + index * positionStride);
+        return glm::vec3(p[0], p[1], p[2]);
+    };
+    size_t padded = (meshlets.size() + 3) & ~(size_t)3;
+    for (std::vector<float>* array : { &bounds.centerX, &bounds.centerY, &bounds.centerZ, &bounds.axisX, &bounds.axisY, &bounds.axisZ })
+        array->assign(padded, 0.0f);
+    bounds.radius.assign(padded, -1e30f);
+    bounds.cutoff.assign(padded, 1.0f);
+    for (size_t m = 0; m < meshlets.size(); m++)
+    {
+        const Meshlet& meshlet = meshlets[m];
+        if (meshlet.indexCount == 0)
+            continue;
+        glm::vec3 low = position(indices[meshlet.firstIndex]), high = low;
+        for (unsigned int i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i++)
+        {
+            low = glm::min(low, position(indices[i]));
+            high = glm::max(high, position(indices[i]));
+        }
+        glm::vec3 center = (low + high) * 0.5f;
+        float radius = 0.0f;
+        glm::vec3 axis(0.0f);
+        for (unsigned int i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i += 3)
+        {
+            glm::vec3 a = position(indices[i]), b = position(indices[i + 1]), c = position(indices[i + 2]);
+            radius = std::max(radius, std::max(glm::length(a - center), std::max(glm::length(b - center), glm::length(c - center))));
+            glm::vec3 normal = glm::cross(b - a, c - a);
+            float length = glm::length(normal);
+            if (length > 0.0f)
+                axis += normal / length;
+        }
+        float axisLength = glm::length(axis);
+        float cutoff = 1.0f;
+        if (axisLength > 0.0f)
+        {
+            axis /= axisLength;
+            // the widest angle between the axis and a triangle normal
+            float minimumDot = 1.0f;
+            for (unsigned int i = meshlet.firstIndex; i < meshlet.firstIndex + meshlet.indexCount; i += 3)
+            {
+                glm::vec3 a = position(indices[i]), b = position(indices[i + 1]), c = position(indices[i + 2]);
+                glm::vec3 normal = glm::cross(b - a, c - a);
+                float length = glm::length(normal);
+                if (length > 0.0f)
+                    minimumDot = std::min(minimumDot, glm::dot(axis, normal / length));
+            }
+            // wider than ~84 degrees there is hardly a view the whole cluster faces away from
+            if (minimumDot > 0.1f)
+                cutoff = std::sqrt(1.0f - minimumDot * minimumDot);
+        }
+        bounds.centerX[m] = center.x;
+        bounds.centerY[m] = center.y;
+        bounds.centerZ[m] = center.z;
+        bounds.radius[m] = radius;
+        bounds.axisX[m] = axis.x;
+        bounds.axisY[m] = axis.y;
+        bounds.axisZ[m] = axis.z;
+        bounds.cutoff[m] = cutoff;
+    }
+}
+
+// tests every cluster against the frustum and its normal cone, visible[i] is set to 1 or 0.
+// CPU only, safe to call from worker threads.
+void cullMeshlets(const MeshletBounds& bounds, const MeshletCullParams& params, std::vector<unsigned char>& visible)
+{
+    size_t count = bounds.size();
+    visible.resize(count);
+#ifdef MESHLET_CULL_SSE
+    __m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+    for (int p = 0; p < 6; p++)
+    {
+        planeX[p] = _mm_set1_ps(params.planes[p].x);
+        planeY[p] = _mm_set1_ps(params.planes[p].y);
+        planeZ[p] = _mm_set1_ps(params.planes[p].z);
+        planeW[p] = _mm_set1_ps(params.planes[p].w);
+    }
+    __m128 cameraX = _mm_set1_ps(params.cameraPosition.x);
+    __m128 cameraY = _mm_set1_ps(params.cameraPosition.y);
+    __m128 cameraZ = _mm_set1_ps(params.cameraPosition.z);
+    for (size_t i = 0; i < count; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(&bounds.centerX[i]);
+        __m128 y = _mm_loadu_ps(&bounds.centerY[i]);
+        __m128 z = _mm_loadu_ps(&bounds.centerZ[i]);
+        __m128 radius = _mm_loadu_ps(&bounds.radius[i]);
+        __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), radius);
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int p = 0; p < 6; p++)
+        {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)),
+                _mm_add_ps(_mm_mul_ps(planeZ[p], z), planeW[p]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+        }
+        __m128 toX = _mm_sub_ps(x, cameraX);
+        __m128 toY = _mm_sub_ps(y, cameraY);
+        __m128 toZ = _mm_sub_ps(z, cameraZ);
+        __m128 along = _mm_add_ps(_mm_add_ps(_mm_mul_ps(toX, _mm_loadu_ps(&bounds.axisX[i])), _mm_mul_ps(toY, _mm_loadu_ps(&bounds.axisY[i]))),
+            _mm_mul_ps(toZ, _mm_loadu_ps(&bounds.axisZ[i])));
+        __m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(toX, toX), _mm_mul_ps(toY, toY)), _mm_mul_ps(toZ, toZ)));
+        __m128 backFacing = _mm_cmpge_ps(along, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&bounds.cutoff[i]), distance), radius));
+        int mask = _mm_movemask_ps(_mm_andnot_ps(backFacing, inside));
+        for (int k = 0; k < 4; k++)
+            visible[i + k] = (unsigned char)((mask >> k) & 1);
+    }
+#else
+    for (size_t i = 0; i < count; i++)
+    {
+        glm::vec3 center(bounds.centerX[i], bounds.centerY[i], bounds.centerZ[i]);
+        bool inside = true;
+        for (int p = 0; p < 6 && inside; p++)
+            inside = glm::dot(glm::vec3(params.planes[p]), center) + params.planes[p].w >= -bounds.radius[i];
+        glm::vec3 toCenter = center - params.cameraPosition;
+        bool backFacing = glm::dot(toCenter, glm::vec3(bounds.axisX[i], bounds.axisY[i], bounds.axisZ[i]))
+            >= bounds.cutoff[i] * glm::length(toCenter) + bounds.radius[i];
+        visible[i] = inside && !backFacing ? 1 : 0;
+    }
+#endif
+}
+#endif
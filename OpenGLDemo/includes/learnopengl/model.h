@@ -11,7 +11,17 @@
 #include <assimp/postprocess.h>
 
 #include <learnopengl/mesh.h>
+#include <learnopengl/assimp_io.h>
+#include <learnopengl/geometry_arena.h>
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/mesh_optimizer.h>
+#include <learnopengl/mesh_simplifier.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/profiler.h>
+#include <learnopengl/thread_pool.h>
+#include <learnopengl/texture_atlas.h>
+#include <learnopengl/texture_cache.h>
+#include <learnopengl/virtual_texture.h>
 
 #include <string>
 #include <fstream>
@@ -23,127 +33,326 @@ using namespace std;
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
+// an assimp mesh converted to our vertex layout, without any GL objects yet
+struct MeshData {
+    vector<Vertex> vertices;
+    vector<unsigned int> indices;
+    vector<MeshLod> lods;
+    vector<Meshlet> meshlets;
+    unsigned int materialIndex;
+};
+
+// LODs built for every imported mesh, each simplified from the one before to half its triangles. levels
+// that would have to move the surface by more than MESH_LOD_MAX_ERROR of the mesh size aren't built.
+const unsigned int MESH_LOD_COUNT = 3;
+const float MESH_LOD_MAX_ERROR = 0.05f;
+
+const unsigned int MODEL_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+
 class Model 
 {
 public:
     // model data 
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
-    vector<Mesh>    meshes;
+    vector<Texture> textures_loaded;	// every texture this model references in the shared texture cache, released with the model.
+    vector<unsigned int> atlases;   // the model's own textures its small material textures were packed into, see texture_atlas.h
+    vector<unsigned int> pageTables;    // the virtual textures it references, see virtual_texture.h
+    vector<Mesh>    meshes;     // CPU side only, their GL objects are in geometry
+    GeometryArena   geometry;
     string directory;
     bool gammaCorrection;
+    VertexFormat vertexFormat;  // the layout the meshes are uploaded in, see VertexFormat
+    bool virtualTextures;       // material textures are virtual where possible, their ids are page tables then
 
-    // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    // constructor, expects a filepath to a 3D model. cpuGeometry is what the meshes keep in memory once
+    // they are uploaded; the bounds, LOD and meshlet data Draw needs are always kept. with virtual
+    // textures the shaders must sample them through their page tables (see virtual_texture.h).
+    Model(string const &path, bool gamma = false, VertexFormat format = VERTEX_FORMAT_PACKED, CpuGeometry cpuGeometry = CPU_GEOMETRY_FULL,
+          bool virtualTextures = false)
+        : gammaCorrection(gamma), vertexFormat(format), virtualTextures(virtualTextures)
     {
         loadModel(path);
+        loadTextures();
+        geometry.build(meshes);
+        for (Mesh& mesh : meshes)
+            mesh.releaseCpuGeometry(cpuGeometry);
+    }
+
+    // hands the textures back to the cache, the ones no other model uses get deleted
+    ~Model()
+    {
+        for(unsigned int i = 0; i < textures_loaded.size(); i++)
+            TextureCache::instance().release(textures_loaded[i].id);
+        for (unsigned int atlas : atlases)
+        {
+            TextureStreamer::instance().cancel(atlas);
+            glDeleteTextures(1, &atlas);
+        }
+        for (unsigned int pageTable : pageTables)
+            VirtualTextureSystem::instance().release(pageTable);
     }
 
+    // the texture references can't be shared between copies
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+
     // draws the model, and thus all its meshes
     void Draw(Shader &shader)
     {
         for(unsigned int i = 0; i < meshes.size(); i++)
-            meshes[i].Draw(shader);
+            geometry.draw(i);
+        geometry.flush(shader);
+    }
+
+    // draws every mesh at the LOD its bounding sphere's size on screen calls for, returns the triangles
+    // drawn. with cullMeshlets the meshes drawn at full detail only draw their meshlets that face the
+    // camera and are inside the frustum; the meshes are culled in parallel before any of them is drawn.
+    // everything is submitted through the geometry arena in a few multi-draw calls.
+    size_t Draw(Shader &shader, const glm::mat4 &model, const glm::mat4 &view, const glm::mat4 &projection, float viewportHeight, float maxPixelError = LOD_PIXEL_ERROR, bool cullMeshlets = false)
+    {
+        glm::mat4 modelView = view * model;
+        float scale = std::max(std::max(glm::length(glm::vec3(modelView[0])), glm::length(glm::vec3(modelView[1]))), glm::length(glm::vec3(modelView[2])));
+        // turns a size at distance 1 into pixels
+        float projectionScale = projection[1][1] * viewportHeight * 0.5f;
+        vector<unsigned int> selected(meshes.size());
+        vector<size_t> triangles(meshes.size());
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            Mesh &mesh = meshes[i];
+            glm::vec3 center = (mesh.boundsMin + mesh.boundsMax) * 0.5f;
+            float radius = 0.5f * glm::length(mesh.boundsMax - mesh.boundsMin) * scale;
+            float distance = -(modelView * glm::vec4(center, 1.0f)).z;
+            // inside the sphere (or behind the camera) the projection breaks down, stay at full detail
+            selected[i] = distance > radius ? mesh.selectLod(radius * projectionScale / distance, maxPixelError) : 0;
+            triangles[i] = mesh.triangleCount(selected[i]);
+        }
+
+        if (cullMeshlets)
+        {
+            PROFILE_ZONE("meshlet culling");
+            MeshletCullParams params = meshletCullParams(model, view, projection);
+            ThreadPool::instance().parallelFor(meshes.size(), [&](size_t i) {
+                if (selected[i] == 0)
+                    triangles[i] = meshes[i].cullMeshlets(params);
+            });
+        }
+
+        size_t drawn = 0;
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            if (cullMeshlets && selected[i] == 0)
+                geometry.draw(i, meshes[i].culledRanges());
+            else
+                geometry.draw(i, selected[i]);
+            drawn += triangles[i];
+        }
+        geometry.flush(shader);
+
+        // textures still being read: the ones of meshes on screen first, nearer (finer LOD) ones before farther
+        if (TextureStreamer::instance().pendingCount() > 0)
+            for(unsigned int i = 0; i < meshes.size(); i++)
+                if (triangles[i] > 0)
+                    for (const Texture &texture : meshes[i].textures)
+                        TextureStreamer::instance().prioritize(texture.id, TEXTURE_PRIORITY_VISIBLE - (int)selected[i]);
+        return drawn;
     }
     
 private:
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const &path)
     {
-        // read file via ASSIMP
+        PROFILE_ZONE("Model::loadModel");
+        // retrieve the directory path of the filepath
+        directory = path.substr(0, path.find_last_of('/'));
+
+        // a cooked copy of the meshes next to the source skips assimp entirely
+        string cachePath = MeshCache::cachePath(path);
+        uint64_t sourceHash = MeshCache::sourceHash(path, MODEL_IMPORT_FLAGS);
+        if (sourceHash != 0 && loadCooked(cachePath, sourceHash))
+            return;
+
+        // read file via ASSIMP, through FileSystem so models load from the resource pack too
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        importer.SetIOHandler(new FileSystemIOSystem);
+        const aiScene* scene = nullptr;
+        {
+            PROFILE_ZONE("assimp import");
+            scene = importer.ReadFile(path, MODEL_IMPORT_FLAGS);
+        }
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
             return;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
 
         // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        vector<aiMesh*> sceneMeshes;
+        processNode(scene->mRootNode, scene, sceneMeshes);
+
+        // convert all meshes in parallel (CPU only), then create the meshes in order
+        vector<MeshData> converted(sceneMeshes.size());
+        ThreadPool::instance().parallelFor(sceneMeshes.size(), [&](size_t i) {
+            converted[i] = processMesh(sceneMeshes[i]);
+        });
+        {
+            PROFILE_ZONE("Model::createMeshes");
+            meshes.reserve(meshes.size() + converted.size());
+            for (MeshData& data : converted)
+                meshes.push_back(createMesh(data, scene));
+        }
+
+        // cook the result for the next run
+        if (sourceHash != 0)
+            MeshCache::write(cachePath, sourceHash, meshes);
+    }
+
+    // gives the meshes their textures: the small ones are packed into atlases (which moves the UVs, so this
+    // runs after cooking), the rest are virtual textures or taken from the texture cache. the other
+    // virtual textures of a mesh follow the first one's feedback, they share its coordinates
+    void loadTextures()
+    {
+        PROFILE_ZONE("Model::loadTextures");
+        atlases = buildTextureAtlases(meshes, directory);
+        for (Mesh& mesh : meshes)
+        {
+            unsigned int leader = 0;
+            for (Texture& texture : mesh.textures)
+            {
+                if (texture.id != 0)
+                    continue;
+                if (virtualTextures)
+                    texture.id = VirtualTextureSystem::instance().acquire(this->directory + '/' + texture.path, leader);
+                if (texture.id != 0)
+                {
+                    pageTables.push_back(texture.id);
+                    leader = leader ? leader : texture.id;
+                    continue;
+                }
+                texture.id = TextureFromFile(texture.path.c_str(), this->directory);
+                textures_loaded.push_back(texture);  // remember the reference, so it's released with the model
+            }
+        }
+    }
+
+    // creates the meshes from a cooked cache, returns false on a miss (no cache, or a stale one)
+    bool loadCooked(const string &cachePath, uint64_t sourceHash)
+    {
+        PROFILE_ZONE("Model::loadCooked");
+        MeshCache cache;
+        if (!cache.open(cachePath, sourceHash))
+            return false;
+        meshes.reserve(cache.meshCount());
+        for (size_t i = 0; i < cache.meshCount(); i++)
+        {
+            CookedMesh cooked = cache.mesh(i);
+            vector<Texture> textures;
+            for (const Texture& reference : cooked.textures)
+                textures.push_back(loadMaterialTexture(reference.path.c_str(), reference.type));
+            const glm::vec3 bounds[2] = { cooked.boundsMin, cooked.boundsMax };
+            meshes.push_back(Mesh(cooked.vertices, cooked.vertexCount, cooked.indices, cooked.indexCount, std::move(textures), vertexFormat, std::move(cooked.lods),
+                std::move(cooked.meshlets), false, bounds));
+        }
+        return true;
     }
 
-    // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    // processes a node in a recursive fashion. Collects each individual mesh located at the node and repeats this process on its children nodes (if any).
+    void processNode(aiNode *node, const aiScene *scene, vector<aiMesh*> &sceneMeshes)
     {
-        // process each mesh located at the current node
+        // collect each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
         {
             // the node object only contains indices to index the actual objects in the scene. 
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
-            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            sceneMeshes.push_back(scene->mMeshes[node->mMeshes[i]]);
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, sceneMeshes);
         }
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    // converts the vertices and faces of a mesh. runs on worker threads, so it must not touch GL or the model.
+    MeshData processMesh(const aiMesh *mesh)
     {
-        // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+        PROFILE_ZONE("Model::processMesh");
+        // data to fill, sized up front so the loops below only write
+        MeshData data;
+        data.materialIndex = mesh->mMaterialIndex;
+        data.vertices.resize(mesh->mNumVertices);
+        size_t indexCount = 0;
+        for(unsigned int i = 0; i < mesh->mNumFaces; i++)
+            indexCount += mesh->mFaces[i].mNumIndices;
+        data.indices.resize(indexCount);
 
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
-            Vertex vertex;
-            glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
+            Vertex &vertex = data.vertices[i];
             // positions
-            vector.x = mesh->mVertices[i].x;
-            vector.y = mesh->mVertices[i].y;
-            vector.z = mesh->mVertices[i].z;
-            vertex.Position = vector;
+            vertex.Position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
             // normals
             if (mesh->HasNormals())
-            {
-                vector.x = mesh->mNormals[i].x;
-                vector.y = mesh->mNormals[i].y;
-                vector.z = mesh->mNormals[i].z;
-                vertex.Normal = vector;
-            }
+                vertex.Normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
             // texture coordinates
             if(mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
             {
-                glm::vec2 vec;
                 // a vertex can contain up to 8 different texture coordinates. We thus make the assumption that we won't 
                 // use models where a vertex can have multiple texture coordinates so we always take the first set (0).
-                vec.x = mesh->mTextureCoords[0][i].x; 
-                vec.y = mesh->mTextureCoords[0][i].y;
-                vertex.TexCoords = vec;
+                vertex.TexCoords = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
                 // tangent
-                vector.x = mesh->mTangents[i].x;
-                vector.y = mesh->mTangents[i].y;
-                vector.z = mesh->mTangents[i].z;
-                vertex.Tangent = vector;
+                vertex.Tangent = glm::vec3(mesh->mTangents[i].x, mesh->mTangents[i].y, mesh->mTangents[i].z);
                 // bitangent
-                vector.x = mesh->mBitangents[i].x;
-                vector.y = mesh->mBitangents[i].y;
-                vector.z = mesh->mBitangents[i].z;
-                vertex.Bitangent = vector;
+                vertex.Bitangent = glm::vec3(mesh->mBitangents[i].x, mesh->mBitangents[i].y, mesh->mBitangents[i].z);
             }
             else
                 vertex.TexCoords = glm::vec2(0.0f, 0.0f);
-
-            vertices.push_back(vertex);
         }
         // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
+        size_t index = 0;
         for(unsigned int i = 0; i < mesh->mNumFaces; i++)
         {
-            aiFace face = mesh->mFaces[i];
+            const aiFace &face = mesh->mFaces[i];
             // retrieve all indices of the face and store them in the indices vector
             for(unsigned int j = 0; j < face.mNumIndices; j++)
-                indices.push_back(face.mIndices[j]);        
+                data.indices[index++] = face.mIndices[j];
+        }
+        // reorder for the vertex cache, meshlets, overdraw and vertex fetch; cooking keeps the result
+        optimizeMesh(data.vertices, data.indices, &data.meshlets);
+        buildLods(data);
+        return data;
+    }
+
+    // simplifies the mesh into its LOD chain, every level reordered for the vertex cache like the mesh
+    void buildLods(MeshData &data)
+    {
+        PROFILE_ZONE("Model::buildLods");
+        data.lods.reserve(MESH_LOD_COUNT); // previous points into it
+        const vector<unsigned int>* previous = &data.indices;
+        float previousError = 0.0f;
+        for (unsigned int i = 0; i < MESH_LOD_COUNT; i++)
+        {
+            size_t target = previous->size() / 6 * 3;
+            float error = 0.0f;
+            vector<unsigned int> indices = simplifyMesh(data.vertices, *previous, target, MESH_LOD_MAX_ERROR - previousError, &error);
+            // stop once simplifying doesn't get far enough to be worth another level
+            if (indices.empty() || indices.size() > previous->size() * 4 / 5)
+                break;
+            optimizeVertexCache(indices, data.vertices.size());
+            // each level is simplified from the one before, so the errors add up
+            previousError += error;
+            data.lods.push_back(MeshLod{ std::move(indices), previousError });
+            previous = &data.lods.back().indices;
         }
+    }
+
+    // collects the material textures of a converted mesh (loaded later, see loadTextures) and creates it
+    Mesh createMesh(MeshData &data, const aiScene *scene)
+    {
+        vector<Texture> textures;
         // process materials
-        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];    
+        aiMaterial* material = scene->mMaterials[data.materialIndex];    
         // we assume a convention for sampler names in the shaders. Each diffuse texture should be named
         // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER. 
         // Same applies to other texture as the following list summarizes:
@@ -165,11 +374,11 @@ private:
         textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
         
         // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        return Mesh(std::move(data.vertices), std::move(data.indices), std::move(textures), vertexFormat, std::move(data.lods), std::move(data.meshlets), false);
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
+    // checks all material textures of a given type, the required info is returned as Texture structs
+    // that loadTextures fills in.
     vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
     {
         vector<Texture> textures;
@@ -177,29 +386,20 @@ private:
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            textures.push_back(loadMaterialTexture(str.C_Str(), typeName));
         }
         return textures;
     }
+
+    // a material texture that isn't loaded yet, see loadTextures
+    Texture loadMaterialTexture(const char *path, const string &typeName)
+    {
+        Texture texture;
+        texture.id = 0;
+        texture.type = typeName;
+        texture.path = path;
+        return texture;
+    }
 };
 
 
@@ -208,38 +408,8 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
     string filename = string(path);
     filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    // shared with every other user of the same file, streamed in (with a placeholder) on first use.
+    // the caller owns a reference, see TextureCache::release
+    return TextureCache::instance().acquire(filename, gamma);
 }
 #endif
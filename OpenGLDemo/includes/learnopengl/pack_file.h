@@ -0,0 +1,408 @@
+#ifndef PACK_FILE_H
+#define PACK_FILE_H
+
+#include <learnopengl/hash.h>
+#include <learnopengl/lz4_block.h>
+#include <learnopengl/mapped_file.h>
+#include <learnopengl/profiler.h>
+#include <learnopengl/thread_pool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A pack file: many assets in one file, so loading reads from one memory mapping instead of opening and
+// reading hundreds of small files. Layout:
+//
+//     PackHeader
+//     the blocks of every entry, entry after entry
+//     table of contents: PackEntryRecord[entryCount], PackBlockRecord[blockCount], the names
+//
+// each entry is cut into blocks of PACK_BLOCK_SIZE bytes, compressed independently (LZ4 block format,
+// lz4_block.h) or stored as they are when compression doesn't pay (already compressed images); a part of
+// an entry can be read by decompressing only the blocks it touches. an entry whose blocks are all stored
+// is contiguous in the file and is handed out straight from the mapping. every entry keeps the FNV-1a hash
+// of its content, checked on read with verifyHashes, and the last write time of the file it was packed
+// from, so FileSystem can tell an edited loose file from a stale entry; the table of contents keeps its
+// own hash.
+//
+// names are paths relative to the directory the pack was built from, '/' separated. PackReader is
+// read-only and safe to use from any number of threads once open.
+
+const uint32_t PACK_VERSION = 2;  // 2: entries record the last write time of their file
+const uint32_t PACK_BLOCK_SIZE = 64 << 10;
+// a block is stored compressed only if that saves at least 1/16 of it
+const uint32_t PACK_MIN_SAVING_SHIFT = 4;
+
+const uint32_t PACK_ENTRY_STORED = 1;   // no block is compressed
+const uint32_t PACK_BLOCK_COMPRESSED = 1;
+
+struct PackHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t blockSize;
+    uint32_t entryCount;
+    uint64_t blockCount;
+    uint64_t tocOffset;
+    uint64_t tocSize;
+    uint64_t tocHash;
+};
+
+struct PackEntryRecord {
+    uint64_t size;        // uncompressed
+    uint64_t hash;        // of the uncompressed content
+    uint64_t firstBlock;
+    uint32_t nameOffset;  // into the names
+    uint32_t nameLength;
+    uint32_t flags;
+    uint32_t reserved;
+    int64_t modified;     // last write time of the file when packed, in std::filesystem clock ticks
+};
+
+struct PackBlockRecord {
+    uint64_t offset;      // from the start of the file
+    uint32_t storedSize;
+    uint32_t flags;
+};
+
+class PackReader
+{
+public:
+    // check every entry's hash when it is read whole
+    bool verifyHashes = false;
+
+    bool open(const std::string& path)
+    {
+        PROFILE_ZONE("PackReader::open");
+        close();
+        if (!file.open(path))
+            return false;
+        if (file.size() < sizeof(PackHeader))
+            return fail(path, "too small");
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (std::memcmp(header.magic, "LPAK", 4) != 0 || header.version != PACK_VERSION || header.blockSize == 0)
+            return fail(path, "not a pack or an older version");
+        uint64_t tocSize = header.entryCount * sizeof(PackEntryRecord) + header.blockCount * sizeof(PackBlockRecord);
+        if (header.tocOffset > file.size() || header.tocSize > file.size() - header.tocOffset || header.tocSize < tocSize)
+            return fail(path, "truncated");
+        const unsigned char* toc = file.data() + header.tocOffset;
+        if (fnv1a(toc, header.tocSize) != header.tocHash)
+            return fail(path, "corrupt table of contents");
+
+        entries = reinterpret_cast<const PackEntryRecord*>(toc);
+        blocks = reinterpret_cast<const PackBlockRecord*>(toc + header.entryCount * sizeof(PackEntryRecord));
+        const char* names = reinterpret_cast<const char*>(toc + tocSize);
+        uint64_t namesSize = header.tocSize - tocSize;
+        byName.reserve(header.entryCount);
+        for (uint32_t i = 0; i < header.entryCount; i++)
+        {
+            const PackEntryRecord& entry = entries[i];
+            if ((uint64_t)entry.nameOffset + entry.nameLength > namesSize || entry.firstBlock + blockCount(entry) > header.blockCount)
+                return fail(path, "corrupt entry");
+            for (uint64_t b = entry.firstBlock; b < entry.firstBlock + blockCount(entry); b++)
+                if (blocks[b].offset > header.tocOffset || blocks[b].storedSize > header.tocOffset - blocks[b].offset)
+                    return fail(path, "corrupt block");
+            byName.emplace(std::string(names + entry.nameOffset, entry.nameLength), i);
+        }
+        return true;
+    }
+
+    void close()
+    {
+        file.close();
+        byName.clear();
+        entries = nullptr;
+        blocks = nullptr;
+    }
+
+    bool isOpen() const { return file.isOpen(); }
+    size_t entryCount() const { return byName.size(); }
+
+    // the entry called 'name', or null
+    const PackEntryRecord* find(const std::string& name) const
+    {
+        auto entry = byName.find(name);
+        return entry == byName.end() ? nullptr : &entries[entry->second];
+    }
+
+    std::string name(const PackEntryRecord& entry) const
+    {
+        const char* names = reinterpret_cast<const char*>(blocks + header.blockCount);
+        return std::string(names + entry.nameOffset, entry.nameLength);
+    }
+
+    // the content of a stored entry right in the mapping, null if it is compressed
+    const unsigned char* mapped(const PackEntryRecord& entry) const
+    {
+        if (!(entry.flags & PACK_ENTRY_STORED))
+            return nullptr;
+        return blockCount(entry) ? file.data() + blocks[entry.firstBlock].offset : file.data();
+    }
+
+    // 'size' bytes of the entry from 'offset' on into 'output', decompressing only the blocks they touch
+    bool read(const PackEntryRecord& entry, uint64_t offset, uint64_t size, unsigned char* output) const
+    {
+        if (offset > entry.size || size > entry.size - offset)
+            return false;
+        if (size == 0)
+            return true;
+        if (const unsigned char* content = mapped(entry))
+        {
+            std::memcpy(output, content + offset, (size_t)size);
+            return true;
+        }
+        uint64_t first = offset / header.blockSize, last = (offset + size - 1) / header.blockSize;
+        std::atomic<bool> ok{ true };
+        auto decode = [&](size_t i) {
+            uint64_t block = first + i;
+            uint64_t blockStart = block * header.blockSize;
+            uint64_t blockSize = std::min<uint64_t>(header.blockSize, entry.size - blockStart);
+            uint64_t from = std::max(offset, blockStart), to = std::min(offset + size, blockStart + blockSize);
+            unsigned char* target = output + (from - offset);
+            if (from == blockStart && to == blockStart + blockSize)
+            {
+                // the whole block, straight into the output
+                if (!decodeBlock(entry, block, blockSize, target))
+                    ok = false;
+                return;
+            }
+            std::vector<unsigned char> scratch((size_t)blockSize);
+            if (!decodeBlock(entry, block, blockSize, scratch.data()))
+                ok = false;
+            else
+                std::memcpy(target, scratch.data() + (from - blockStart), (size_t)(to - from));
+        };
+        // big reads decompress their blocks in parallel
+        if (last - first >= PARALLEL_BLOCKS)
+            ThreadPool::instance().parallelFor((size_t)(last - first + 1), decode);
+        else
+            for (size_t i = 0; i <= last - first; i++)
+                decode(i);
+        return ok;
+    }
+
+    // the whole entry, checked against its hash with verifyHashes
+    bool read(const PackEntryRecord& entry, std::string& content) const
+    {
+        PROFILE_ZONE("PackReader::read");
+        content.resize((size_t)entry.size);
+        if (!read(entry, 0, entry.size, reinterpret_cast<unsigned char*>(&content[0])))
+        {
+            std::cout << "ERROR::PACK:: corrupt entry " << name(entry) << std::endl;
+            return false;
+        }
+        if (verifyHashes && fnv1a(content) != entry.hash)
+        {
+            std::cout << "ERROR::PACK:: hash mismatch in " << name(entry) << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool read(const std::string& name, std::string& content) const
+    {
+        const PackEntryRecord* entry = find(name);
+        return entry && read(*entry, content);
+    }
+
+    // every entry, in the order they were packed
+    std::vector<const PackEntryRecord*> list() const
+    {
+        std::vector<const PackEntryRecord*> all;
+        for (uint32_t i = 0; i < header.entryCount; i++)
+            all.push_back(&entries[i]);
+        return all;
+    }
+
+    uint64_t blockCount(const PackEntryRecord& entry) const
+    {
+        return (entry.size + header.blockSize - 1) / header.blockSize;
+    }
+
+    const PackBlockRecord& block(const PackEntryRecord& entry, uint64_t index) const
+    {
+        return blocks[entry.firstBlock + index];
+    }
+
+private:
+    static const uint64_t PARALLEL_BLOCKS = 8;
+
+    MappedFile file;
+    PackHeader header;
+    const PackEntryRecord* entries = nullptr;
+    const PackBlockRecord* blocks = nullptr;
+    std::unordered_map<std::string, uint32_t> byName;
+
+    bool fail(const std::string& path, const char* reason)
+    {
+        std::cout << "ERROR::PACK:: " << path << ": " << reason << std::endl;
+        close();
+        return false;
+    }
+
+    bool decodeBlock(const PackEntryRecord& entry, uint64_t index, uint64_t size, unsigned char* output) const
+    {
+        const PackBlockRecord& record = blocks[entry.firstBlock + index];
+        const unsigned char* stored = file.data() + record.offset;
+        if (!(record.flags & PACK_BLOCK_COMPRESSED))
+        {
+            if (record.storedSize != size)
+                return false;
+            std::memcpy(output, stored, (size_t)size);
+            return true;
+        }
+        return lz4Decompress(stored, record.storedSize, output, (size_t)size);
+    }
+};
+
+// what buildPack did
+struct PackStats {
+    size_t files = 0;
+    uint64_t inputBytes = 0;
+    uint64_t packBytes = 0;
+    uint64_t compressedBlocks = 0;
+    uint64_t storedBlocks = 0;
+};
+
+// packs every file under 'directory' that 'include' accepts (it gets the relative name) into 'path'.
+// the blocks of each file are compressed on the thread pool; files go in by name, so the same tree
+// always gives the same pack
+template <typename Filter>
+bool buildPack(const std::string& directory, const std::string& path, Filter include, PackStats& stats)
+{
+    PROFILE_ZONE("buildPack");
+    std::vector<std::string> names;
+    std::error_code error;
+    for (auto it = std::filesystem::recursive_directory_iterator(directory, error); !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+    {
+        if (!it->is_regular_file())
+            continue;
+        std::string name = std::filesystem::relative(it->path(), directory).generic_string();
+        if (include(name))
+            names.push_back(name);
+    }
+    if (error)
+    {
+        std::cout << "ERROR::PACK:: could not list " << directory << std::endl;
+        return false;
+    }
+    std::sort(names.begin(), names.end());
+
+    std::string temporary = path + ".tmp";
+    std::ofstream out(temporary, std::ios::binary);
+    if (!out)
+    {
+        std::cout << "ERROR::PACK:: could not write " << temporary << std::endl;
+        return false;
+    }
+    PackHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "LPAK", 4);
+    header.version = PACK_VERSION;
+    header.blockSize = PACK_BLOCK_SIZE;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    uint64_t position = sizeof(header);
+
+    stats = PackStats();
+    std::vector<PackEntryRecord> entries;
+    std::vector<PackBlockRecord> blocks;
+    std::string namesBlob;
+    for (const std::string& name : names)
+    {
+        std::ifstream in(directory + '/' + name, std::ios::binary);
+        std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if (!in.good() && !in.eof())
+        {
+            std::cout << "ERROR::PACK:: could not read " << name << std::endl;
+            out.close();
+            std::remove(temporary.c_str());
+            return false;
+        }
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(content.data());
+        size_t blockCount = (content.size() + PACK_BLOCK_SIZE - 1) / PACK_BLOCK_SIZE;
+        std::vector<std::vector<unsigned char>> compressed(blockCount);
+        ThreadPool::instance().parallelFor(blockCount, [&](size_t b) {
+            size_t size = std::min<size_t>(PACK_BLOCK_SIZE, content.size() - b * PACK_BLOCK_SIZE);
+            lz4Compress(bytes + b * PACK_BLOCK_SIZE, size, compressed[b]);
+            if (compressed[b].size() > size - (size >> PACK_MIN_SAVING_SHIFT))
+                compressed[b].clear(); // stored
+        });
+
+        PackEntryRecord entry;
+        std::memset(&entry, 0, sizeof(entry));
+        entry.size = content.size();
+        entry.hash = fnv1a(content);
+        entry.firstBlock = blocks.size();
+        entry.nameOffset = (uint32_t)namesBlob.size();
+        entry.nameLength = (uint32_t)name.size();
+        entry.flags = PACK_ENTRY_STORED;
+        std::error_code timeError;
+        entry.modified = std::filesystem::last_write_time(directory + '/' + name, timeError).time_since_epoch().count();
+        namesBlob += name;
+        for (size_t b = 0; b < blockCount; b++)
+        {
+            size_t size = std::min<size_t>(PACK_BLOCK_SIZE, content.size() - b * PACK_BLOCK_SIZE);
+            PackBlockRecord block;
+            std::memset(&block, 0, sizeof(block));
+            block.offset = position;
+            if (compressed[b].empty())
+            {
+                block.storedSize = (uint32_t)size;
+                out.write(content.data() + b * PACK_BLOCK_SIZE, (std::streamsize)size);
+                stats.storedBlocks++;
+            }
+            else
+            {
+                block.storedSize = (uint32_t)compressed[b].size();
+                block.flags = PACK_BLOCK_COMPRESSED;
+                entry.flags &= ~PACK_ENTRY_STORED;
+                out.write(reinterpret_cast<const char*>(compressed[b].data()), (std::streamsize)compressed[b].size());
+                stats.compressedBlocks++;
+            }
+            position += block.storedSize;
+            blocks.push_back(block);
+        }
+        entries.push_back(entry);
+        stats.files++;
+        stats.inputBytes += content.size();
+    }
+
+    std::string toc;
+    toc.append(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(PackEntryRecord));
+    toc.append(reinterpret_cast<const char*>(blocks.data()), blocks.size() * sizeof(PackBlockRecord));
+    toc += namesBlob;
+    out.write(toc.data(), (std::streamsize)toc.size());
+    header.entryCount = (uint32_t)entries.size();
+    header.blockCount = blocks.size();
+    header.tocOffset = position;
+    header.tocSize = toc.size();
+    header.tocHash = fnv1a(toc);
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.close();
+    stats.packBytes = position + toc.size();
+    if (!out)
+    {
+        std::cout << "ERROR::PACK:: could not write " << temporary << std::endl;
+        std::remove(temporary.c_str());
+        return false;
+    }
+    std::remove(path.c_str()); // rename doesn't replace existing files on windows
+    if (std::rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        std::cout << "ERROR::PACK:: could not replace " << path << std::endl;
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+#endif
@@ -0,0 +1,396 @@
+#ifndef PBR_MATERIAL_H
+#define PBR_MATERIAL_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <stb_image.h>
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/hash.h>
+#include <learnopengl/mapped_file.h>
+#include <learnopengl/profiler.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/texture_cache.h>
+#include <learnopengl/texture_compressor.h>
+#include <learnopengl/texture_streamer.h>
+#include <learnopengl/thread_pool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// PBR materials as a directory of images (resources/textures/pbr/*: albedo, normal, ao, roughness,
+// metallic) described by a small text file, "material.pbr", next to them. Every map in the descriptor is
+// either an image in the directory or a constant, which is how sets with missing images (plastic has no
+// roughness map) are filled in:
+//
+//     albedo albedo.png
+//     normal normal.png
+//     occlusion ao.png
+//     roughness 0.5
+//     metallic metallic.png
+//
+// occlusion, roughness and metallic are packed into the red, green and blue channels of one texture, so a
+// shader makes one fetch for all three instead of three (roughness gets green, the channel BC1 keeps with
+// the most bits). images of different sizes are scaled to the largest. the packed texture is cooked into a
+// BC1 mip chain and cached as "orm.dds", valid while the hash of its sources matches (texture_compressor.h).
+//
+// the descriptor is written by scanning the directory the first time the material is loaded, or by
+// Tools__MaterialCook; edits to it are kept.
+
+const char* const PBR_MATERIAL_FILE = "material.pbr";
+const char* const PBR_ORM_FILE = "orm.dds";
+const uint32_t PBR_ORM_VERSION = 1;
+
+// one map of a material: an image or, where 'file' is empty, a constant (single channel maps use x)
+struct PbrMaterialMap {
+    std::string file;
+    glm::vec3 value = glm::vec3(0.0f);
+};
+
+struct PbrMaterialDescriptor {
+    PbrMaterialMap albedo{ "", glm::vec3(0.5f) };
+    PbrMaterialMap normal;                        // no file: flat, the value is unused
+    PbrMaterialMap occlusion{ "", glm::vec3(1.0f) };
+    PbrMaterialMap roughness{ "", glm::vec3(0.5f) };
+    PbrMaterialMap metallic{ "", glm::vec3(0.0f) };
+
+    // the packed maps, red to blue
+    const PbrMaterialMap* orm(int channel) const
+    {
+        return channel == 0 ? &occlusion : channel == 1 ? &roughness : &metallic;
+    }
+};
+
+// the file names scanPbrMaterial recognizes for each map, with any image extension
+const char* const PBR_ALBEDO_NAMES[] = { "albedo", "basecolor", "diffuse", nullptr };
+const char* const PBR_NORMAL_NAMES[] = { "normal", nullptr };
+const char* const PBR_OCCLUSION_NAMES[] = { "ao", "occlusion", nullptr };
+const char* const PBR_ROUGHNESS_NAMES[] = { "roughness", nullptr };
+const char* const PBR_METALLIC_NAMES[] = { "metallic", "metalness", nullptr };
+
+// the image in 'directory' whose name (without extension, any case) is one of 'names', or ""
+std::string findPbrImage(const std::string& directory, const char* const* names)
+{
+    std::error_code error;
+    std::vector<std::string> files;
+    for (auto it = std::filesystem::directory_iterator(directory, error); !error && it != std::filesystem::directory_iterator(); it.increment(error))
+    {
+        if (!it->is_regular_file())
+            continue;
+        std::string extension = it->path().extension().string();
+        std::string stem = it->path().stem().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        std::transform(stem.begin(), stem.end(), stem.begin(), ::tolower);
+        if (extension != ".png" && extension != ".jpg" && extension != ".jpeg" && extension != ".tga" && extension != ".bmp")
+            continue;
+        for (const char* const* name = names; *name; name++)
+            if (stem == *name)
+                files.push_back(it->path().filename().string());
+    }
+    // the same pick whatever order the directory lists in
+    std::sort(files.begin(), files.end());
+    return files.empty() ? std::string() : files.front();
+}
+
+// a descriptor for the images found in 'directory', constants for the missing ones
+PbrMaterialDescriptor scanPbrMaterial(const std::string& directory)
+{
+    PbrMaterialDescriptor material;
+    material.albedo.file = findPbrImage(directory, PBR_ALBEDO_NAMES);
+    material.normal.file = findPbrImage(directory, PBR_NORMAL_NAMES);
+    material.occlusion.file = findPbrImage(directory, PBR_OCCLUSION_NAMES);
+    material.roughness.file = findPbrImage(directory, PBR_ROUGHNESS_NAMES);
+    material.metallic.file = findPbrImage(directory, PBR_METALLIC_NAMES);
+    return material;
+}
+
+bool readPbrMaterial(const std::string& path, PbrMaterialDescriptor& material)
+{
+    std::string content;
+    if (!FileSystem::readFile(path, content))
+        return false;
+    std::istringstream in(content);
+    material = PbrMaterialDescriptor();
+    std::string line;
+    for (int number = 1; std::getline(in, line); number++)
+    {
+        std::istringstream words(line);
+        std::string key;
+        if (!(words >> key) || key[0] == '#')
+            continue;
+        PbrMaterialMap* map = key == "albedo" ? &material.albedo : key == "normal" ? &material.normal
+            : key == "occlusion" ? &material.occlusion : key == "roughness" ? &material.roughness
+            : key == "metallic" ? &material.metallic : nullptr;
+        std::string rest;
+        std::getline(words >> std::ws, rest);
+        rest.erase(rest.find_last_not_of(" \t\r") + 1);
+        if (!map || rest.empty())
+        {
+            std::cout << "ERROR::PBR_MATERIAL:: " << path << ":" << number << ": expected a map and an image or a value" << std::endl;
+            continue;
+        }
+
+        // numbers are a constant, one for every channel or one per channel, anything else names an image
+        std::istringstream numbers(rest);
+        float value[3];
+        int count = 0;
+        while (count < 3 && numbers >> value[count])
+            count++;
+        if (count > 0 && (numbers >> std::ws).eof() && map != &material.normal)
+        {
+            map->file.clear();
+            map->value = count == 3 ? glm::vec3(value[0], value[1], value[2]) : glm::vec3(value[0]);
+        }
+        else
+            map->file = rest;
+    }
+    return true;
+}
+
+bool writePbrMaterial(const std::string& path, const PbrMaterialDescriptor& material)
+{
+    std::ofstream out(path);
+    if (!out)
+    {
+        std::cout << "ERROR::PBR_MATERIAL:: could not write " << path << std::endl;
+        return false;
+    }
+    out << "# PBR material (learnopengl/pbr_material.h): an image next to this file or a constant per map.\n";
+    out << "# occlusion, roughness and metallic are packed into " << PBR_ORM_FILE << "\n";
+    auto write = [&](const char* key, const PbrMaterialMap& map, bool color) {
+        out << key << ' ';
+        if (!map.file.empty())
+            out << map.file;
+        else if (color)
+            out << map.value.x << ' ' << map.value.y << ' ' << map.value.z;
+        else
+            out << map.value.x;
+        out << '\n';
+    };
+    write("albedo", material.albedo, true);
+    if (!material.normal.file.empty())
+        write("normal", material.normal, false);
+    write("occlusion", material.occlusion, false);
+    write("roughness", material.roughness, false);
+    write("metallic", material.metallic, false);
+    return (bool)out;
+}
+
+// the descriptor of the material in 'directory', written from scanPbrMaterial if there is none yet
+PbrMaterialDescriptor findPbrMaterial(const std::string& directory)
+{
+    PbrMaterialDescriptor material;
+    std::string path = directory + '/' + PBR_MATERIAL_FILE;
+    if (!readPbrMaterial(path, material))
+    {
+        material = scanPbrMaterial(directory);
+        writePbrMaterial(path, material);
+    }
+    return material;
+}
+
+// occlusion, roughness and metallic of the material in one RGB image (malloc'd, null if an image can't be
+// read). one channel of each image is used, grey for color images; smaller images are scaled up
+// bilinearly to the largest. a material of constants only is 4x4.
+unsigned char* packOrm(const std::string& directory, const PbrMaterialDescriptor& material, int& width, int& height)
+{
+    PROFILE_ZONE("packOrm");
+    struct Channel {
+        unsigned char* pixels = nullptr;
+        int width = 0, height = 0;
+    };
+    Channel channels[3];
+    std::atomic<bool> failed{ false };
+    ThreadPool::instance().parallelFor(3, [&](size_t c) {
+        const PbrMaterialMap& map = *material.orm((int)c);
+        if (map.file.empty())
+            return;
+        int components;
+        std::string path = directory + '/' + map.file;
+        std::string source;
+        if (FileSystem::readFile(path, source))
+            channels[c].pixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(source.data()), (int)source.size(),
+                &channels[c].width, &channels[c].height, &components, 1);
+        if (!channels[c].pixels)
+        {
+            std::cout << "Texture failed to load at path: " << path << std::endl;
+            failed = true;
+        }
+    });
+
+    width = height = 4;
+    bool sized = false;
+    for (const Channel& channel : channels)
+        if (channel.pixels && (!sized || channel.width * channel.height > width * height))
+        {
+            width = channel.width;
+            height = channel.height;
+            sized = true;
+        }
+    unsigned char* packed = failed ? nullptr : static_cast<unsigned char*>(std::malloc((size_t)width * height * 3));
+    if (packed)
+    {
+        ThreadPool::instance().parallelFor((size_t)height, [&](size_t y) {
+            unsigned char* row = packed + y * width * 3;
+            for (int c = 0; c < 3; c++)
+            {
+                const Channel& channel = channels[c];
+                if (!channel.pixels)
+                {
+                    unsigned char value = (unsigned char)(glm::clamp(material.orm(c)->value.x, 0.0f, 1.0f) * 255.0f + 0.5f);
+                    for (int x = 0; x < width; x++)
+                        row[x * 3 + c] = value;
+                }
+                else if (channel.width == width && channel.height == height)
+                {
+                    const unsigned char* source = channel.pixels + y * width;
+                    for (int x = 0; x < width; x++)
+                        row[x * 3 + c] = source[x];
+                }
+                else
+                {
+                    // texel centers line up, edges clamp
+                    float sy = glm::clamp(((float)y + 0.5f) * channel.height / height - 0.5f, 0.0f, (float)(channel.height - 1));
+                    int y0 = (int)sy, y1 = std::min(y0 + 1, channel.height - 1);
+                    float fy = sy - y0;
+                    for (int x = 0; x < width; x++)
+                    {
+                        float sx = glm::clamp(((float)x + 0.5f) * channel.width / width - 0.5f, 0.0f, (float)(channel.width - 1));
+                        int x0 = (int)sx, x1 = std::min(x0 + 1, channel.width - 1);
+                        float fx = sx - x0;
+                        const unsigned char* r0 = channel.pixels + (size_t)y0 * channel.width;
+                        const unsigned char* r1 = channel.pixels + (size_t)y1 * channel.width;
+                        float top = r0[x0] + (r0[x1] - r0[x0]) * fx;
+                        float bottom = r1[x0] + (r1[x1] - r1[x0]) * fx;
+                        row[x * 3 + c] = (unsigned char)(top + (bottom - top) * fy + 0.5f);
+                    }
+                }
+            }
+        });
+    }
+    for (Channel& channel : channels)
+        stbi_image_free(channel.pixels);
+    return packed;
+}
+
+// hash of everything the packed texture is built from: the bytes of its images and its constants
+bool hashOrmSources(const std::string& directory, const PbrMaterialDescriptor& material, uint64_t& hash)
+{
+    hash = fnv1a(&PBR_ORM_VERSION, sizeof(PBR_ORM_VERSION));
+    for (int c = 0; c < 3; c++)
+    {
+        const PbrMaterialMap& map = *material.orm(c);
+        if (map.file.empty())
+        {
+            hash = fnv1a(&map.value.x, sizeof(float), hash);
+            continue;
+        }
+        MappedFile file;
+        if (!file.open(directory + '/' + map.file))
+            return false;
+        hash = fnv1a(map.file, hash);
+        hash = fnv1a(file.data(), file.size(), hash);
+    }
+    return true;
+}
+
+// the packed texture of the material, with the same contract as TextureCompressor::load: the BC1 mip chain
+// from orm.dds if it is still valid, cooked and cached otherwise; with compress false the packed pixels instead, or nothing if an image can't be read
+bool cookOrm(const std::string& directory, const PbrMaterialDescriptor& material, bool compress, CompressedTexture& texture, unsigned char*& pixels, int& width, int& height)
+{
+    PROFILE_ZONE("cookOrm");
+    pixels = nullptr;
+    uint64_t hash = 0;
+    std::string cache = directory + '/' + PBR_ORM_FILE;
+    bool hashed = compress && hashOrmSources(directory, material, hash);
+    if (hashed && TextureCompressor::readCache(cache, hash, texture))
+        return true;
+
+    pixels = packOrm(directory, material, width, height);
+    if (!pixels || !compress)
+        return false;
+    TextureCompressor::compress(pixels, width, height, 3, TEXTURE_CODEC_BC1, texture);
+    stbi_image_free(pixels);
+    pixels = nullptr;
+    if (hashed)
+        TextureCompressor::writeCache(cache, hash, texture);
+    return true;
+}
+
+// a material loaded from its directory: albedo and normal map through the texture cache, the packed
+// occlusion/roughness/metallic texture streamed in from orm.dds. maps that are constants get no texture,
+// bind() tells the shader to use the value instead.
+//
+// the shader side:
+//     uniform sampler2D albedoMap, normalMap, ormMap;
+//     uniform bool useAlbedoMap, useNormalMap;
+//     uniform vec3 albedo;
+//     vec3 orm = texture(ormMap, uv).rgb; // occlusion, roughness, metallic
+class PbrMaterial
+{
+public:
+    PbrMaterialDescriptor descriptor;
+    std::string directory;
+    unsigned int albedoMap = 0, normalMap = 0, ormMap = 0;
+
+    // compressOrm false keeps the packed texture uncompressed (RGB8), for closer roughness and metallic
+    explicit PbrMaterial(const std::string& directory, bool compressOrm = true) : directory(directory)
+    {
+        PROFILE_ZONE("PbrMaterial");
+        descriptor = findPbrMaterial(directory);
+        if (!descriptor.albedo.file.empty())
+            albedoMap = TextureCache::instance().acquire(directory + '/' + descriptor.albedo.file, true);
+        if (!descriptor.normal.file.empty())
+            normalMap = TextureCache::instance().acquire(directory + '/' + descriptor.normal.file, false);
+
+        PbrMaterialDescriptor material = descriptor;
+        std::string path = directory;
+        ormMap = TextureStreamer::instance().requestCooked(directory + '/' + PBR_ORM_FILE, false,
+            [material, path, compressOrm](bool compress, CompressedTexture& texture, unsigned char*& pixels, int& width, int& height, int& components) {
+                components = 3;
+                return cookOrm(path, material, compress && compressOrm, texture, pixels, width, height);
+            });
+    }
+
+    ~PbrMaterial()
+    {
+        if (albedoMap)
+            TextureCache::instance().release(albedoMap);
+        if (normalMap)
+            TextureCache::instance().release(normalMap);
+        TextureStreamer::instance().cancel(ormMap);
+        glDeleteTextures(1, &ormMap);
+    }
+
+    PbrMaterial(const PbrMaterial&) = delete;
+    PbrMaterial& operator=(const PbrMaterial&) = delete;
+
+    // binds the textures to units firstUnit.. firstUnit + 2 and sets the uniforms above
+    void bind(const Shader& shader, int firstUnit = 0) const
+    {
+        glActiveTexture(GL_TEXTURE0 + firstUnit);
+        glBindTexture(GL_TEXTURE_2D, albedoMap);
+        glActiveTexture(GL_TEXTURE0 + firstUnit + 1);
+        glBindTexture(GL_TEXTURE_2D, normalMap);
+        glActiveTexture(GL_TEXTURE0 + firstUnit + 2);
+        glBindTexture(GL_TEXTURE_2D, ormMap);
+        glActiveTexture(GL_TEXTURE0);
+        shader.setInt("albedoMap", firstUnit);
+        shader.setInt("normalMap", firstUnit + 1);
+        shader.setInt("ormMap", firstUnit + 2);
+        shader.setBool("useAlbedoMap", albedoMap != 0);
+        shader.setBool("useNormalMap", normalMap != 0);
+        shader.setVec3("albedo", descriptor.albedo.value);
+    }
+};
+#endif
@@ -0,0 +1,210 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Lightweight CPU instrumentation. Every thread records completed zones into its own fixed-size ring
+// buffer, so recording a zone never takes a lock; only the first zone a thread records registers its
+// buffer with the profiler. The buffers are dumped as chrome://tracing / Perfetto compatible JSON on demand.
+//
+// usage:
+//     PROFILE_ZONE("gbuffer submit");      // times the enclosing scope
+//     Profiler::instance().setEnabled(false);
+//     Profiler::instance().dumpChromeTrace("trace.json");
+//
+// zone names must outlive the profiler (string literals), they are stored by pointer.
+// define LOGL_PROFILER_DISABLED to compile all zones out.
+
+struct ProfileEvent
+{
+    const char* name;
+    uint64_t    start; // nanoseconds since profiler creation
+    uint64_t    end;
+};
+
+struct ProfileThreadBuffer
+{
+    static const uint64_t CAPACITY = 1 << 14; // power of two, ~384KB per thread
+
+    uint32_t threadID;
+    std::string threadName;
+    std::unique_ptr<ProfileEvent[]> events;
+    std::atomic<uint64_t> head{ 0 }; // total number of events ever written, only the owning thread writes it
+
+    ProfileThreadBuffer(uint32_t id) : threadID(id), events(new ProfileEvent[CAPACITY]) {}
+
+    void push(const ProfileEvent& event)
+    {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        events[h & (CAPACITY - 1)] = event;
+        head.store(h + 1, std::memory_order_release);
+    }
+};
+
+// nanoseconds as the microseconds chrome traces count in, with three exact decimals: through a double at
+// the stream's default precision timestamps lose whole microseconds after a couple of minutes
+void writeTraceMicroseconds(std::ostream& out, uint64_t nanoseconds)
+{
+    out << nanoseconds / 1000 << '.' << std::setfill('0') << std::setw(3) << nanoseconds % 1000 << std::setfill(' ');
+}
+
+class Profiler
+{
+public:
+    static Profiler& instance()
+    {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+    void setEnabled(bool value) { enabled.store(value, std::memory_order_relaxed); }
+
+    uint64_t now() const
+    {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    // records a completed zone on the calling thread's ring buffer
+    void record(const char* name, uint64_t start, uint64_t end)
+    {
+        threadBuffer().push({ name, start, end });
+    }
+
+    // names the calling thread in the exported trace (e.g. "main", "worker 3")
+    void setThreadName(const std::string& name)
+    {
+        ProfileThreadBuffer& buffer = threadBuffer();
+        std::lock_guard<std::mutex> lock(registryMutex);
+        buffer.threadName = name;
+    }
+
+    // creates a named track that isn't bound to a thread, e.g. for gpu pass timings resolved after the fact.
+    // the returned buffer must only be pushed to from one thread at a time.
+    ProfileThreadBuffer* createTrack(const std::string& name)
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        buffers.push_back(std::make_unique<ProfileThreadBuffer>((uint32_t)buffers.size() + 1));
+        buffers.back()->threadName = name;
+        return buffers.back().get();
+    }
+
+    // writes every buffered zone of every thread in the chrome trace event format.
+    // safe to call while other threads keep recording; zones overwritten during the dump are dropped.
+    bool dumpChromeTrace(const std::string& path)
+    {
+        std::ofstream file(path);
+        if (!file)
+        {
+            std::cout << "ERROR::PROFILER:: could not open " << path << std::endl;
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(registryMutex);
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        bool first = true;
+        for (auto& buffer : buffers)
+        {
+            if (!buffer->threadName.empty())
+            {
+                file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadID
+                     << ",\"args\":{\"name\":\"" << buffer->threadName << "\"}}";
+                first = false;
+            }
+
+            uint64_t end = buffer->head.load(std::memory_order_acquire);
+            uint64_t begin = end > ProfileThreadBuffer::CAPACITY ? end - ProfileThreadBuffer::CAPACITY : 0;
+            std::vector<ProfileEvent> snapshot;
+            snapshot.reserve((size_t)(end - begin));
+            for (uint64_t i = begin; i < end; i++)
+                snapshot.push_back(buffer->events[i & (ProfileThreadBuffer::CAPACITY - 1)]);
+            // the writer may have lapped us while copying, discard anything that was overwritten
+            uint64_t after = buffer->head.load(std::memory_order_acquire);
+            uint64_t valid = after > ProfileThreadBuffer::CAPACITY ? after - ProfileThreadBuffer::CAPACITY : 0;
+            size_t skip = valid > begin ? (size_t)(valid - begin) : 0;
+
+            for (size_t i = skip; i < snapshot.size(); i++)
+            {
+                const ProfileEvent& e = snapshot[i];
+                file << (first ? "" : ",\n") << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadID << ",\"ts\":";
+                writeTraceMicroseconds(file, e.start);
+                file << ",\"dur\":";
+                writeTraceMicroseconds(file, e.end - e.start);
+                file << "}";
+                first = false;
+            }
+        }
+        file << "\n]}\n";
+        std::cout << "PROFILER:: trace written to " << path << std::endl;
+        return true;
+    }
+
+private:
+    std::atomic<bool> enabled{ true };
+    std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+    std::mutex registryMutex;
+    std::vector<std::unique_ptr<ProfileThreadBuffer>> buffers; // owned here so they outlive their threads
+
+    Profiler() {}
+
+    ProfileThreadBuffer& threadBuffer()
+    {
+        thread_local ProfileThreadBuffer* buffer = nullptr;
+        if (!buffer)
+        {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            buffers.push_back(std::make_unique<ProfileThreadBuffer>((uint32_t)buffers.size() + 1));
+            buffer = buffers.back().get();
+        }
+        return *buffer;
+    }
+};
+
+// times the enclosing scope, costs a single relaxed load when the profiler is disabled
+class ProfileZone
+{
+public:
+    explicit ProfileZone(const char* zoneName) : name(zoneName)
+    {
+        start = Profiler::instance().isEnabled() ? Profiler::instance().now() : 0;
+    }
+
+    ~ProfileZone()
+    {
+        end();
+    }
+
+    // closes the zone before the end of its scope, for flat code that can't be wrapped in a block
+    void end()
+    {
+        if (start)
+            Profiler::instance().record(name, start, Profiler::instance().now());
+        start = 0;
+    }
+
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+    const char* name;
+    uint64_t start;
+};
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+#ifndef LOGL_PROFILER_DISABLED
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone_, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name)
+#endif
+
+#endif
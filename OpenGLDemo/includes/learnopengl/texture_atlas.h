@@ -0,0 +1,253 @@
+#ifndef TEXTURE_ATLAS_H
+#define TEXTURE_ATLAS_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <stb_image.h>
+
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include <imstb_rectpack.h>
+
+#include <learnopengl/filesystem.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/profiler.h>
+#include <learnopengl/texture_streamer.h>
+#include <learnopengl/thread_pool.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Packs the small textures of a model's materials into shared atlases, so meshes that differ only in
+// which small textures they use end up with the same material and the geometry arena draws them in one
+// call. All textures of a material keep the same place in the atlases of their type (one atlas for the
+// diffuse maps, one for the specular maps...), so one UV rewrite per mesh serves all of them.
+//
+// a material is packed if its textures are all the same size, at most ATLAS_MAX_TEXTURE_SIZE on a side,
+// and the UVs of every mesh using it stay within [0, 1]; repeating textures can't share an atlas. each
+// texture is surrounded by ATLAS_GUTTER pixels of its repeated edge and placed on a multiple of it, so the
+// mips up to ATLAS_MAX_LEVEL don't blend neighbours; the atlases have no smaller mips.
+//
+// the atlases are composed on the thread pool and streamed in like any other texture (see
+// TextureStreamer::requestGenerated); they always hold RGBA8. shaders need no change, which is why this
+// packs into atlases rather than texture array layers.
+
+const int ATLAS_MAX_TEXTURE_SIZE = 256;
+const int ATLAS_MAX_SIZE = 1024;      // the packed vertex formats keep UVs as halves, a texel apart at 2048
+const int ATLAS_GUTTER = 8;
+const int ATLAS_MAX_LEVEL = 3;  // log2(ATLAS_GUTTER)
+const float ATLAS_UV_EPSILON = 0.001f;
+
+// where packTextureAtlas put each rectangle, the texture itself starts ATLAS_GUTTER pixels in
+struct AtlasLayout {
+    int size = 0;                      // the atlas is size x size pixels
+    std::vector<glm::ivec2> positions; // per rectangle, (-1, -1) if it didn't fit
+};
+
+// packs textures of the given sizes, gutters included, into the smallest square atlas (power of two, up to
+// ATLAS_MAX_SIZE) that holds all of them, or as many as fit into the largest. returns false if none fit.
+bool packTextureAtlas(const std::vector<glm::ivec2>& sizes, AtlasLayout& layout)
+{
+    PROFILE_ZONE("packTextureAtlas");
+    std::vector<stbrp_rect> rects(sizes.size());
+    int area = 0;
+    for (size_t i = 0; i < sizes.size(); i++)
+    {
+        // rounded up to the gutter, so every position stays a multiple of it
+        rects[i].id = (int)i;
+        rects[i].w = (sizes[i].x + 2 * ATLAS_GUTTER + ATLAS_GUTTER - 1) / ATLAS_GUTTER * ATLAS_GUTTER;
+        rects[i].h = (sizes[i].y + 2 * ATLAS_GUTTER + ATLAS_GUTTER - 1) / ATLAS_GUTTER * ATLAS_GUTTER;
+        area += rects[i].w * rects[i].h;
+    }
+
+    int size = 64;
+    while (size < ATLAS_MAX_SIZE && size * size < area)
+        size *= 2;
+    for (; size <= ATLAS_MAX_SIZE; size *= 2)
+    {
+        std::vector<stbrp_node> nodes(size);
+        stbrp_context context;
+        stbrp_init_target(&context, size, size, nodes.data(), (int)nodes.size());
+        bool all = stbrp_pack_rects(&context, rects.data(), (int)rects.size()) != 0;
+        if (!all && size < ATLAS_MAX_SIZE)
+            continue;
+
+        layout.size = size;
+        layout.positions.assign(sizes.size(), glm::ivec2(-1));
+        bool any = false;
+        for (const stbrp_rect& rect : rects)
+        {
+            if (!rect.was_packed)
+                continue;
+            layout.positions[rect.id] = glm::ivec2(rect.x, rect.y);
+            any = true;
+        }
+        return any;
+    }
+    return false;
+}
+
+// copies a texture with 1-4 channels into the atlas at 'position' (its gutter's corner) and repeats its edge
+// pixels into the gutter. the channels land where sampling the texture on its own would put them: one is
+// red, two are red and green.
+void blitIntoAtlas(unsigned char* atlas, int atlasSize, const unsigned char* pixels, int width, int height, int components, glm::ivec2 position)
+{
+    for (int y = -ATLAS_GUTTER; y < height + ATLAS_GUTTER; y++)
+    {
+        int sourceY = std::min(std::max(y, 0), height - 1);
+        unsigned char* row = atlas + ((size_t)(position.y + ATLAS_GUTTER + y) * atlasSize + position.x) * 4;
+        for (int x = -ATLAS_GUTTER; x < width + ATLAS_GUTTER; x++)
+        {
+            int sourceX = std::min(std::max(x, 0), width - 1);
+            const unsigned char* source = pixels + ((size_t)sourceY * width + sourceX) * components;
+            unsigned char* target = row + (size_t)(x + ATLAS_GUTTER) * 4;
+            target[0] = target[1] = target[2] = 0;
+            target[3] = 255;
+            std::memcpy(target, source, components);
+        }
+    }
+}
+
+// packs the eligible materials of the meshes (see above): points their textures at the atlases and moves
+// their UVs into place. textures left with id 0 still have to be loaded by the caller. 'directory' is what
+// the texture paths are relative to. returns the atlas textures, which belong to the caller.
+std::vector<unsigned int> buildTextureAtlases(std::vector<Mesh>& meshes, const std::string& directory)
+{
+    PROFILE_ZONE("buildTextureAtlases");
+    // the distinct materials, by their textures
+    std::map<std::vector<std::pair<std::string, std::string>>, std::vector<size_t>> materialMeshes;
+    for (size_t i = 0; i < meshes.size(); i++)
+    {
+        std::vector<std::pair<std::string, std::string>> key;
+        for (const Texture& texture : meshes[i].textures)
+            key.emplace_back(texture.type, texture.path);
+        if (!key.empty())
+            materialMeshes[key].push_back(i);
+    }
+
+    struct Candidate {
+        const std::vector<std::pair<std::string, std::string>>* textures;
+        const std::vector<size_t>* meshes;
+        glm::ivec2 size;
+    };
+    std::vector<Candidate> candidates;
+    for (const auto& material : materialMeshes)
+    {
+        glm::ivec2 size(-1);
+        bool eligible = true;
+        for (size_t t = 0; eligible && t < material.first.size(); t++)
+        {
+            int width, height, components;
+            if (!readImageInfo(directory + '/' + material.first[t].second, width, height, components))
+                eligible = false;
+            else if (size.x < 0)
+                size = glm::ivec2(width, height);
+            else
+                eligible = size == glm::ivec2(width, height);
+        }
+        eligible = eligible && std::max(size.x, size.y) <= ATLAS_MAX_TEXTURE_SIZE;
+        for (size_t m = 0; eligible && m < material.second.size(); m++)
+            for (const Vertex& vertex : meshes[material.second[m]].vertices)
+                if (glm::any(glm::lessThan(vertex.TexCoords, glm::vec2(-ATLAS_UV_EPSILON))) || glm::any(glm::greaterThan(vertex.TexCoords, glm::vec2(1.0f + ATLAS_UV_EPSILON))))
+                {
+                    eligible = false;
+                    break;
+                }
+        if (eligible)
+            candidates.push_back(Candidate{ &material.first, &material.second, size });
+    }
+    // one material alone saves no material switch
+    std::vector<unsigned int> atlases;
+    if (candidates.size() < 2)
+        return atlases;
+
+    std::vector<glm::ivec2> sizes;
+    for (const Candidate& candidate : candidates)
+        sizes.push_back(candidate.size);
+    AtlasLayout layout;
+    if (!packTextureAtlas(sizes, layout))
+        return atlases;
+
+    // a page per texture slot (type plus how many of that type came before it), all with the same layout
+    struct Member {
+        std::string path;
+        glm::ivec2 size;
+        glm::ivec2 position;
+    };
+    std::map<std::string, std::vector<Member>> pages;
+    std::vector<std::vector<std::string>> candidatePages(candidates.size());
+    size_t packed = 0;
+    for (size_t c = 0; c < candidates.size(); c++)
+    {
+        if (layout.positions[c].x < 0)
+            continue;
+        packed++;
+        std::map<std::string, int> ordinals;
+        for (const auto& texture : *candidates[c].textures)
+        {
+            std::string page = texture.first + "#" + std::to_string(ordinals[texture.first]++);
+            pages[page].push_back(Member{ directory + '/' + texture.second, candidates[c].size, layout.positions[c] });
+            candidatePages[c].push_back(page);
+        }
+    }
+    if (packed < 2)
+        return atlases;
+
+    std::map<std::string, unsigned int> pageTextures;
+    for (const auto& page : pages)
+    {
+        std::shared_ptr<std::vector<Member>> members = std::make_shared<std::vector<Member>>(page.second);
+        int atlasSize = layout.size;
+        unsigned int texture = TextureStreamer::instance().requestGenerated("atlas " + directory + " " + page.first,
+            [members, atlasSize](int& width, int& height, int& components) -> unsigned char* {
+                PROFILE_ZONE("compose atlas");
+                unsigned char* atlas = static_cast<unsigned char*>(std::calloc((size_t)atlasSize * atlasSize, 4));
+                if (!atlas)
+                    return nullptr;
+                // each texture writes only its own rectangle
+                ThreadPool::instance().parallelFor(members->size(), [&](size_t i) {
+                    const Member& member = (*members)[i];
+                    int w = 0, h = 0, c = 0;
+                    std::string source;
+                    unsigned char* pixels = nullptr;
+                    if (FileSystem::readFile(member.path, source))
+                        pixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(source.data()), (int)source.size(), &w, &h, &c, 0);
+                    if (!pixels || w != member.size.x || h != member.size.y)
+                        std::cout << "Texture failed to load at path: " << member.path << std::endl;
+                    else
+                        blitIntoAtlas(atlas, atlasSize, pixels, w, h, c, member.position);
+                    stbi_image_free(pixels);
+                });
+                width = height = atlasSize;
+                components = 4;
+                return atlas;
+            }, ATLAS_MAX_LEVEL);
+        pageTextures[page.first] = texture;
+        atlases.push_back(texture);
+    }
+
+    for (size_t c = 0; c < candidates.size(); c++)
+    {
+        if (layout.positions[c].x < 0)
+            continue;
+        glm::vec2 offset = glm::vec2(layout.positions[c] + ATLAS_GUTTER) / (float)layout.size;
+        glm::vec2 scale = glm::vec2(candidates[c].size) / (float)layout.size;
+        for (size_t m : *candidates[c].meshes)
+        {
+            Mesh& mesh = meshes[m];
+            for (size_t t = 0; t < mesh.textures.size(); t++)
+                mesh.textures[t].id = pageTextures[candidatePages[c][t]];
+            for (Vertex& vertex : mesh.vertices)
+                vertex.TexCoords = offset + glm::clamp(vertex.TexCoords, 0.0f, 1.0f) * scale;
+        }
+    }
+    return atlases;
+}
+#endif
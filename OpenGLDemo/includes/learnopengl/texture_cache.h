@@ -0,0 +1,98 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/hash.h>
+#include <learnopengl/texture_streamer.h>
+
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+
+// Process wide registry of file textures, so every model (and every mesh within it) that uses the same
+// image with the same load parameters shares one GL texture. Entries are keyed by the canonical path plus
+// the parameters, looked up through a hash map and reference counted: acquire() adds a reference and
+// loads the texture on first use, release() drops one and deletes the texture with the last.
+//
+// GL thread only, like the textures it hands out.
+class TextureCache
+{
+public:
+    static TextureCache& instance()
+    {
+        static TextureCache cache;
+        return cache;
+    }
+
+    // a reference to the texture at 'path', streamed in on first use. components forces the channel
+    // count (1-4), 0 keeps the file's own.
+    unsigned int acquire(const std::string& path, bool gamma, int components = 0)
+    {
+        std::string key = makeKey(path, gamma, components);
+        auto entry = entries.find(key);
+        if (entry != entries.end())
+        {
+            entry->second.references++;
+            return entry->second.texture;
+        }
+        unsigned int texture = TextureStreamer::instance().request(path, gamma, components);
+        entries.emplace(key, Entry{ texture, 1 });
+        keys.emplace(texture, key);
+        return texture;
+    }
+
+    // drops a reference taken with acquire()
+    void release(unsigned int texture)
+    {
+        auto key = keys.find(texture);
+        if (key == keys.end())
+        {
+            std::cout << "ERROR::TEXTURE_CACHE:: release of unknown texture " << texture << std::endl;
+            return;
+        }
+        auto entry = entries.find(key->second);
+        if (--entry->second.references > 0)
+            return;
+        TextureStreamer::instance().cancel(texture);
+        glDeleteTextures(1, &texture);
+        entries.erase(entry);
+        keys.erase(key);
+    }
+
+    // number of distinct textures alive
+    size_t size() const { return entries.size(); }
+
+    // absolute, with "." and ".." resolved and symlinks followed where the path exists, so different
+    // spellings of the same file share an entry
+    static std::string canonicalPath(const std::string& path)
+    {
+        std::error_code error;
+        std::filesystem::path canonical = std::filesystem::weakly_canonical(std::filesystem::absolute(path, error), error);
+        if (error)
+            canonical = std::filesystem::path(path).lexically_normal();
+        return canonical.generic_string();
+    }
+
+private:
+    struct Entry {
+        unsigned int texture;
+        int references;
+    };
+
+    struct KeyHash {
+        size_t operator()(const std::string& key) const { return (size_t)fnv1a(key); }
+    };
+
+    std::unordered_map<std::string, Entry, KeyHash> entries;
+    std::unordered_map<unsigned int, std::string> keys; // texture -> key, for release()
+
+    TextureCache() {}
+
+    static std::string makeKey(const std::string& path, bool gamma, int components)
+    {
+        return canonicalPath(path) + (gamma ? "|srgb|" : "|linear|") + std::to_string(components);
+    }
+};
+#endif
@@ -0,0 +1,409 @@
+#ifndef TEXTURE_COMPRESSOR_H
+#define TEXTURE_COMPRESSOR_H
+
+extern "C" {
+#include <image_DXT.h>
+}
+#include <stb_image.h>
+
+#include <learnopengl/dxt_encoder.h>
+#include <learnopengl/filesystem.h>
+#include <learnopengl/hash.h>
+#include <learnopengl/profiler.h>
+#include <learnopengl/thread_pool.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Cooks images into block compressed mip chains, so textures take 4-8x less memory and bandwidth on the
+// GPU and the mips don't have to be generated at load time. Color images become BC1 (DXT1), or BC3 (DXT5)
+// if any pixel is translucent; normal maps ("*_normal", "*_ddn") become BC5, X and Y in two channels,
+// which leaves the shader to rebuild Z = sqrt(1 - X*X - Y*Y). one and two channel images aren't compressed.
+// the blocks and mips come from dxt_encoder.h, each level split by rows over the thread pool.
+//
+// the result is cached next to the source as a regular DDS file ("wall.png" -> "wall.png.dds") and stays
+// valid as long as the hash of the source matches the one stored in the header's reserved words.
+//
+// no OpenGL in here, everything runs on the thread pool.
+
+const uint32_t TEXTURE_CACHE_VERSION = 1;
+
+enum TextureCodec {
+    TEXTURE_CODEC_NONE,
+    TEXTURE_CODEC_BC1,
+    TEXTURE_CODEC_BC3,
+    TEXTURE_CODEC_BC5
+};
+
+// bytes per 4x4 block
+size_t textureCodecBlockSize(TextureCodec codec)
+{
+    return codec == TEXTURE_CODEC_BC1 ? 8 : 16;
+}
+
+size_t compressedLevelSize(TextureCodec codec, int width, int height)
+{
+    return (size_t)((width + 3) / 4) * (size_t)((height + 3) / 4) * textureCodecBlockSize(codec);
+}
+
+// size and channel count of the image at 'path', from the header at its start (stbi_info); only the rare
+// JPEG whose frame header is further in than IMAGE_HEADER_BYTES, behind large metadata, is read whole
+const size_t IMAGE_HEADER_BYTES = 64 * 1024;
+
+bool readImageInfo(const std::string& path, int& width, int& height, int& components)
+{
+    std::string head;
+    if (!FileSystem::readFileHead(path, IMAGE_HEADER_BYTES, head))
+        return false;
+    if (stbi_info_from_memory(reinterpret_cast<const stbi_uc*>(head.data()), (int)head.size(), &width, &height, &components))
+        return true;
+    return head.size() == IMAGE_HEADER_BYTES && FileSystem::readFile(path, head)
+        && stbi_info_from_memory(reinterpret_cast<const stbi_uc*>(head.data()), (int)head.size(), &width, &height, &components);
+}
+
+// a full mip chain, level 0 first, all levels back to back in one allocation
+struct CompressedTexture {
+    TextureCodec codec = TEXTURE_CODEC_NONE;
+    int width = 0, height = 0;
+    std::vector<unsigned char> data;
+    std::vector<size_t> levelOffsets; // levelCount() + 1 entries, the last one is data.size()
+
+    int levelCount() const { return levelOffsets.empty() ? 0 : (int)levelOffsets.size() - 1; }
+    int levelWidth(int level) const { return std::max(1, width >> level); }
+    int levelHeight(int level) const { return std::max(1, height >> level); }
+    size_t levelSize(int level) const { return levelOffsets[level + 1] - levelOffsets[level]; }
+    const unsigned char* level(int level) const { return data.data() + levelOffsets[level]; }
+
+    void clear()
+    {
+        codec = TEXTURE_CODEC_NONE;
+        std::vector<unsigned char>().swap(data);
+        std::vector<size_t>().swap(levelOffsets);
+    }
+};
+
+class TextureCompressor
+{
+public:
+    static std::string cachePath(const std::string& sourcePath)
+    {
+        return sourcePath + ".dds";
+    }
+
+    static bool isNormalMap(const std::string& path)
+    {
+        std::string name = path.substr(path.find_last_of("/\\") + 1);
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        return name.find("_normal") != std::string::npos || name.find("_ddn") != std::string::npos;
+    }
+
+    static TextureCodec chooseCodec(const std::string& path, const unsigned char* pixels, int width, int height, int components)
+    {
+        if (components < 3)
+            return TEXTURE_CODEC_NONE;
+        if (isNormalMap(path))
+            return TEXTURE_CODEC_BC5;
+        if (components == 4)
+        {
+            size_t pixelCount = (size_t)width * height;
+            for (size_t i = 0; i < pixelCount; i++)
+                if (pixels[i * 4 + 3] != 255)
+                    return TEXTURE_CODEC_BC3;
+        }
+        return TEXTURE_CODEC_BC1;
+    }
+
+    // the compressed mip chain of the image at 'path': read from the cache if it is still valid, cooked
+    // (and cached) otherwise. returns false if the image can't be read or isn't worth compressing; then
+    // 'pixels' holds the decoded image (free with stbi_image_free), or stays null if the file can't be read.
+    static bool load(const std::string& path, CompressedTexture& texture, unsigned char*& pixels, int& width, int& height, int& components)
+    {
+        pixels = nullptr;
+        std::string source;
+        if (!readFile(path, source))
+            return false;
+        return load(path, source, texture, pixels, width, height, components);
+    }
+
+    // like load() above, for the image's file already read into 'source' (e.g. through AsyncIO)
+    static bool load(const std::string& path, const std::string& source, CompressedTexture& texture, unsigned char*& pixels, int& width, int& height, int& components)
+    {
+        PROFILE_ZONE("TextureCompressor::load");
+        pixels = nullptr;
+        uint64_t hash = fnv1a(source);
+        std::string cache = cachePath(path);
+        if (readCache(cache, hash, texture))
+            return true;
+
+        pixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(source.data()), (int)source.size(), &width, &height, &components, 0);
+        if (!pixels)
+            return false;
+        TextureCodec codec = chooseCodec(path, pixels, width, height, components);
+        if (codec == TEXTURE_CODEC_NONE || !compress(pixels, width, height, components, codec, texture))
+            return false;
+        stbi_image_free(pixels);
+        pixels = nullptr;
+        writeCache(cache, hash, texture);
+        return true;
+    }
+
+    // rows of blocks, or of mip pixels, per thread pool task
+    static const int BLOCK_ROWS_PER_TASK = 8;
+    static const int MIP_ROWS_PER_TASK = 32;
+
+    // compresses the image and the box filtered mips below it down to 1x1. 'parallel' spreads the rows of
+    // each level over the thread pool, otherwise everything runs on the calling thread
+    static bool compress(const unsigned char* pixels, int width, int height, int components, TextureCodec codec, CompressedTexture& texture, bool parallel = true)
+    {
+        PROFILE_ZONE("TextureCompressor::compress");
+        texture.clear();
+        texture.codec = codec;
+        texture.width = width;
+        texture.height = height;
+
+        std::vector<unsigned char> level(pixels, pixels + (size_t)width * height * components);
+        std::vector<unsigned char> next;
+        int levelWidth = width, levelHeight = height;
+        while (true)
+        {
+            size_t offset = texture.data.size();
+            texture.levelOffsets.push_back(offset);
+            texture.data.resize(offset + compressedLevelSize(codec, levelWidth, levelHeight));
+            compressLevel(level.data(), levelWidth, levelHeight, components, codec, texture.data.data() + offset, parallel);
+            if (levelWidth == 1 && levelHeight == 1)
+                break;
+
+            int nextWidth = std::max(1, levelWidth / 2), nextHeight = std::max(1, levelHeight / 2);
+            next.resize((size_t)nextWidth * nextHeight * components);
+            forRows(nextHeight, MIP_ROWS_PER_TASK, parallel, [&](int first, int count) {
+                downsample2x2(level.data(), levelWidth, levelHeight, components, next.data(), first, count);
+            });
+            level.swap(next);
+            levelWidth = nextWidth;
+            levelHeight = nextHeight;
+        }
+        texture.levelOffsets.push_back(texture.data.size());
+        return true;
+    }
+
+    // compresses one image without mips into 'output', compressedLevelSize(codec, width, height) bytes
+    static void compressLevel(const unsigned char* pixels, int width, int height, int components, TextureCodec codec, unsigned char* output, bool parallel)
+    {
+        int blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4;
+        size_t blockSize = textureCodecBlockSize(codec);
+        forRows(blocksHigh, BLOCK_ROWS_PER_TASK, parallel, [&](int firstRow, int rowCount) {
+            unsigned char block[16 * 4];
+            unsigned char channel[16];
+            for (int by = firstRow; by < firstRow + rowCount; by++)
+            {
+                unsigned char* out = output + (size_t)by * blocksWide * blockSize;
+                for (int bx = 0; bx < blocksWide; bx++, out += blockSize)
+                {
+                    if (codec == TEXTURE_CODEC_BC5)
+                    {
+                        // two BC4 blocks, red then green. blocks over the border repeat the edge pixels
+                        for (int c = 0; c < 2; c++)
+                        {
+                            for (int j = 0; j < 4; j++)
+                                for (int i = 0; i < 4; i++)
+                                {
+                                    int px = std::min(bx * 4 + i, width - 1), py = std::min(by * 4 + j, height - 1);
+                                    channel[j * 4 + i] = pixels[((size_t)py * width + px) * components + c];
+                                }
+                            encodeAlphaBlock(channel, out + c * 8);
+                        }
+                        continue;
+                    }
+                    gatherBlock(pixels, width, height, components, bx * 4, by * 4, block);
+                    if (codec == TEXTURE_CODEC_BC3)
+                    {
+                        for (int i = 0; i < 16; i++)
+                            channel[i] = block[i * 4 + 3];
+                        encodeAlphaBlock(channel, out);
+                        encodeColorBlock(block, out + 8);
+                    }
+                    else
+                        encodeColorBlock(block, out);
+                }
+            }
+        });
+    }
+
+    static bool readCache(const std::string& path, uint64_t sourceHash, CompressedTexture& texture)
+    {
+        PROFILE_ZONE("TextureCompressor::readCache");
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            return false;
+        DDS_header header;
+        if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)))
+            return false;
+        if (header.dwMagic != DDS_MAGIC || header.dwSize != 124 || !(header.sPixelFormat.dwFlags & DDPF_FOURCC)
+            || header.dwReserved1[0] != CACHE_TAG || header.dwReserved1[1] != TEXTURE_CACHE_VERSION
+            || header.dwReserved1[2] != (uint32_t)sourceHash || header.dwReserved1[3] != (uint32_t)(sourceHash >> 32))
+            return false;
+
+        TextureCodec codec = codecFromFourCC(header.sPixelFormat.dwFourCC);
+        int width = (int)header.dwWidth, height = (int)header.dwHeight;
+        if (codec == TEXTURE_CODEC_NONE || width < 1 || height < 1 || (int)header.dwMipMapCount != mipCount(width, height))
+            return false;
+
+        texture.clear();
+        texture.codec = codec;
+        texture.width = width;
+        texture.height = height;
+        size_t size = 0;
+        for (int level = 0; level < (int)header.dwMipMapCount; level++)
+        {
+            texture.levelOffsets.push_back(size);
+            size += compressedLevelSize(codec, texture.levelWidth(level), texture.levelHeight(level));
+        }
+        texture.levelOffsets.push_back(size);
+        texture.data.resize(size);
+        if (!in.read(reinterpret_cast<char*>(texture.data.data()), (std::streamsize)size))
+        {
+            std::cout << "ERROR::TEXTURE_COMPRESSOR:: truncated cache " << path << std::endl;
+            texture.clear();
+            return false;
+        }
+        return true;
+    }
+
+    static bool writeCache(const std::string& path, uint64_t sourceHash, const CompressedTexture& texture)
+    {
+        PROFILE_ZONE("TextureCompressor::writeCache");
+        DDS_header header;
+        std::memset(&header, 0, sizeof(header));
+        header.dwMagic = DDS_MAGIC;
+        header.dwSize = 124;
+        header.dwFlags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT | DDSD_LINEARSIZE;
+        header.dwHeight = (unsigned int)texture.height;
+        header.dwWidth = (unsigned int)texture.width;
+        header.dwPitchOrLinearSize = (unsigned int)texture.levelSize(0);
+        header.dwMipMapCount = (unsigned int)texture.levelCount();
+        header.dwReserved1[0] = CACHE_TAG;
+        header.dwReserved1[1] = TEXTURE_CACHE_VERSION;
+        header.dwReserved1[2] = (uint32_t)sourceHash;
+        header.dwReserved1[3] = (uint32_t)(sourceHash >> 32);
+        header.sPixelFormat.dwSize = 32;
+        header.sPixelFormat.dwFlags = DDPF_FOURCC;
+        header.sPixelFormat.dwFourCC = fourCC(texture.codec);
+        header.sCaps.dwCaps1 = DDSCAPS_COMPLEX | DDSCAPS_TEXTURE | DDSCAPS_MIPMAP;
+
+        // written aside and renamed, so a reader never sees half a file (several workers may cook the same image)
+        std::string temporary = path + ".tmp" + std::to_string((uintptr_t)&texture);
+        std::ofstream out(temporary, std::ios::binary);
+        if (!out)
+        {
+            std::cout << "ERROR::TEXTURE_COMPRESSOR:: could not write " << temporary << std::endl;
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(texture.data.data()), (std::streamsize)texture.data.size());
+        out.close();
+        if (!out)
+        {
+            std::cout << "ERROR::TEXTURE_COMPRESSOR:: could not write " << temporary << std::endl;
+            std::remove(temporary.c_str());
+            return false;
+        }
+        std::remove(path.c_str()); // rename doesn't replace existing files on windows
+        if (std::rename(temporary.c_str(), path.c_str()) != 0)
+        {
+            std::cout << "ERROR::TEXTURE_COMPRESSOR:: could not replace " << path << std::endl;
+            std::remove(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    static const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+    static const uint32_t CACHE_TAG = 0x4C474F4C;  // "LOGL", marks the reserved words as ours
+
+    static uint32_t makeFourCC(char a, char b, char c, char d)
+    {
+        return (uint32_t)(unsigned char)a | ((uint32_t)(unsigned char)b << 8) | ((uint32_t)(unsigned char)c << 16) | ((uint32_t)(unsigned char)d << 24);
+    }
+
+    static uint32_t fourCC(TextureCodec codec)
+    {
+        switch (codec)
+        {
+        case TEXTURE_CODEC_BC1: return makeFourCC('D', 'X', 'T', '1');
+        case TEXTURE_CODEC_BC3: return makeFourCC('D', 'X', 'T', '5');
+        case TEXTURE_CODEC_BC5: return makeFourCC('A', 'T', 'I', '2');
+        default: return 0;
+        }
+    }
+
+    static TextureCodec codecFromFourCC(uint32_t code)
+    {
+        for (TextureCodec codec : { TEXTURE_CODEC_BC1, TEXTURE_CODEC_BC3, TEXTURE_CODEC_BC5 })
+            if (fourCC(codec) == code)
+                return codec;
+        return TEXTURE_CODEC_NONE;
+    }
+
+    static int mipCount(int width, int height)
+    {
+        int levels = 1;
+        while ((std::max(width, height) >> levels) > 0)
+            levels++;
+        return levels;
+    }
+
+    // runs body(firstRow, rowCount) over [0, rows) in chunks, on the thread pool if parallel
+    template<typename Body>
+    static void forRows(int rows, int rowsPerTask, bool parallel, Body body)
+    {
+        int tasks = (rows + rowsPerTask - 1) / rowsPerTask;
+        if (!parallel || tasks <= 1)
+        {
+            body(0, rows);
+            return;
+        }
+        ThreadPool::instance().parallelFor((size_t)tasks, [&](size_t task) {
+            int first = (int)task * rowsPerTask;
+            body(first, std::min(rowsPerTask, rows - first));
+        });
+    }
+
+    // the 4x4 block at (x, y) as RGBA. like image_DXT, pixels beyond the border repeat the block's first
+    // one, and images without alpha are opaque
+    static void gatherBlock(const unsigned char* pixels, int width, int height, int components, int x, int y, unsigned char block[64])
+    {
+        int columns = std::min(4, width - x), rows = std::min(4, height - y);
+        for (int j = 0; j < 4; j++)
+            for (int i = 0; i < 4; i++)
+            {
+                unsigned char* pixel = block + (j * 4 + i) * 4;
+                if (i >= columns || j >= rows)
+                {
+                    std::memcpy(pixel, block, 4);
+                    continue;
+                }
+                const unsigned char* source = pixels + ((size_t)(y + j) * width + x + i) * components;
+                pixel[0] = source[0];
+                pixel[1] = source[1];
+                pixel[2] = source[2];
+                pixel[3] = components == 4 ? source[3] : 255;
+            }
+    }
+
+    // through FileSystem, so images come from the resource pack when one is mounted
+    static bool readFile(const std::string& path, std::string& content)
+    {
+        return FileSystem::readFile(path, content);
+    }
+};
+#endif
@@ -0,0 +1,525 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <glad/glad.h>
+
+#include <stb_image.h>
+
+#include <learnopengl/async_io.h>
+#include <learnopengl/profiler.h>
+#include <learnopengl/texture_compressor.h>
+#include <learnopengl/thread_pool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// EXT_texture_compression_s3tc and EXT_texture_sRGB, not in the core profile headers
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+// read priorities of streamed textures (AsyncIO): textures nothing has asked for are read in request
+// order, the ones of meshes on screen first, nearer (finer LOD) meshes before farther ones
+const int TEXTURE_PRIORITY_OFFSCREEN = IO_PRIORITY_DEFAULT;
+const int TEXTURE_PRIORITY_VISIBLE = 1000;
+
+// Streams textures in without stalling the render thread. request() hands out the texture name right
+// away, showing a 1x1 placeholder color; the file is read by AsyncIO, decoded on the thread pool, and update() (once per
+// frame, on the GL thread) copies at most uploadBudget bytes per frame into the textures through a ring of
+// pixel buffer objects. The ring is persistently mapped when GL 4.4 is available and mapped unsynchronized
+// per copy otherwise; a fence per ring segment keeps us from overwriting data the GPU hasn't read yet.
+//
+// while level 0 streams in, the texture's base and max level point at its last (1x1) mip holding the
+// placeholder color, so it is always complete. mipmaps are generated once level 0 is fully uploaded.
+//
+// with compressTextures set, file textures are cooked into block compressed mip chains on the worker
+// instead (texture_compressor.h, cached as DDS next to the image) and uploaded a whole level at a time
+// with glCompressedTexImage2D, smallest first, the base level following each one that arrives.
+//
+// the file reads are ordered by priority: prioritize() raises the texture of something drawn this frame,
+// and a texture that isn't prioritized anymore falls back to where it was requested. cancel() also drops
+// the read if it hasn't finished.
+//
+// usage:
+//     unsigned int id = TextureStreamer::instance().request(path, false);
+//     every frame: TextureStreamer::instance().update();
+//     when drawing: TextureStreamer::instance().prioritize(id, TEXTURE_PRIORITY_VISIBLE);
+//     TextureStreamer::instance().finish();   // blocks until everything requested is resident
+class TextureStreamer
+{
+public:
+    static const size_t SEGMENT_SIZE = 4 << 20;
+    static const int SEGMENT_COUNT = 4;
+
+    // bytes copied to the GPU per update(), at least one row of one texture goes through per frame
+    size_t uploadBudget = 4 << 20;
+
+    // block compress textures requested with the file's own channel count, where the driver can sample
+    // S3TC. affects later requests only
+    bool compressTextures = true;
+
+    static TextureStreamer& instance()
+    {
+        static TextureStreamer streamer;
+        return streamer;
+    }
+
+    // creates the texture with the placeholder color and queues reading the image, at 'priority', and then
+    // decoding it. components forces the channel count (1-4), 0 keeps the file's own.
+    unsigned int request(const std::string& path, bool gamma, int components = 0, const unsigned char placeholder[4] = nullptr,
+        int priority = TEXTURE_PRIORITY_OFFSCREEN)
+    {
+        std::shared_ptr<Job> job = createJob(path, gamma, placeholder, GL_REPEAT);
+        job->components = components;
+        job->compress = compressTextures && components == 0 && compressionSupported(gamma);
+        job->requestedPriority = job->priority = priority;
+        // the file comes from AsyncIO (or the resource pack), the decoding runs where it completes
+        job->read = AsyncIO::instance().read(path, priority, [this, job](bool ok, std::string& file) {
+            job->readDone = true;
+            if (ok && !job->cancelled)
+            {
+                PROFILE_ZONE("texture decode");
+                if (job->compress)
+                {
+                    // leaves the decoded pixels instead if the image isn't worth compressing
+                    TextureCompressor::load(job->path, file, job->compressed, job->pixels, job->width, job->height, job->components);
+                }
+                else
+                {
+                    int fileComponents = 0;
+                    job->pixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(file.data()), (int)file.size(), &job->width, &job->height, &fileComponents, job->components);
+                    if (job->components == 0)
+                        job->components = fileComponents;
+                }
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            decoded.push_back(job);
+        });
+        return job->texture;
+    }
+
+    // asks for the texture's file to be read at least at 'priority' during the next frame, e.g. because
+    // something drawn with it is on screen. no effect once the file is read
+    void prioritize(unsigned int texture, int priority)
+    {
+        auto job = active.find(texture);
+        if (job != active.end())
+            job->second->framePriority = std::max(job->second->framePriority, priority);
+    }
+
+    // like request(), for an image built on the thread pool rather than read from a file, e.g. a texture
+    // atlas. generate returns the pixels allocated with malloc (null on failure) and sets their size and
+    // channel count; 'name' only shows up in errors. the texture clamps to its edges unless told otherwise
+    // and only gets mips up to maxLevel.
+    unsigned int requestGenerated(const std::string& name, std::function<unsigned char*(int& width, int& height, int& components)> generate, int maxLevel = 1000,
+        GLint wrap = GL_CLAMP_TO_EDGE, const unsigned char placeholder[4] = nullptr)
+    {
+        std::shared_ptr<Job> job = createJob(name, false, placeholder, wrap);
+        job->maxLevel = maxLevel;
+        ThreadPool::instance().submit([this, job, generate]() {
+            if (!job->cancelled)
+            {
+                PROFILE_ZONE("texture generate");
+                job->pixels = generate(job->width, job->height, job->components);
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            decoded.push_back(job);
+        });
+        return job->texture;
+    }
+
+    // like request(), for a texture cooked on the thread pool from something other than one image file,
+    // e.g. channels packed from several. load works like TextureCompressor::load: it fills 'compressed' and
+    // returns true, or returns false leaving the pixels (malloc'd, null on failure); 'compress' is false if
+    // the driver can't sample the result or compressTextures is off, then it must return pixels.
+    unsigned int requestCooked(const std::string& name, bool gamma,
+        std::function<bool(bool compress, CompressedTexture& compressed, unsigned char*& pixels, int& width, int& height, int& components)> load)
+    {
+        std::shared_ptr<Job> job = createJob(name, gamma, nullptr, GL_REPEAT);
+        job->compress = compressTextures && compressionSupported(gamma);
+        ThreadPool::instance().submit([this, job, load]() {
+            if (!job->cancelled)
+            {
+                PROFILE_ZONE("texture cook");
+                if (!load(job->compress, job->compressed, job->pixels, job->width, job->height, job->components))
+                    job->compressed.clear();
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            decoded.push_back(job);
+        });
+        return job->texture;
+    }
+
+    // stops streaming into a texture that is about to be deleted, the texture itself is left alone
+    void cancel(unsigned int texture)
+    {
+        auto job = active.find(texture);
+        if (job == active.end())
+            return;
+        job->second->cancelled = true;
+        if (job->second->read && !job->second->readDone)
+            AsyncIO::instance().cancel(job->second->read);
+        active.erase(job);
+    }
+
+    // uploads decoded images within the frame's budget, returns true if a texture became resident
+    bool update()
+    {
+        PROFILE_ZONE("TextureStreamer::update");
+        updatePriorities();
+        return upload(uploadBudget, false);
+    }
+
+    // blocks until every requested texture is decoded and uploaded, e.g. before a benchmark
+    void finish()
+    {
+        PROFILE_ZONE("TextureStreamer::finish");
+        while (pending > 0)
+        {
+            upload(SIZE_MAX, true);
+            if (pending > 0)
+                std::this_thread::yield(); // still decoding
+        }
+    }
+
+    // textures requested but not resident yet
+    size_t pendingCount() const { return pending; }
+
+    // whether the driver samples S3TC textures (in sRGB as well, with gamma)
+    bool compressionSupported(bool gamma)
+    {
+        if (s3tc < 0)
+        {
+            s3tc = s3tcSrgb = 0;
+            GLint count = 0;
+            glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+            for (GLint i = 0; i < count; i++)
+            {
+                const char* name = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+                if (std::strcmp(name, "GL_EXT_texture_compression_s3tc") == 0)
+                    s3tc = 1;
+                else if (std::strcmp(name, "GL_EXT_texture_sRGB") == 0)
+                    s3tcSrgb = 1;
+            }
+        }
+        return s3tc && (!gamma || s3tcSrgb);
+    }
+
+    // the GL format of a codec's blocks
+    static GLenum compressedFormat(TextureCodec codec, bool gamma)
+    {
+        switch (codec)
+        {
+        case TEXTURE_CODEC_BC1: return gamma ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case TEXTURE_CODEC_BC3: return gamma ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        default: return GL_COMPRESSED_RG_RGTC2; // normal maps are never gamma encoded
+        }
+    }
+
+private:
+    struct Job {
+        unsigned int texture = 0;
+        std::string path;
+        bool gamma = false;
+        bool compress = false;
+        unsigned char placeholder[4];
+        unsigned char* pixels = nullptr;
+        int width = 0, height = 0, components = 0;
+        int uploadedRows = 0;
+        CompressedTexture compressed;         // the mip chain, instead of pixels, when compressed
+        int uploadedLevels = 0;
+        int maxLevel = 1000;
+        std::atomic<bool> cancelled{ false };
+        IoRequest read = 0;                   // 0 when there is no file to read, or it is in the pack
+        std::atomic<bool> readDone{ false };
+        int requestedPriority = TEXTURE_PRIORITY_OFFSCREEN;
+        int priority = TEXTURE_PRIORITY_OFFSCREEN;       // the read's current one
+        int framePriority = INT_MIN;          // the highest prioritize() since the last update
+    };
+
+    struct Segment {
+        GLsync fence = 0;
+    };
+
+    std::mutex mutex;
+    std::deque<std::shared_ptr<Job>> decoded; // decoded on a worker, waiting for upload
+    std::atomic<size_t> pending{ 0 };
+    std::shared_ptr<Job> current;             // the texture being uploaded
+    std::unordered_map<unsigned int, std::shared_ptr<Job>> active; // by texture, until resident (GL thread only)
+
+    unsigned int pbo = 0;
+    unsigned char* mapped = nullptr;          // the whole ring when persistently mapped
+    Segment segments[SEGMENT_COUNT];
+    int nextSegment = 0;
+    int s3tc = -1, s3tcSrgb = -1;             // extension support, queried on first use
+
+    TextureStreamer() {}
+
+    // the texture with the placeholder color, tracked until it is resident
+    std::shared_ptr<Job> createJob(const std::string& path, bool gamma, const unsigned char placeholder[4], GLint wrap)
+    {
+        static const unsigned char GREY[4] = { 128, 128, 128, 255 };
+        std::shared_ptr<Job> job = std::make_shared<Job>();
+        job->path = path;
+        job->gamma = gamma;
+        std::memcpy(job->placeholder, placeholder ? placeholder : GREY, 4);
+
+        glGenTextures(1, &job->texture);
+        glBindTexture(GL_TEXTURE_2D, job->texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, job->placeholder);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        pending++;
+        active[job->texture] = job;
+        return job;
+    }
+
+    // passes what prioritize() asked for since the last frame on to the reads still waiting, and lets the
+    // textures nothing asked for fall back to their requested priority
+    void updatePriorities()
+    {
+        for (auto& entry : active)
+        {
+            Job& job = *entry.second;
+            if (!job.read || job.readDone)
+                continue;
+            int priority = std::max(job.requestedPriority, job.framePriority);
+            job.framePriority = INT_MIN;
+            if (priority != job.priority)
+            {
+                AsyncIO::instance().setPriority(job.read, priority);
+                job.priority = priority;
+            }
+        }
+    }
+
+    // uploads the next level of a compressed texture, smallest first, and lets sampling use it.
+    // returns the bytes uploaded
+    size_t uploadCompressedLevel(Job& job)
+    {
+        const CompressedTexture& texture = job.compressed;
+        int level = texture.levelCount() - 1 - job.uploadedLevels;
+        glBindTexture(GL_TEXTURE_2D, job.texture);
+        glCompressedTexImage2D(GL_TEXTURE_2D, level, compressedFormat(texture.codec, job.gamma), texture.levelWidth(level), texture.levelHeight(level),
+            0, (GLsizei)texture.levelSize(level), texture.level(level));
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, texture.levelCount() - 1);
+        job.uploadedLevels++;
+        return texture.levelSize(level);
+    }
+
+    void createRing()
+    {
+        glGenBuffers(1, &pbo);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+        if (GLAD_GL_VERSION_4_4)
+        {
+            const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_PIXEL_UNPACK_BUFFER, SEGMENT_SIZE * SEGMENT_COUNT, NULL, flags);
+            mapped = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, SEGMENT_SIZE * SEGMENT_COUNT, flags));
+        }
+        else
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, SEGMENT_SIZE * SEGMENT_COUNT, NULL, GL_STREAM_DRAW);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    static GLenum pixelFormat(int components)
+    {
+        switch (components)
+        {
+        case 1: return GL_RED;
+        case 2: return GL_RG;
+        case 3: return GL_RGB;
+        default: return GL_RGBA;
+        }
+    }
+
+    static GLenum internalFormat(int components, bool gamma)
+    {
+        switch (components)
+        {
+        case 1: return GL_R8;
+        case 2: return GL_RG8;
+        case 3: return gamma ? GL_SRGB8 : GL_RGB8;
+        default: return gamma ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+        }
+    }
+
+    // allocates the full mip chain, with the placeholder in the last level and sampling restricted to it
+    void beginUpload(Job& job)
+    {
+        GLenum format = pixelFormat(job.components);
+        GLenum internal = internalFormat(job.components, job.gamma);
+        int levels = 1;
+        while ((std::max(job.width, job.height) >> levels) > 0)
+            levels++;
+
+        glBindTexture(GL_TEXTURE_2D, job.texture);
+        for (int level = 0; level < levels; level++)
+            glTexImage2D(GL_TEXTURE_2D, level, internal, std::max(1, job.width >> level), std::max(1, job.height >> level), 0, format, GL_UNSIGNED_BYTE, NULL);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage2D(GL_TEXTURE_2D, levels - 1, 0, 0, 1, 1, format, GL_UNSIGNED_BYTE, job.placeholder);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, levels - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    }
+
+    // level 0 is complete: sample the real image from now on
+    void finishUpload(Job& job)
+    {
+        glBindTexture(GL_TEXTURE_2D, job.texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, job.maxLevel);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        stbi_image_free(job.pixels);
+        job.pixels = nullptr;
+    }
+
+    bool upload(size_t budget, bool wait)
+    {
+        if (!pbo)
+            createRing();
+
+        bool completed = false;
+        size_t uploaded = 0;
+        while (uploaded < budget)
+        {
+            if (!current)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (decoded.empty())
+                        break;
+                    current = decoded.front();
+                    decoded.pop_front();
+                }
+                if (current->cancelled)
+                {
+                    stbi_image_free(current->pixels);
+                    current.reset();
+                    pending--;
+                    continue;
+                }
+                if (!current->pixels && current->compressed.codec == TEXTURE_CODEC_NONE)
+                {
+                    // keeps the placeholder
+                    std::cout << "Texture failed to load at path: " << current->path << std::endl;
+                    active.erase(current->texture);
+                    current.reset();
+                    pending--;
+                    continue;
+                }
+                if (current->compressed.codec == TEXTURE_CODEC_NONE)
+                    beginUpload(*current);
+            }
+
+            // the texture was deleted halfway through its upload
+            if (current->cancelled)
+            {
+                stbi_image_free(current->pixels);
+                current.reset();
+                pending--;
+                continue;
+            }
+
+            // compressed levels go straight from the job's memory, at least one level per frame
+            if (current->compressed.codec != TEXTURE_CODEC_NONE)
+            {
+                Job& job = *current;
+                uploaded += uploadCompressedLevel(job);
+                if (job.uploadedLevels == job.compressed.levelCount())
+                {
+                    job.compressed.clear();
+                    active.erase(job.texture);
+                    current.reset();
+                    pending--;
+                    completed = true;
+                }
+                continue;
+            }
+
+            // the segment must not be in use by an earlier upload the GPU hasn't consumed yet
+            Segment& segment = segments[nextSegment];
+            if (segment.fence)
+            {
+                GLenum status = glClientWaitSync(segment.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? 1000000000ull : 0);
+                if (status == GL_TIMEOUT_EXPIRED)
+                    break; // try again next frame instead of stalling
+                glDeleteSync(segment.fence);
+                segment.fence = 0;
+            }
+
+            Job& job = *current;
+            size_t rowSize = (size_t)job.width * job.components;
+            size_t rowsLeft = (size_t)(job.height - job.uploadedRows);
+            size_t rows = std::min(rowsLeft, std::max<size_t>(1, std::min(SEGMENT_SIZE, budget - uploaded) / rowSize));
+            if (rows * rowSize > SEGMENT_SIZE)
+                rows = 0; // a single row doesn't fit a segment (over a million pixels wide), upload directly
+            const unsigned char* source = job.pixels + (size_t)job.uploadedRows * rowSize;
+            size_t offset = (size_t)nextSegment * SEGMENT_SIZE;
+
+            glBindTexture(GL_TEXTURE_2D, job.texture);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            if (rows == 0)
+            {
+                rows = rowsLeft;
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, job.uploadedRows, job.width, (GLsizei)rows, pixelFormat(job.components), GL_UNSIGNED_BYTE, source);
+            }
+            else
+            {
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+                if (mapped)
+                    std::memcpy(mapped + offset, source, rows * rowSize);
+                else
+                {
+                    void* destination = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, offset, rows * rowSize,
+                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+                    std::memcpy(destination, source, rows * rowSize);
+                    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+                }
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, job.uploadedRows, job.width, (GLsizei)rows, pixelFormat(job.components), GL_UNSIGNED_BYTE, (void*)offset);
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                segment.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+                nextSegment = (nextSegment + 1) % SEGMENT_COUNT;
+            }
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+            uploaded += rows * rowSize;
+            job.uploadedRows += (int)rows;
+            if (job.uploadedRows == job.height)
+            {
+                finishUpload(job);
+                active.erase(job.texture);
+                current.reset();
+                pending--;
+                completed = true;
+            }
+        }
+        return completed;
+    }
+};
+#endif
@@ -0,0 +1,154 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <learnopengl/profiler.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads for CPU side loading work (mesh conversion, image decoding...).
+// Nothing in here may touch OpenGL: the context is only current on the render thread.
+//
+// usage:
+//     ThreadPool::instance().submit([] { ...runs on a worker... });
+//     ThreadPool::instance().parallelFor(meshCount, [&](size_t i) { ...convert mesh i... });
+class ThreadPool
+{
+public:
+    // shared pool with one worker per hardware thread besides the main thread, and at least one
+    static ThreadPool& instance()
+    {
+        static ThreadPool pool(std::max(2u, std::thread::hardware_concurrency()) - 1);
+        return pool;
+    }
+
+    explicit ThreadPool(unsigned int threadCount)
+    {
+        for (unsigned int i = 0; i < threadCount; i++)
+            workers.emplace_back([this, i] { run(i); });
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeUp.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t threadCount() const { return workers.size(); }
+
+    // queues a task, it runs on whichever worker is free first
+    void submit(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push_back(std::move(task));
+        }
+        wakeUp.notify_one();
+    }
+
+    // calls body(i) for every i in [0, count) and returns once all calls finished. the calling thread
+    // works on the range too, so this also makes progress (serially) when every worker is busy or
+    // when called from a worker itself. if a call throws, the calls not started yet are skipped and
+    // the first exception is rethrown here once the others have returned.
+    void parallelFor(size_t count, const std::function<void(size_t)>& body)
+    {
+        if (count == 0)
+            return;
+        struct Range {
+            std::atomic<size_t> next{ 0 };
+            std::atomic<size_t> finished{ 0 };
+            size_t count;
+            const std::function<void(size_t)>* body;
+            std::atomic<bool> failed{ false };
+            std::exception_ptr error;       // the first exception thrown by body, under mutex
+            std::mutex mutex;
+            std::condition_variable done;
+        };
+        // helpers may only get to run after the range is finished, so they share its state
+        std::shared_ptr<Range> range = std::make_shared<Range>();
+        range->count = count;
+        range->body = &body;
+        auto work = [range]() {
+            size_t i;
+            while ((i = range->next.fetch_add(1)) < range->count)
+            {
+                // every index counts as finished, thrown or not, or the caller would wait forever
+                if (!range->failed.load())
+                {
+                    try
+                    {
+                        (*range->body)(i);
+                    }
+                    catch (...)
+                    {
+                        std::lock_guard<std::mutex> lock(range->mutex);
+                        if (!range->error)
+                            range->error = std::current_exception();
+                        range->failed = true;
+                    }
+                }
+                if (range->finished.fetch_add(1) + 1 == range->count)
+                {
+                    std::lock_guard<std::mutex> lock(range->mutex);
+                    range->done.notify_all();
+                }
+            }
+        };
+
+        size_t helpers = std::min(workers.size(), count - 1);
+        for (size_t i = 0; i < helpers; i++)
+            submit(work);
+        work();
+
+        std::unique_lock<std::mutex> lock(range->mutex);
+        range->done.wait(lock, [&] { return range->finished.load() == count; });
+        // taken out of the range, which a helper may be the last to release
+        std::exception_ptr error = std::move(range->error);
+        lock.unlock();
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    bool stopping = false;
+
+    void run(unsigned int index)
+    {
+        Profiler::instance().setThreadName("worker " + std::to_string(index));
+        for (;;)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeUp.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (tasks.empty())
+                    return; // stopping, and nothing left to do
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+};
+#endif
@@ -0,0 +1,840 @@
+#ifndef VIRTUAL_TEXTURE_H
+#define VIRTUAL_TEXTURE_H
+
+#include <glad/glad.h>
+
+#include <stb_image.h>
+
+#include <learnopengl/dxt_encoder.h>
+#include <learnopengl/filesystem.h>
+#include <learnopengl/hash.h>
+#include <learnopengl/mapped_file.h>
+#include <learnopengl/profiler.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/texture_compressor.h>
+#include <learnopengl/texture_streamer.h>
+#include <learnopengl/thread_pool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Sparse virtual texturing: only the pages (128x128 texel tiles of a mip level) that are actually on
+// screen are resident, so texture memory is bounded by the screen resolution instead of by the assets.
+//
+// - each image is cooked once, on the thread pool, into a page file next to it ("wall.png" -> "wall.png.vtex"):
+//   every page of every level down to the one that fits a single page, block compressed like
+//   texture_compressor.h (BC1/BC3/BC5) with a 4 texel border taken from its neighbours (wrapping at the
+//   edges, like GL_REPEAT), so bilinear filtering never needs a second page. valid while the source hash matches.
+// - the physical caches (one per codec) are a fixed grid of page slots, sized in configure() from the screen.
+// - every virtual texture has a page table: a GL_RGBA8UI texture with a mip per level and a texel per page,
+//   holding the slot the page (or, while it isn't resident, its closest resident ancestor) lives in:
+//   R, G = slot x, y; B = level | codec << 4, 255 if nothing is resident yet; A = the texture's id.
+//   shaders look up the page table, then sample the physical cache (see ssao_geometry.fs).
+// - a feedback pass renders the scene at 1/VIRTUAL_FEEDBACK_DIVISOR of the screen size, writing the
+//   (texture id, level, page x, page y) every pixel wants. it is read back asynchronously through pixel
+//   buffers; update() counts the requests, asks for the missing pages coarse levels first, most wanted
+//   first, and reads them from the mapped page files on the thread pool. loaded pages are uploaded within
+//   a per frame budget, evicting the least recently requested page when the cache is full. the coarsest
+//   page of every texture stays resident, so there always is something to sample.
+//
+// textures whose size isn't a power of two (or smaller than a page), one or two channel images, and
+// drivers without S3TC aren't virtualized: acquire() returns 0 and the caller loads them the regular way.
+//
+// usage:
+//     VirtualTextureSystem::instance().configure(screenWidth, screenHeight);
+//     unsigned int pageTable = VirtualTextureSystem::instance().acquire(path);  // bind it like a texture
+//     every frame: beginFeedback(feedbackShader), draw, endFeedback(), then update()
+//     with the material shader in use: bindCaches(shader)
+
+const int VIRTUAL_PAGE_SIZE = 128;
+const int VIRTUAL_PAGE_BORDER = 4;
+const int VIRTUAL_PAGE_SLOT_SIZE = VIRTUAL_PAGE_SIZE + 2 * VIRTUAL_PAGE_BORDER;
+const int VIRTUAL_MAX_PAGES = 256;          // pages across level 0; the feedback stores page coordinates in 8 bits
+const int VIRTUAL_MAX_TEXTURES = 255;       // ids are 8 bits as well, 0 means no virtual texture
+const int VIRTUAL_FEEDBACK_DIVISOR = 8;
+const int VIRTUAL_CACHE_UNIT = 13;          // the physical caches are bound to this unit and the two after it
+const uint32_t VIRTUAL_PAGE_FILE_VERSION = 1;
+
+struct VirtualPageFileHeader {
+    uint32_t magic;         // "LVTX"
+    uint32_t version;
+    uint64_t sourceHash;
+    uint32_t width;
+    uint32_t height;
+    uint32_t codec;         // TextureCodec
+    uint32_t pageSize;      // bytes per compressed page
+    uint32_t pageCount;     // level 0 first, each level row by row
+    uint32_t reserved;
+};
+
+// how a texture splits into pages: every level down to the first one that fits a page
+struct VirtualTextureLayout {
+    int width = 0, height = 0;
+    std::vector<glm::ivec2> levelPages;
+    std::vector<int> firstPage;     // per level, its first page's index; the last entry is the page count
+
+    // false if the size can't be virtualized: both sides must be powers of two between a page and
+    // VIRTUAL_MAX_PAGES pages, and the short side must last until the long one fits a page
+    bool init(int w, int h)
+    {
+        auto powerOfTwo = [](int v) { return v > 0 && (v & (v - 1)) == 0; };
+        if (!powerOfTwo(w) || !powerOfTwo(h) || std::min(w, h) < VIRTUAL_PAGE_SIZE || std::max(w, h) > VIRTUAL_PAGE_SIZE * VIRTUAL_MAX_PAGES
+            || std::max(w, h) / std::min(w, h) > VIRTUAL_PAGE_SIZE)
+            return false;
+        width = w;
+        height = h;
+        levelPages.clear();
+        firstPage.assign(1, 0);
+        for (int level = 0; ; level++)
+        {
+            glm::ivec2 pages(std::max(1, (w >> level) / VIRTUAL_PAGE_SIZE), std::max(1, (h >> level) / VIRTUAL_PAGE_SIZE));
+            levelPages.push_back(pages);
+            firstPage.push_back(firstPage.back() + pages.x * pages.y);
+            if (pages == glm::ivec2(1))
+                break;
+        }
+        return true;
+    }
+
+    int levelCount() const { return (int)levelPages.size(); }
+    int pageCount() const { return firstPage.back(); }
+    int pageIndex(int level, int x, int y) const { return firstPage[level] + y * levelPages[level].x + x; }
+    bool operator==(const VirtualTextureLayout& other) const { return width == other.width && height == other.height; }
+};
+
+class VirtualTextureSystem
+{
+public:
+    // pages uploaded per update(), and page reads on the thread pool at any time
+    size_t pagesPerFrame = 16;
+    size_t maxLoadsInFlight = 32;
+
+    static VirtualTextureSystem& instance()
+    {
+        static VirtualTextureSystem system;
+        return system;
+    }
+
+    static std::string pageFilePath(const std::string& sourcePath)
+    {
+        return sourcePath + ".vtex";
+    }
+
+    // sizes the physical caches (enough slots to cover the screen four times over) and the feedback
+    // target for the given screen, call before the first acquire()
+    void configure(int screenWidth, int screenHeight)
+    {
+        int pagesOnScreen = (screenWidth / VIRTUAL_PAGE_SIZE + 2) * (screenHeight / VIRTUAL_PAGE_SIZE + 2);
+        GLint maxSize = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+        slotsPerSide = (int)std::ceil(std::sqrt(4.0 * pagesOnScreen));
+        slotsPerSide = std::max(8, std::min(slotsPerSide, std::min(255, (int)maxSize / VIRTUAL_PAGE_SLOT_SIZE)));
+        feedbackWidth = std::max(1, screenWidth / VIRTUAL_FEEDBACK_DIVISOR);
+        feedbackHeight = std::max(1, screenHeight / VIRTUAL_FEEDBACK_DIVISOR);
+    }
+
+    bool supported()
+    {
+        return TextureStreamer::instance().compressionSupported(false);
+    }
+
+    // the page table of the image at 'path', shared with everyone else using it; 0 if the image can't be
+    // virtualized (see above). the pages start cooking right away. textures that are sampled with the same
+    // coordinates as another one (the specular map next to a diffuse map) pass the other's page table as
+    // 'leader' and get the pages the leader's feedback asks for.
+    unsigned int acquire(const std::string& path, unsigned int leader = 0)
+    {
+        auto existing = byPath.find(path);
+        if (existing != byPath.end())
+        {
+            VirtualTexture& texture = *textures[existing->second];
+            texture.references++;
+            follow(leader, texture.id);
+            return texture.pageTable;
+        }
+
+        int width, height, components;
+        VirtualTextureLayout layout;
+        if (!supported() || freeIds.empty() || !readImageInfo(path, width, height, components)
+            || components < 3 || !layout.init(width, height))
+            return 0;
+
+        std::shared_ptr<VirtualTexture> texture = std::make_shared<VirtualTexture>();
+        texture->id = freeIds.back();
+        freeIds.pop_back();
+        texture->path = path;
+        texture->layout = layout;
+        texture->pages.resize(layout.pageCount());
+        textures[texture->id] = texture;
+        byPath[path] = texture->id;
+
+        // nothing resident: every entry says so, and carries the id for the feedback pass
+        glGenTextures(1, &texture->pageTable);
+        glBindTexture(GL_TEXTURE_2D, texture->pageTable);
+        std::vector<unsigned char> empty;
+        for (int level = 0; level < layout.levelCount(); level++)
+        {
+            glm::ivec2 pages = layout.levelPages[level];
+            empty.resize((size_t)pages.x * pages.y * 4);
+            for (size_t i = 0; i < empty.size(); i += 4)
+            {
+                empty[i] = empty[i + 1] = 0;
+                empty[i + 2] = 255;
+                empty[i + 3] = (unsigned char)texture->id;
+            }
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8UI, pages.x, pages.y, 0, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, empty.data());
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, layout.levelCount() - 1);
+        byPageTable[texture->pageTable] = texture->id;
+        follow(leader, texture->id);
+
+        pendingCooks++;
+        ThreadPool::instance().submit([this, texture]() {
+            bool cooked = !texture->released && cook(*texture);
+            std::lock_guard<std::mutex> lock(mutex);
+            cookedQueue.push_back(CookResult{ texture, cooked });
+        });
+        return texture->pageTable;
+    }
+
+    // drops a reference taken with acquire(), the last one frees the texture's pages and page table
+    void release(unsigned int pageTable)
+    {
+        auto entry = byPageTable.find(pageTable);
+        if (entry == byPageTable.end())
+        {
+            std::cout << "ERROR::VIRTUAL_TEXTURE:: release of unknown page table " << pageTable << std::endl;
+            return;
+        }
+        std::shared_ptr<VirtualTexture> texture = textures[entry->second];
+        if (--texture->references > 0)
+            return;
+        texture->released = true; // pending reads drop their pages
+        if (texture->codec != TEXTURE_CODEC_NONE)
+        {
+            PhysicalCache& cache = caches[texture->codec - 1];
+            for (Page& page : texture->pages)
+                if (page.slot >= 0)
+                {
+                    cache.slots[page.slot] = Slot();
+                    residentPages--;
+                }
+        }
+        for (auto& other : textures)
+            if (other)
+                other->followers.erase(std::remove(other->followers.begin(), other->followers.end(), texture->id), other->followers.end());
+        glDeleteTextures(1, &texture->pageTable);
+        byPageTable.erase(entry);
+        byPath.erase(texture->path);
+        textures[texture->id].reset();
+        freeIds.push_back(texture->id);
+    }
+
+    // binds the physical caches to their units and points the shader's virtualPagesBC1/BC3/BC5 samplers at
+    // them; the shader must be in use. harmless for shaders without them
+    void bindCaches(Shader& shader)
+    {
+        static const char* NAMES[3] = { "virtualPagesBC1", "virtualPagesBC3", "virtualPagesBC5" };
+        for (int i = 0; i < 3; i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + VIRTUAL_CACHE_UNIT + i);
+            glBindTexture(GL_TEXTURE_2D, caches[i].texture);
+            shader.setInt(NAMES[i], VIRTUAL_CACHE_UNIT + i);
+        }
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // binds and clears the low resolution feedback target. draw what uses virtual textures with a feedback
+    // shader (in use, see virtual_feedback.fs) afterwards, then call endFeedback()
+    void beginFeedback(Shader& shader)
+    {
+        if (!feedbackFramebuffer)
+            createFeedbackTarget();
+        glBindFramebuffer(GL_FRAMEBUFFER, feedbackFramebuffer);
+        glViewport(0, 0, feedbackWidth, feedbackHeight);
+        const GLuint none[4] = { 0, 0, 0, 0 };
+        glClearBufferuiv(GL_COLOR, 0, none);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        // the target is smaller than the screen, so are the levels the shader should ask for
+        shader.setFloat("feedbackLodBias", -std::log2((float)VIRTUAL_FEEDBACK_DIVISOR));
+    }
+
+    // queues the asynchronous read back of the feedback, dropped if both pixel buffers are still busy.
+    // leaves the feedback target bound
+    void endFeedback()
+    {
+        Readback& readback = readbacks[nextReadback];
+        if (readback.fence)
+            return;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, feedbackWidth, feedbackHeight, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        readbackOrder.push_back(nextReadback);
+        nextReadback = (nextReadback + 1) % READBACK_COUNT;
+    }
+
+    // once per frame on the GL thread: takes in cooked textures and finished feedback, starts page reads,
+    // uploads pages within pagesPerFrame. returns true if any page table changed
+    bool update()
+    {
+        PROFILE_ZONE("VirtualTextureSystem::update");
+        takeCooked();
+        readFeedback();
+        uploadPages(pagesPerFrame);
+        return writePageTables();
+    }
+
+    // blocks until every texture is cooked and its coarsest page resident, e.g. before a benchmark
+    void finish()
+    {
+        PROFILE_ZONE("VirtualTextureSystem::finish");
+        while (pendingCooks > 0 || loadsInFlight > 0)
+        {
+            takeCooked();
+            uploadPages(SIZE_MAX);
+            if (pendingCooks > 0 || loadsInFlight > 0)
+                std::this_thread::yield();
+        }
+        writePageTables();
+    }
+
+    size_t textureCount() const { return byPageTable.size(); }
+    size_t resident() const { return residentPages; }
+    size_t slotCount() const { return (size_t)slotsPerSide * slotsPerSide; }
+    size_t loading() const { return loadsInFlight; }
+    size_t requested() const { return lastRequested; }  // distinct pages the last feedback asked for
+    size_t missing() const { return lastMissing; }      // of those, not resident
+    size_t cacheBytes() const
+    {
+        size_t bytes = 0;
+        for (int i = 0; i < 3; i++)
+            if (caches[i].texture)
+                bytes += compressedLevelSize((TextureCodec)(i + 1), slotsPerSide * VIRTUAL_PAGE_SLOT_SIZE, slotsPerSide * VIRTUAL_PAGE_SLOT_SIZE);
+        return bytes;
+    }
+
+    // cooks the page file of the image at 'path' unless a valid one exists; false if the image can't be
+    // read or virtualized. runs on any thread, no GL
+    static bool cookPageFile(const std::string& path, uint64_t& sourceHash)
+    {
+        PROFILE_ZONE("VirtualTextureSystem::cookPageFile");
+        std::string source;
+        if (!FileSystem::readFile(path, source))
+            return false;
+        sourceHash = fnv1a(source);
+        std::string pageFile = pageFilePath(path);
+        {
+            MappedFile existing;
+            if (existing.open(pageFile) && validPageFile(existing, sourceHash))
+                return true;
+        }
+
+        int width, height, components;
+        unsigned char* pixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(source.data()), (int)source.size(), &width, &height, &components, 0);
+        VirtualTextureLayout layout;
+        if (!pixels || components < 3 || !layout.init(width, height))
+        {
+            stbi_image_free(pixels);
+            return false;
+        }
+        TextureCodec codec = TextureCompressor::chooseCodec(path, pixels, width, height, components);
+        size_t pageSize = compressedLevelSize(codec, VIRTUAL_PAGE_SLOT_SIZE, VIRTUAL_PAGE_SLOT_SIZE);
+        std::vector<unsigned char> pages((size_t)layout.pageCount() * pageSize);
+
+        std::vector<unsigned char> level(pixels, pixels + (size_t)width * height * components), next;
+        stbi_image_free(pixels);
+        for (int l = 0; l < layout.levelCount(); l++)
+        {
+            int levelWidth = width >> l, levelHeight = height >> l;
+            glm::ivec2 levelPages = layout.levelPages[l];
+            ThreadPool::instance().parallelFor((size_t)levelPages.x * levelPages.y, [&](size_t i) {
+                int x = (int)i % levelPages.x, y = (int)i / levelPages.x;
+                // the page and its border, wrapping around the edges
+                std::vector<unsigned char> slot((size_t)VIRTUAL_PAGE_SLOT_SIZE * VIRTUAL_PAGE_SLOT_SIZE * components);
+                for (int j = 0; j < VIRTUAL_PAGE_SLOT_SIZE; j++)
+                {
+                    int sourceY = ((y * VIRTUAL_PAGE_SIZE - VIRTUAL_PAGE_BORDER + j) % levelHeight + levelHeight) % levelHeight;
+                    for (int k = 0; k < VIRTUAL_PAGE_SLOT_SIZE; k++)
+                    {
+                        int sourceX = ((x * VIRTUAL_PAGE_SIZE - VIRTUAL_PAGE_BORDER + k) % levelWidth + levelWidth) % levelWidth;
+                        std::memcpy(&slot[((size_t)j * VIRTUAL_PAGE_SLOT_SIZE + k) * components],
+                            &level[((size_t)sourceY * levelWidth + sourceX) * components], components);
+                    }
+                }
+                TextureCompressor::compressLevel(slot.data(), VIRTUAL_PAGE_SLOT_SIZE, VIRTUAL_PAGE_SLOT_SIZE, components, codec,
+                    pages.data() + (size_t)layout.pageIndex(l, x, y) * pageSize, false);
+            });
+            if (l + 1 == layout.levelCount())
+                break;
+            next.resize((size_t)(levelWidth / 2) * (levelHeight / 2) * components);
+            downsample2x2(level.data(), levelWidth, levelHeight, components, next.data(), 0, levelHeight / 2);
+            level.swap(next);
+        }
+
+        VirtualPageFileHeader header;
+        std::memset(&header, 0, sizeof(header));
+        header.magic = PAGE_FILE_MAGIC;
+        header.version = VIRTUAL_PAGE_FILE_VERSION;
+        header.sourceHash = sourceHash;
+        header.width = (uint32_t)width;
+        header.height = (uint32_t)height;
+        header.codec = (uint32_t)codec;
+        header.pageSize = (uint32_t)pageSize;
+        header.pageCount = (uint32_t)layout.pageCount();
+
+        // written aside and renamed, so a reader never sees half a file
+        std::string temporary = pageFile + ".tmp" + std::to_string((uintptr_t)&header);
+        std::ofstream out(temporary, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(pages.data()), (std::streamsize)pages.size());
+        out.close();
+        if (!out)
+        {
+            std::cout << "ERROR::VIRTUAL_TEXTURE:: could not write " << temporary << std::endl;
+            std::remove(temporary.c_str());
+            return false;
+        }
+        std::remove(pageFile.c_str()); // rename doesn't replace existing files on windows
+        if (std::rename(temporary.c_str(), pageFile.c_str()) != 0)
+        {
+            std::cout << "ERROR::VIRTUAL_TEXTURE:: could not replace " << pageFile << std::endl;
+            std::remove(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    static const uint32_t PAGE_FILE_MAGIC = 0x5854564C; // "LVTX"
+    static const int READBACK_COUNT = 2;
+
+    struct Page {
+        int slot = -1;
+        bool loading = false;
+    };
+
+    struct VirtualTexture {
+        int id = 0;
+        std::string path;
+        unsigned int pageTable = 0;
+        int references = 1;
+        VirtualTextureLayout layout;
+        std::vector<Page> pages;        // layout order
+        std::vector<int> followers;     // textures that load the same pages as this one
+        bool dirty = false;             // the page table needs writing
+        bool ready = false;             // cooked, pages can be read
+        std::atomic<bool> released{ false };
+        // set by the worker that cooked it
+        TextureCodec codec = TEXTURE_CODEC_NONE;
+        MappedFile file;
+        size_t pageSize = 0;
+    };
+
+    struct Slot {
+        int texture = 0;        // id of the owner, 0 if free
+        int page = -1;
+        uint64_t lastUsed = 0;  // the last feedback that asked for the page
+        bool pinned = false;    // a coarsest page, never evicted
+    };
+
+    struct PhysicalCache {
+        unsigned int texture = 0;
+        std::vector<Slot> slots;
+    };
+
+    struct CookResult {
+        std::shared_ptr<VirtualTexture> texture;
+        bool cooked;
+    };
+
+    struct LoadedPage {
+        std::shared_ptr<VirtualTexture> texture;
+        int page;
+        bool pinned;
+        std::vector<unsigned char> data;
+    };
+
+    struct Readback {
+        unsigned int buffer = 0;
+        GLsync fence = 0;
+    };
+
+    std::vector<std::shared_ptr<VirtualTexture>> textures;  // by id
+    std::vector<int> freeIds;
+    std::unordered_map<std::string, int> byPath;
+    std::unordered_map<unsigned int, int> byPageTable;
+    PhysicalCache caches[3];    // BC1, BC3, BC5
+    int slotsPerSide = 16;
+    size_t residentPages = 0;
+
+    std::mutex mutex;           // guards the two queues the workers push to
+    std::deque<CookResult> cookedQueue;
+    std::deque<LoadedPage> loadedQueue;
+    size_t pendingCooks = 0;
+    size_t loadsInFlight = 0;
+
+    unsigned int feedbackFramebuffer = 0, feedbackTexture = 0, feedbackDepth = 0;
+    int feedbackWidth = 160, feedbackHeight = 90;
+    Readback readbacks[READBACK_COUNT];
+    int nextReadback = 0;
+    std::deque<int> readbackOrder;
+    std::vector<unsigned char> feedback;
+    uint64_t feedbackCount = 0;
+    size_t lastRequested = 0, lastMissing = 0;
+
+    VirtualTextureSystem()
+    {
+        textures.resize(VIRTUAL_MAX_TEXTURES + 1);
+        for (int id = VIRTUAL_MAX_TEXTURES; id >= 1; id--)
+            freeIds.push_back(id);
+    }
+
+    static bool validPageFile(const MappedFile& file, uint64_t sourceHash)
+    {
+        if (file.size() < sizeof(VirtualPageFileHeader))
+            return false;
+        const VirtualPageFileHeader& header = *reinterpret_cast<const VirtualPageFileHeader*>(file.data());
+        VirtualTextureLayout layout;
+        return header.magic == PAGE_FILE_MAGIC && header.version == VIRTUAL_PAGE_FILE_VERSION && header.sourceHash == sourceHash
+            && header.codec >= TEXTURE_CODEC_BC1 && header.codec <= TEXTURE_CODEC_BC5 && layout.init((int)header.width, (int)header.height)
+            && header.pageCount == (uint32_t)layout.pageCount() && header.pageSize == compressedLevelSize((TextureCodec)header.codec, VIRTUAL_PAGE_SLOT_SIZE, VIRTUAL_PAGE_SLOT_SIZE)
+            && file.size() == sizeof(VirtualPageFileHeader) + (size_t)header.pageCount * header.pageSize;
+    }
+
+    // on a worker: makes sure the page file is there and maps it
+    bool cook(VirtualTexture& texture)
+    {
+        uint64_t sourceHash = 0;
+        if (!cookPageFile(texture.path, sourceHash) || !texture.file.open(pageFilePath(texture.path)) || !validPageFile(texture.file, sourceHash))
+            return false;
+        const VirtualPageFileHeader& header = *reinterpret_cast<const VirtualPageFileHeader*>(texture.file.data());
+        if ((int)header.width != texture.layout.width || (int)header.height != texture.layout.height)
+            return false;
+        texture.codec = (TextureCodec)header.codec;
+        texture.pageSize = header.pageSize;
+        return true;
+    }
+
+    void follow(unsigned int leaderPageTable, int follower)
+    {
+        auto leader = byPageTable.find(leaderPageTable);
+        if (leader == byPageTable.end() || leader->second == follower)
+            return;
+        std::vector<int>& followers = textures[leader->second]->followers;
+        if (std::find(followers.begin(), followers.end(), follower) == followers.end())
+            followers.push_back(follower);
+    }
+
+    void createFeedbackTarget()
+    {
+        glGenFramebuffers(1, &feedbackFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, feedbackFramebuffer);
+        glGenTextures(1, &feedbackTexture);
+        glBindTexture(GL_TEXTURE_2D, feedbackTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8UI, feedbackWidth, feedbackHeight, 0, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, feedbackTexture, 0);
+        glGenRenderbuffers(1, &feedbackDepth);
+        glBindRenderbuffer(GL_RENDERBUFFER, feedbackDepth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, feedbackWidth, feedbackHeight);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, feedbackDepth);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            std::cout << "ERROR::VIRTUAL_TEXTURE:: feedback framebuffer not complete!" << std::endl;
+        for (Readback& readback : readbacks)
+        {
+            glGenBuffers(1, &readback.buffer);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+            glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)feedbackWidth * feedbackHeight * 4, nullptr, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    void takeCooked()
+    {
+        while (true)
+        {
+            CookResult result;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (cookedQueue.empty())
+                    return;
+                result = cookedQueue.front();
+                cookedQueue.pop_front();
+            }
+            pendingCooks--;
+            VirtualTexture& texture = *result.texture;
+            if (texture.released)
+                continue;
+            if (!result.cooked)
+            {
+                // stays unmapped, shaders show their fallback
+                std::cout << "ERROR::VIRTUAL_TEXTURE:: could not cook " << texture.path << std::endl;
+                continue;
+            }
+            texture.ready = true;
+            PhysicalCache& cache = caches[texture.codec - 1];
+            if (!cache.texture)
+                createCache(cache, texture.codec);
+            // the coarsest page is always there to fall back on
+            requestPage(result.texture, texture.layout.pageCount() - 1, true);
+        }
+    }
+
+    void createCache(PhysicalCache& cache, TextureCodec codec)
+    {
+        int size = slotsPerSide * VIRTUAL_PAGE_SLOT_SIZE;
+        glGenTextures(1, &cache.texture);
+        glBindTexture(GL_TEXTURE_2D, cache.texture);
+        glCompressedTexImage2D(GL_TEXTURE_2D, 0, TextureStreamer::compressedFormat(codec, false), size, size, 0,
+            (GLsizei)compressedLevelSize(codec, size, size), nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        cache.slots.assign((size_t)slotsPerSide * slotsPerSide, Slot());
+    }
+
+    // reads the page from the page file on the thread pool
+    void requestPage(const std::shared_ptr<VirtualTexture>& texture, int page, bool pinned)
+    {
+        texture->pages[page].loading = true;
+        loadsInFlight++;
+        ThreadPool::instance().submit([this, texture, page, pinned]() {
+            LoadedPage loaded{ texture, page, pinned, std::vector<unsigned char>() };
+            if (!texture->released)
+            {
+                PROFILE_ZONE("virtual page read");
+                const unsigned char* source = texture->file.data() + sizeof(VirtualPageFileHeader) + (size_t)page * texture->pageSize;
+                loaded.data.assign(source, source + texture->pageSize);
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            loadedQueue.push_back(std::move(loaded));
+        });
+    }
+
+    // the oldest feedback whose read back finished, turned into page requests
+    void readFeedback()
+    {
+        if (readbackOrder.empty())
+            return;
+        Readback& readback = readbacks[readbackOrder.front()];
+        if (glClientWaitSync(readback.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            return;
+        glDeleteSync(readback.fence);
+        readback.fence = 0;
+        readbackOrder.pop_front();
+
+        size_t size = (size_t)feedbackWidth * feedbackHeight * 4;
+        feedback.resize(size);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+        const void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)size, GL_MAP_READ_BIT);
+        if (mapped)
+        {
+            std::memcpy(feedback.data(), mapped, size);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        if (mapped)
+            analyzeFeedback();
+    }
+
+    void analyzeFeedback()
+    {
+        PROFILE_ZONE("VirtualTextureSystem::analyzeFeedback");
+        feedbackCount++;
+        // neighbouring pixels mostly want the same page, count the distinct requests first
+        std::unordered_map<uint32_t, uint32_t> pixels;
+        for (size_t i = 0; i < feedback.size(); i += 4)
+            if (feedback[i])
+                pixels[(uint32_t)feedback[i] | (uint32_t)feedback[i + 1] << 8 | (uint32_t)feedback[i + 2] << 16 | (uint32_t)feedback[i + 3] << 24]++;
+
+        // every page wanted and its ancestors, by texture id and page index
+        std::unordered_map<uint64_t, uint32_t> wanted;
+        auto want = [&](int id, int level, int x, int y, uint32_t count) {
+            const std::shared_ptr<VirtualTexture>& texture = textures[id];
+            if (!texture || !texture->ready)
+                return;
+            const VirtualTextureLayout& layout = texture->layout;
+            for (int l = std::min(level, layout.levelCount() - 1); l < layout.levelCount(); l++)
+            {
+                int shift = l - level;
+                int px = std::min(x >> std::max(shift, 0), layout.levelPages[l].x - 1), py = std::min(y >> std::max(shift, 0), layout.levelPages[l].y - 1);
+                wanted[(uint64_t)id << 32 | (uint32_t)layout.pageIndex(l, px, py)] += count;
+            }
+        };
+        for (const auto& pixel : pixels)
+        {
+            int id = pixel.first & 0xff, level = (pixel.first >> 8) & 0xff, x = (pixel.first >> 16) & 0xff, y = pixel.first >> 24;
+            want(id, level, x, y, pixel.second);
+            if (textures[id])
+                for (int follower : textures[id]->followers)
+                    if (textures[follower] && textures[follower]->layout == textures[id]->layout)
+                        want(follower, level, x, y, pixel.second);
+        }
+
+        // resident pages stay, missing ones load coarse levels first (they are what everything falls back
+        // to), then the ones most pixels want
+        struct Candidate {
+            int texture, page, level;
+            uint32_t count;
+        };
+        std::vector<Candidate> candidates;
+        for (const auto& request : wanted)
+        {
+            int id = (int)(request.first >> 32), index = (int)(uint32_t)request.first;
+            VirtualTexture& texture = *textures[id];
+            Page& page = texture.pages[index];
+            if (page.slot >= 0)
+                caches[texture.codec - 1].slots[page.slot].lastUsed = feedbackCount;
+            else if (!page.loading)
+            {
+                int level = (int)(std::upper_bound(texture.layout.firstPage.begin(), texture.layout.firstPage.end(), index) - texture.layout.firstPage.begin()) - 1;
+                candidates.push_back(Candidate{ id, index, level, request.second });
+            }
+        }
+        lastRequested = wanted.size();
+        lastMissing = candidates.size();
+        std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+            return a.level != b.level ? a.level > b.level : a.count > b.count;
+        });
+        for (const Candidate& candidate : candidates)
+        {
+            if (loadsInFlight >= maxLoadsInFlight)
+                break;
+            requestPage(textures[candidate.texture], candidate.page, false);
+        }
+    }
+
+    // a free slot, or the least recently wanted one no current feedback asks for; -1 if every slot is in use
+    int allocateSlot(PhysicalCache& cache)
+    {
+        int best = -1;
+        for (size_t i = 0; i < cache.slots.size(); i++)
+        {
+            const Slot& slot = cache.slots[i];
+            if (slot.texture == 0)
+                return (int)i;
+            if (!slot.pinned && slot.lastUsed < feedbackCount && (best < 0 || slot.lastUsed < cache.slots[best].lastUsed))
+                best = (int)i;
+        }
+        if (best >= 0)
+        {
+            // evicted, its page table falls back to an ancestor
+            Slot& slot = cache.slots[best];
+            VirtualTexture& owner = *textures[slot.texture];
+            owner.pages[slot.page].slot = -1;
+            owner.dirty = true;
+            slot = Slot();
+            residentPages--;
+        }
+        return best;
+    }
+
+    void uploadPages(size_t budget)
+    {
+        size_t uploaded = 0;
+        while (uploaded < budget)
+        {
+            LoadedPage loaded;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (loadedQueue.empty())
+                    return;
+                loaded = std::move(loadedQueue.front());
+                loadedQueue.pop_front();
+            }
+            loadsInFlight--;
+            VirtualTexture& texture = *loaded.texture;
+            if (texture.released || loaded.data.empty())
+                continue;
+            Page& page = texture.pages[loaded.page];
+            page.loading = false;
+            PhysicalCache& cache = caches[texture.codec - 1];
+            int slot = allocateSlot(cache);
+            if (slot < 0)
+                continue; // the cache is full of wanted pages, asked for again by a later feedback
+
+            glBindTexture(GL_TEXTURE_2D, cache.texture);
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, (slot % slotsPerSide) * VIRTUAL_PAGE_SLOT_SIZE, (slot / slotsPerSide) * VIRTUAL_PAGE_SLOT_SIZE,
+                VIRTUAL_PAGE_SLOT_SIZE, VIRTUAL_PAGE_SLOT_SIZE, TextureStreamer::compressedFormat(texture.codec, false), (GLsizei)loaded.data.size(), loaded.data.data());
+            cache.slots[slot] = Slot{ texture.id, loaded.page, feedbackCount, loaded.pinned };
+            page.slot = slot;
+            texture.dirty = true;
+            residentPages++;
+            uploaded++;
+        }
+    }
+
+    // rewrites the page tables of textures whose pages changed, each missing page pointing at its closest resident ancestor
+    bool writePageTables()
+    {
+        bool changed = false;
+        std::vector<unsigned char> entries;
+        for (const std::shared_ptr<VirtualTexture>& pointer : textures)
+        {
+            if (!pointer || !pointer->dirty)
+                continue;
+            VirtualTexture& texture = *pointer;
+            texture.dirty = false;
+            changed = true;
+            const VirtualTextureLayout& layout = texture.layout;
+            entries.resize((size_t)layout.pageCount() * 4);
+            for (int level = layout.levelCount() - 1; level >= 0; level--)
+            {
+                glm::ivec2 pages = layout.levelPages[level];
+                for (int y = 0; y < pages.y; y++)
+                    for (int x = 0; x < pages.x; x++)
+                    {
+                        int index = layout.pageIndex(level, x, y);
+                        unsigned char* entry = &entries[(size_t)index * 4];
+                        int slot = texture.pages[index].slot;
+                        if (slot >= 0)
+                        {
+                            entry[0] = (unsigned char)(slot % slotsPerSide);
+                            entry[1] = (unsigned char)(slot / slotsPerSide);
+                            entry[2] = (unsigned char)(level | texture.codec << 4);
+                        }
+                        else if (level + 1 < layout.levelCount())
+                        {
+                            glm::ivec2 parentPages = layout.levelPages[level + 1];
+                            std::memcpy(entry, &entries[(size_t)layout.pageIndex(level + 1, std::min(x / 2, parentPages.x - 1), std::min(y / 2, parentPages.y - 1)) * 4], 3);
+                        }
+                        else
+                        {
+                            entry[0] = entry[1] = 0;
+                            entry[2] = 255;
+                        }
+                        entry[3] = (unsigned char)texture.id;
+                    }
+            }
+            glBindTexture(GL_TEXTURE_2D, texture.pageTable);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            for (int level = 0; level < layout.levelCount(); level++)
+                glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, layout.levelPages[level].x, layout.levelPages[level].y, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE,
+                    &entries[(size_t)layout.firstPage[level] * 4]);
+        }
+        return changed;
+    }
+};
+#endif
@@ -0,0 +1,324 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/camera.h>
+#include <learnopengl/gpu_timer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// command line driven benchmark runs of the AO demo
+//
+//   Demo__AO --headless --width 1280 --height 720 --ao hbao --frames 300 --warmup 30 --out bench.json
+//
+// options:
+//   --headless                 render offscreen through EGL, no window or input
+//   --width W --height H       render resolution
+//   --ao MODE                  ssao-hemisphere, ssao-sphere, hbao, or all (runs every mode in turn)
+//   --kernel N                 ssao kernel size (32..256)
+//   --ssao-radius R --ssao-bias B
+//   --hbao-radius R --hbao-bias B --hbao-steps N --hbao-directions N
+//   --frames N --warmup N      measured frames, and frames rendered before measuring
+//   --out PATH                 where the json report is written (default benchmark.json)
+//   --record PATH              record the camera pose of every frame to a camera path file
+//   --replay PATH              drive the camera from a recorded path with a fixed timestep, windowed or
+//                              headless; headless runs measure one frame per recorded pose unless --frames is given
+//   --golden DIR               headless only: compare the AO and final image of every pose and the mean pass
+//                              timings against the references in DIR, exit with 1 on any regression
+//   --update-golden            write the references into the --golden directory instead of comparing
+//   --ssim-threshold S         minimum mean SSIM against a reference image (default 0.97)
+//   --perf-threshold T         allowed slowdown of a pass mean over its baseline (default 0.15 = 15%)
+//   --virtual-textures         stream the backpack's textures as virtual textures and show its diffuse map
+//   --ibl                      light the ambient term with the SH irradiance of resources/textures/hdr/newport_loft.hdr
+//   --relief MODE              relief map the room's walls with bricks2: pom (parallax occlusion mapping) or cone
+//                              (relaxed cone stepping)
+//   --skybox MODE              draw resources/textures/skybox where the g-buffer is empty, its faces cooked into
+//                              BC1 (bc) or uploaded as they are (raw)
+
+struct BenchmarkOptions {
+    bool headless = false;
+    unsigned int width = 1400;
+    unsigned int height = 1200;
+    std::string aoMode = "hbao";
+    int kernelSize = 32;
+    float ssaoRadius = 0.5f;
+    float ssaoBias = 0.025f;
+    float hbaoRadius = 0.5f;
+    float hbaoBias = 0.3f;
+    int hbaoSteps = 5;
+    int hbaoDirections = 4;
+    int frames = 300;
+    int warmup = 30;
+    std::string outPath = "benchmark.json";
+    std::string recordPath;
+    std::string replayPath;
+    bool framesGiven = false;
+    std::string goldenDir;
+    bool updateGolden = false;
+    double ssimThreshold = 0.97;
+    double perfThreshold = 0.15;
+    bool virtualTextures = false;
+    bool ibl = false;
+    int relief = 0;                 // 0 off, 1 parallax occlusion, 2 relaxed cone stepping
+    int skybox = 0;                 // 0 off, 1 BC1 compressed, 2 uncompressed
+};
+
+struct FrameTiming {
+    std::string mode;
+    int pose;
+    double cpuMs;
+    std::vector<GpuTimer::PassTiming> passes;
+};
+
+// parses argv into options, returns false (after printing why) on malformed input
+bool parseBenchmarkArgs(int argc, char** argv, BenchmarkOptions& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--headless")
+            options.headless = true;
+        else if (arg == "--width" && hasValue)
+            options.width = (unsigned int)std::atoi(argv[++i]);
+        else if (arg == "--height" && hasValue)
+            options.height = (unsigned int)std::atoi(argv[++i]);
+        else if (arg == "--ao" && hasValue)
+            options.aoMode = argv[++i];
+        else if (arg == "--kernel" && hasValue)
+            options.kernelSize = std::atoi(argv[++i]);
+        else if (arg == "--ssao-radius" && hasValue)
+            options.ssaoRadius = (float)std::atof(argv[++i]);
+        else if (arg == "--ssao-bias" && hasValue)
+            options.ssaoBias = (float)std::atof(argv[++i]);
+        else if (arg == "--hbao-radius" && hasValue)
+            options.hbaoRadius = (float)std::atof(argv[++i]);
+        else if (arg == "--hbao-bias" && hasValue)
+            options.hbaoBias = (float)std::atof(argv[++i]);
+        else if (arg == "--hbao-steps" && hasValue)
+            options.hbaoSteps = std::atoi(argv[++i]);
+        else if (arg == "--hbao-directions" && hasValue)
+            options.hbaoDirections = std::atoi(argv[++i]);
+        else if (arg == "--frames" && hasValue)
+        {
+            options.frames = std::atoi(argv[++i]);
+            options.framesGiven = true;
+        }
+        else if (arg == "--warmup" && hasValue)
+            options.warmup = std::atoi(argv[++i]);
+        else if (arg == "--out" && hasValue)
+            options.outPath = argv[++i];
+        else if (arg == "--record" && hasValue)
+            options.recordPath = argv[++i];
+        else if (arg == "--replay" && hasValue)
+            options.replayPath = argv[++i];
+        else if (arg == "--golden" && hasValue)
+            options.goldenDir = argv[++i];
+        else if (arg == "--update-golden")
+            options.updateGolden = true;
+        else if (arg == "--ssim-threshold" && hasValue)
+            options.ssimThreshold = std::atof(argv[++i]);
+        else if (arg == "--perf-threshold" && hasValue)
+            options.perfThreshold = std::atof(argv[++i]);
+        else if (arg == "--virtual-textures")
+            options.virtualTextures = true;
+        else if (arg == "--ibl")
+            options.ibl = true;
+        else if (arg == "--relief" && hasValue)
+        {
+            std::string mode = argv[++i];
+            if (mode != "pom" && mode != "cone")
+            {
+                std::cout << "ERROR::BENCHMARK:: --relief must be pom or cone" << std::endl;
+                return false;
+            }
+            options.relief = mode == "pom" ? 1 : 2;
+        }
+        else if (arg == "--skybox" && hasValue)
+        {
+            std::string mode = argv[++i];
+            if (mode != "bc" && mode != "raw")
+            {
+                std::cout << "ERROR::BENCHMARK:: --skybox must be bc or raw" << std::endl;
+                return false;
+            }
+            options.skybox = mode == "bc" ? 1 : 2;
+        }
+        else
+        {
+            std::cout << "ERROR::BENCHMARK:: unknown or incomplete argument " << arg << std::endl;
+            return false;
+        }
+    }
+
+    if (options.aoMode != "ssao-hemisphere" && options.aoMode != "ssao-sphere" && options.aoMode != "hbao" && options.aoMode != "all")
+    {
+        std::cout << "ERROR::BENCHMARK:: --ao must be ssao-hemisphere, ssao-sphere, hbao or all" << std::endl;
+        return false;
+    }
+    if (options.aoMode == "all" && !options.headless)
+    {
+        std::cout << "ERROR::BENCHMARK:: --ao all needs --headless" << std::endl;
+        return false;
+    }
+    if (!options.goldenDir.empty() && !options.headless)
+    {
+        std::cout << "ERROR::BENCHMARK:: --golden needs --headless" << std::endl;
+        return false;
+    }
+    if (options.width == 0 || options.height == 0 || options.frames <= 0 || options.warmup < 0)
+    {
+        std::cout << "ERROR::BENCHMARK:: resolution and frame count must be positive" << std::endl;
+        return false;
+    }
+    options.kernelSize = std::max(1, std::min(options.kernelSize, 256));
+    return true;
+}
+
+// the AO modes a run goes through
+std::vector<std::string> benchmarkModes(const BenchmarkOptions& options)
+{
+    if (options.aoMode == "all")
+        return { "ssao-hemisphere", "ssao-sphere", "hbao" };
+    return { options.aoMode };
+}
+
+// mean cpu frame time ("cpu_frame") and mean gpu time of every pass over the frames of one mode
+std::map<std::string, double> passMeans(const std::vector<FrameTiming>& frames, const std::string& mode)
+{
+    std::map<std::string, double> sums;
+    std::map<std::string, int> counts;
+    for (const FrameTiming& frame : frames)
+    {
+        if (frame.mode != mode)
+            continue;
+        sums["cpu_frame"] += frame.cpuMs;
+        counts["cpu_frame"]++;
+        for (const GpuTimer::PassTiming& pass : frame.passes)
+        {
+            sums[pass.name] += pass.ms;
+            counts[pass.name]++;
+        }
+    }
+    for (auto& sum : sums)
+        sum.second /= counts[sum.first];
+    return sums;
+}
+
+// a pose at 'position' looking at 'target'
+CameraPose lookAtPose(glm::vec3 position, glm::vec3 target, float zoom = ZOOM)
+{
+    glm::vec3 front = glm::normalize(target - position);
+    float yaw = glm::degrees(std::atan2(front.z, front.x));
+    float pitch = glm::degrees(std::asin(front.y));
+    return CameraPose{ position, yaw, pitch, zoom };
+}
+
+// fixed views of the demo scene: an orbit around the backpack at two heights plus two wide shots of the room
+std::vector<CameraPose> benchmarkPoses()
+{
+    const glm::vec3 target(0.0f, 0.5f, 0.0f);
+    std::vector<CameraPose> poses;
+    for (int i = 0; i < 8; i++)
+    {
+        float angle = glm::radians(45.0f * i);
+        float height = (i % 2 == 0) ? 1.0f : 2.5f;
+        poses.push_back(lookAtPose(glm::vec3(std::sin(angle) * 3.5f, height, std::cos(angle) * 3.5f), target));
+    }
+    poses.push_back(lookAtPose(glm::vec3(6.0f, 5.0f, 6.0f), target));
+    poses.push_back(lookAtPose(glm::vec3(-6.0f, 0.0f, 6.5f), target, 30.0f));
+    return poses;
+}
+
+void writeTimingStats(std::ofstream& out, std::vector<double> values)
+{
+    if (values.empty())
+    {
+        out << "null";
+        return;
+    }
+    std::sort(values.begin(), values.end());
+    double sum = 0.0;
+    for (double v : values)
+        sum += v;
+    out << "{\"mean\":" << sum / values.size() << ",\"median\":" << values[values.size() / 2]
+        << ",\"p95\":" << values[std::min(values.size() - 1, values.size() * 95 / 100)]
+        << ",\"min\":" << values.front() << ",\"max\":" << values.back() << "}";
+}
+
+// writes the run configuration, a per pass summary and every measured frame as json
+bool writeBenchmarkJson(const BenchmarkOptions& options, const std::string& renderer, const std::vector<FrameTiming>& frames)
+{
+    std::ofstream out(options.outPath);
+    if (!out)
+    {
+        std::cout << "ERROR::BENCHMARK:: could not open " << options.outPath << std::endl;
+        return false;
+    }
+
+    out << "{\n  \"config\": {\"width\":" << options.width << ",\"height\":" << options.height
+        << ",\"ao\":\"" << options.aoMode << "\",\"kernel\":" << options.kernelSize
+        << ",\"ssao_radius\":" << options.ssaoRadius << ",\"ssao_bias\":" << options.ssaoBias
+        << ",\"hbao_radius\":" << options.hbaoRadius << ",\"hbao_bias\":" << options.hbaoBias
+        << ",\"hbao_steps\":" << options.hbaoSteps << ",\"hbao_directions\":" << options.hbaoDirections
+        << ",\"frames\":" << options.frames << ",\"warmup\":" << options.warmup
+        << ",\"headless\":" << (options.headless ? "true" : "false")
+        << ",\"camera\":\"" << (options.replayPath.empty() ? "fixed poses" : options.replayPath) << "\"},\n";
+    out << "  \"renderer\": \"" << renderer << "\",\n";
+
+    // summary per AO mode: cpu frame time and every pass seen, in first-seen order
+    std::vector<std::string> modes = benchmarkModes(options);
+    out << "  \"summary\": {";
+    for (size_t m = 0; m < modes.size(); m++)
+    {
+        std::vector<std::string> passNames;
+        std::vector<double> cpu;
+        for (const FrameTiming& frame : frames)
+        {
+            if (frame.mode != modes[m])
+                continue;
+            cpu.push_back(frame.cpuMs);
+            for (const GpuTimer::PassTiming& pass : frame.passes)
+                if (std::find(passNames.begin(), passNames.end(), pass.name) == passNames.end())
+                    passNames.push_back(pass.name);
+        }
+
+        out << (m ? ",\n    " : "\n    ") << "\"" << modes[m] << "\": {\"cpu_frame_ms\":";
+        writeTimingStats(out, cpu);
+        for (const std::string& name : passNames)
+        {
+            std::vector<double> values;
+            for (const FrameTiming& frame : frames)
+                if (frame.mode == modes[m])
+                    for (const GpuTimer::PassTiming& pass : frame.passes)
+                        if (name == pass.name)
+                            values.push_back(pass.ms);
+            out << ",\"" << name << "_gpu_ms\":";
+            writeTimingStats(out, values);
+        }
+        out << "}";
+    }
+    out << "\n  },\n";
+
+    out << "  \"frames\": [\n";
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        out << "    {\"index\":" << i << ",\"mode\":\"" << frames[i].mode << "\",\"pose\":" << frames[i].pose
+            << ",\"cpu_ms\":" << frames[i].cpuMs << ",\"gpu_ms\":{";
+        for (size_t p = 0; p < frames[i].passes.size(); p++)
+            out << (p ? "," : "") << "\"" << frames[i].passes[p].name << "\":" << frames[i].passes[p].ms;
+        out << "}}" << (i + 1 < frames.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    std::cout << "BENCHMARK:: report written to " << options.outPath << std::endl;
+    return true;
+}
+#endif
@@ -22,6 +22,8 @@ uniform float NegInvR2;
 uniform vec2 InvResolutionDirection;
 uniform vec2 noiseScale;
 uniform float AOMultiplier;
+// extra rotation of the directions, varied between accumulated frames when refining
+uniform float sampleRotation;
 
 const float PI = 3.14159265359;
 
@@ -71,7 +73,7 @@ float ComputeCoarseAO(vec2 fragUV, float RadiusToScreen , vec3 randomVec, vec3 V
   
   for(float DirectionIndex  = 0; DirectionIndex < directions; ++DirectionIndex)
   {
-    float Angle = Alpha * DirectionIndex;
+    float Angle = Alpha * DirectionIndex + sampleRotation;
 
     // Compute normalized 2D direction
     vec2 Direction = RotateDirection(vec2(cos(Angle), sin(Angle)), randomVec.xy);
@@ -0,0 +1,190 @@
+#ifndef REGRESSION_H
+#define REGRESSION_H
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Golden image and timing regression checks for headless runs (--golden DIR).
+//
+// images are stored as binary PGM (1 channel, the AO buffer) or PPM (3 channels, the final image) so
+// they can be inspected with any viewer and need no image library. They are compared with the mean
+// structural similarity (SSIM) of their luminance, which tolerates the small rasterization differences
+// between drivers while still catching visible changes in the AO.
+//
+// timings are stored per AO mode as "pass mean_ms" lines; a pass regresses when its mean gets slower
+// than baseline * (1 + threshold).
+
+struct GoldenImage {
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    std::vector<unsigned char> pixels; // bottom row first, as read back from GL
+};
+
+bool writePNM(const std::string& path, const GoldenImage& image)
+{
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+    std::fprintf(file, "P%d\n%d %d\n255\n", image.channels == 1 ? 5 : 6, image.width, image.height);
+    std::fwrite(image.pixels.data(), 1, image.pixels.size(), file);
+    std::fclose(file);
+    return true;
+}
+
+bool readPNM(const std::string& path, GoldenImage& image)
+{
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file)
+        return false;
+    int type = 0, maxValue = 0;
+    bool valid = std::fscanf(file, "P%d %d %d %d", &type, &image.width, &image.height, &maxValue) == 4
+        && (type == 5 || type == 6) && maxValue == 255 && image.width > 0 && image.height > 0;
+    if (valid)
+    {
+        std::fgetc(file); // single whitespace before the raster
+        image.channels = type == 5 ? 1 : 3;
+        image.pixels.resize((size_t)image.width * image.height * image.channels);
+        valid = std::fread(image.pixels.data(), 1, image.pixels.size(), file) == image.pixels.size();
+    }
+    std::fclose(file);
+    return valid;
+}
+
+// luminance in [0,1]
+std::vector<float> imageLuminance(const GoldenImage& image)
+{
+    std::vector<float> luminance((size_t)image.width * image.height);
+    for (size_t i = 0; i < luminance.size(); i++)
+    {
+        const unsigned char* p = &image.pixels[i * image.channels];
+        luminance[i] = image.channels == 1 ? p[0] / 255.0f : (0.2126f * p[0] + 0.7152f * p[1] + 0.0722f * p[2]) / 255.0f;
+    }
+    return luminance;
+}
+
+// mean SSIM over 8x8 windows with a stride of 4 pixels
+double computeSSIM(const GoldenImage& a, const GoldenImage& b)
+{
+    if (a.width != b.width || a.height != b.height)
+        return 0.0;
+    const int WINDOW = 8, STRIDE = 4;
+    const double C1 = 0.01 * 0.01, C2 = 0.03 * 0.03;
+    std::vector<float> la = imageLuminance(a), lb = imageLuminance(b);
+
+    double total = 0.0;
+    int windows = 0;
+    for (int y = 0; y + WINDOW <= a.height; y += STRIDE)
+    {
+        for (int x = 0; x + WINDOW <= a.width; x += STRIDE)
+        {
+            double meanA = 0.0, meanB = 0.0;
+            for (int j = 0; j < WINDOW; j++)
+                for (int i = 0; i < WINDOW; i++)
+                {
+                    size_t index = (size_t)(y + j) * a.width + x + i;
+                    meanA += la[index];
+                    meanB += lb[index];
+                }
+            meanA /= WINDOW * WINDOW;
+            meanB /= WINDOW * WINDOW;
+
+            double varA = 0.0, varB = 0.0, covariance = 0.0;
+            for (int j = 0; j < WINDOW; j++)
+                for (int i = 0; i < WINDOW; i++)
+                {
+                    size_t index = (size_t)(y + j) * a.width + x + i;
+                    double da = la[index] - meanA, db = lb[index] - meanB;
+                    varA += da * da;
+                    varB += db * db;
+                    covariance += da * db;
+                }
+            varA /= WINDOW * WINDOW - 1;
+            varB /= WINDOW * WINDOW - 1;
+            covariance /= WINDOW * WINDOW - 1;
+
+            total += ((2.0 * meanA * meanB + C1) * (2.0 * covariance + C2)) /
+                     ((meanA * meanA + meanB * meanB + C1) * (varA + varB + C2));
+            windows++;
+        }
+    }
+    return windows ? total / windows : 1.0;
+}
+
+class RegressionReport
+{
+public:
+    int failures = 0;
+
+    // writes the reference when updating, otherwise compares against it
+    void checkImage(const std::string& directory, const std::string& name, const GoldenImage& image, bool update, double minSSIM)
+    {
+        std::string path = directory + "/" + name + (image.channels == 1 ? ".pgm" : ".ppm");
+        if (update)
+        {
+            if (!writePNM(path, image))
+                fail("could not write " + path);
+            return;
+        }
+        GoldenImage reference;
+        if (!readPNM(path, reference))
+            return fail("missing reference " + path + " (run with --update-golden first)");
+        if (reference.width != image.width || reference.height != image.height)
+            return fail(name + ": resolution differs from the reference");
+        double ssim = computeSSIM(reference, image);
+        std::cout << "REGRESSION:: " << name << " ssim " << ssim << (ssim < minSSIM ? "  FAIL" : "") << std::endl;
+        if (ssim < minSSIM)
+        {
+            writePNM(directory + "/" + name + ".actual" + (image.channels == 1 ? ".pgm" : ".ppm"), image);
+            fail(name + ": image differs from the reference");
+        }
+    }
+
+    // writes the baseline when updating, otherwise compares every pass mean against it
+    void checkTimings(const std::string& directory, const std::string& mode, const std::map<std::string, double>& means, bool update, double threshold)
+    {
+        std::string path = directory + "/" + mode + "_timings.txt";
+        if (update)
+        {
+            std::ofstream out(path);
+            for (const auto& pass : means)
+                out << pass.first << " " << pass.second << "\n";
+            if (!out)
+                fail("could not write " + path);
+            return;
+        }
+        std::ifstream in(path);
+        if (!in)
+            return fail("missing timing baseline " + path + " (run with --update-golden first)");
+        std::string line;
+        while (std::getline(in, line))
+        {
+            std::istringstream fields(line);
+            std::string pass;
+            double baseline = 0.0;
+            if (!(fields >> pass >> baseline))
+                continue;
+            auto current = means.find(pass);
+            if (current == means.end())
+                continue;
+            bool slower = current->second > baseline * (1.0 + threshold);
+            std::cout << "REGRESSION:: " << mode << " " << pass << " " << current->second << " ms (baseline " << baseline << " ms)"
+                      << (slower ? "  FAIL" : "") << std::endl;
+            if (slower)
+                fail(mode + " " + pass + ": slower than the baseline");
+        }
+    }
+
+    void fail(const std::string& reason)
+    {
+        std::cout << "ERROR::REGRESSION:: " << reason << std::endl;
+        failures++;
+    }
+};
+#endif
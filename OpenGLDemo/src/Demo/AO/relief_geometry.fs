@@ -0,0 +1,110 @@
+#version 330 core
+layout (location = 0) out vec3 gPosition;
+layout (location = 1) out vec3 gNormal;
+layout (location = 2) out vec3 gAlbedo;
+
+in vec2 TexCoords;
+in vec3 FragPos;
+in vec3 Normal;
+
+// the geometry pass for relief mapped surfaces (cone_step_map.h), with ssao_geometry.vs: the view ray is
+// followed into the depth map to where it hits the surface, and the G-buffer gets the displaced position
+// with the normal and albedo found there. reliefMode 1 marches the depth map in fixed steps (parallax
+// occlusion mapping), 2 steps along its relaxed cones.
+//
+// reliefMap holds the depth (red) and the square root of the cone ratio (green); reliefDepth is how deep
+// depth 1 is in view space units, reliefTiling how often the maps repeat across the texture coordinates
+uniform int reliefMode;
+uniform sampler2D reliefMap;
+uniform sampler2D reliefAlbedo;
+uniform sampler2D reliefNormal;
+uniform float reliefDepth;
+uniform float reliefTiling;
+
+const float CONE_STEP_MAX_RATIO = 1.0;
+const int CONE_STEPS = 16;
+const int POM_STEPS = 32;
+const int BINARY_STEPS = 6;
+
+// the point (texture coordinates, depth) where the ray from 'start' on the top of the relief, moving
+// 'ray' per unit of depth, meets the surface. each step goes as far as the cone of the texel below allows;
+// once the ray ends up inside (the relaxed cones let it, past one surface at most), or when the steps run
+// out, a binary search over the last step finds the surface
+vec3 relaxedConeStep(vec3 start, vec3 ray)
+{
+    float rayRatio = length(ray.xy);
+    vec3 position = start;
+    vec3 step = vec3(0.0);
+    for (int i = 0; i < CONE_STEPS; i++)
+    {
+        vec2 texel = textureLod(reliefMap, position.xy, 0.0).rg;
+        float height = texel.r - position.z;
+        if (height <= 0.0)
+            break;
+        float coneRatio = texel.g * texel.g * CONE_STEP_MAX_RATIO;
+        step = ray * (coneRatio * height / (rayRatio + coneRatio));
+        position += step;
+    }
+
+    vec3 outside = position - step, inside = position;
+    for (int i = 0; i < BINARY_STEPS; i++)
+    {
+        vec3 middle = 0.5 * (outside + inside);
+        if (textureLod(reliefMap, middle.xy, 0.0).r > middle.z)
+            outside = middle;
+        else
+            inside = middle;
+    }
+    return inside;
+}
+
+// the same with POM_STEPS even steps through the whole depth, then a line between the last two
+vec3 parallaxOcclusion(vec3 start, vec3 ray)
+{
+    vec3 step = ray / float(POM_STEPS);
+    vec3 position = start;
+    float depth = textureLod(reliefMap, position.xy, 0.0).r;
+    float previousHeight = depth;
+    for (int i = 0; i < POM_STEPS && depth > position.z; i++)
+    {
+        previousHeight = depth - position.z;
+        position += step;
+        depth = textureLod(reliefMap, position.xy, 0.0).r;
+    }
+    float after = depth - position.z;
+    float weight = after / min(after - previousHeight, -1e-5);
+    return position - step * clamp(weight, 0.0, 1.0);
+}
+
+void main()
+{
+    // how u and v change across the surface, from the screen space derivatives (the cube has no tangents)
+    vec2 uv = TexCoords * reliefTiling;
+    vec3 dp1 = dFdx(FragPos), dp2 = dFdy(FragPos);
+    vec2 duv1 = dFdx(uv), duv2 = dFdy(uv);
+    vec3 normal = normalize(Normal);
+    vec3 c1 = cross(normal, dp1), c2 = cross(dp2, normal);
+    float area = dot(dp1, c2);
+    vec3 gradientU = (c2 * duv1.x + c1 * duv2.x) / area;
+    vec3 gradientV = (c2 * duv1.y + c1 * duv2.y) / area;
+
+    // the view ray in texture coordinates per unit of depth; seen edge on, the surface stays flat
+    vec3 view = normalize(FragPos);
+    float sinking = dot(view, -normal);
+    vec3 hit = vec3(uv, 0.0);
+    if (sinking > 1e-3 && abs(area) > 1e-12)
+    {
+        vec3 ray = vec3(dot(gradientU, view), dot(gradientV, view), sinking / reliefDepth);
+        ray /= ray.z;
+        hit = reliefMode == 2 ? relaxedConeStep(hit, ray) : parallaxOcclusion(hit, ray);
+    }
+
+    // the displaced position feeds the AO passes, the maps are sampled where the ray hit
+    gPosition = FragPos + view * (hit.z * reliefDepth / max(sinking, 1e-3));
+    // normal maps are cooked into BC5, X and Y only (texture_compressor.h): Z is rebuilt
+    vec3 tangentNormal;
+    tangentNormal.xy = textureGrad(reliefNormal, hit.xy, duv1, duv2).rg * 2.0 - 1.0;
+    tangentNormal.z = sqrt(max(0.0, 1.0 - dot(tangentNormal.xy, tangentNormal.xy)));
+    gNormal = normalize(tangentNormal.x * normalize(gradientU) + tangentNormal.y * normalize(gradientV) + tangentNormal.z * normal);
+    gAlbedo = textureGrad(reliefAlbedo, hit.xy, duv1, duv2).rgb;
+}
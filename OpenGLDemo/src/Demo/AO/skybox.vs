@@ -0,0 +1,16 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+
+out vec3 Direction;
+
+// the rotation of the camera only, so the sky stays at infinity
+uniform mat4 view;
+uniform mat4 projection;
+
+void main()
+{
+    Direction = aPos;
+    vec4 position = projection * mat4(mat3(view)) * vec4(aPos, 1.0);
+    // z = w puts every fragment on the far plane, the depth the g-buffer is cleared to
+    gl_Position = position.xyww;
+}
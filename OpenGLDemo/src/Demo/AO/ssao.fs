@@ -16,6 +16,8 @@ uniform float bias;
 
 // tile noise texture over screen based on screen dimensions divided by noise size
 uniform vec2 noiseScale;
+// extra rotation of the kernel around the normal, varied between accumulated frames when refining
+uniform float sampleRotation;
 
 uniform mat4 projection;
 
@@ -28,6 +30,8 @@ void main()
     // create TBN change-of-basis matrix: from tangent-space to view-space
     vec3 tangent = normalize(randomVec - normal * dot(randomVec, normal));
     vec3 bitangent = cross(normal, tangent);
+    tangent = cos(sampleRotation) * tangent + sin(sampleRotation) * bitangent;
+    bitangent = cross(normal, tangent);
     mat3 TBN = mat3(tangent, bitangent, normal);
     // iterate over the sample kernel and calculate occlusion factor
     float occlusion = 0.0;
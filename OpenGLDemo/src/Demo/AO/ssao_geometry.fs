@@ -7,6 +7,45 @@ in vec2 TexCoords;
 in vec3 FragPos;
 in vec3 Normal;
 
+// with virtualTexturing the diffuse texture is the page table of a virtual texture (virtual_texture.h):
+// a texel per page and a mip per level, holding the physical cache slot, level and codec of the page
+// (or of its closest resident ancestor)
+uniform bool virtualTexturing;
+uniform usampler2D texture_diffuse1;
+uniform sampler2D virtualPagesBC1;
+uniform sampler2D virtualPagesBC3;
+uniform sampler2D virtualPagesBC5;
+
+const float PAGE_SIZE = 128.0;
+const float PAGE_BORDER = 4.0;
+const float PAGE_SLOT_SIZE = 136.0;
+
+vec4 sampleVirtual(usampler2D pageTable, vec2 uv)
+{
+    ivec2 pages = textureSize(pageTable, 0);
+    vec2 size = vec2(pages) * PAGE_SIZE;
+    vec2 dx = dFdx(uv * size), dy = dFdy(uv * size);
+    int coarsest = int(log2(float(max(pages.x, pages.y))) + 0.5);
+    int level = clamp(int(floor(0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8)))), 0, coarsest);
+
+    vec2 wrapped = fract(uv);
+    ivec2 levelPages = max(pages >> level, ivec2(1));
+    uvec4 entry = texelFetch(pageTable, min(ivec2(wrapped * vec2(levelPages)), levelPages - 1), level);
+    if (entry.b == 255u)
+        return vec4(0.95); // nothing resident yet
+
+    // the page that's there may be from a coarser level
+    vec2 texel = wrapped * max(size / exp2(float(entry.b & 15u)), vec2(1.0));
+    vec2 inPage = texel - floor(texel / PAGE_SIZE) * PAGE_SIZE;
+    vec2 slot = vec2(entry.rg) * PAGE_SLOT_SIZE + PAGE_BORDER + inPage;
+    uint codec = entry.b >> 4u;
+    if (codec == 1u)
+        return textureLod(virtualPagesBC1, slot / vec2(textureSize(virtualPagesBC1, 0)), 0.0);
+    if (codec == 2u)
+        return textureLod(virtualPagesBC3, slot / vec2(textureSize(virtualPagesBC3, 0)), 0.0);
+    return textureLod(virtualPagesBC5, slot / vec2(textureSize(virtualPagesBC5, 0)), 0.0);
+}
+
 void main()
 {    
     // store the fragment position vector in the first gbuffer texture
@@ -14,5 +53,5 @@ void main()
     // also store the per-fragment normals into the gbuffer
     gNormal = normalize(Normal);
     // and the diffuse per-fragment color
-    gAlbedo.rgb = vec3(0.95);
-}
\ No newline at end of file
+    gAlbedo.rgb = virtualTexturing ? sampleVirtual(texture_diffuse1, TexCoords).rgb : vec3(0.95);
+}
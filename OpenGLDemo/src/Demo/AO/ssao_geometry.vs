@@ -9,13 +9,17 @@ out vec3 Normal;
 
 uniform bool invertedNormals;
 
+// meshes with quantized positions store them in [0, 1] across their bounds
+uniform vec3 positionScale = vec3(1.0);
+uniform vec3 positionOffset = vec3(0.0);
+
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
 void main()
 {
-    vec4 viewPos = view * model * vec4(aPos, 1.0);
+    vec4 viewPos = view * model * vec4(aPos * positionScale + positionOffset, 1.0);
     FragPos = viewPos.xyz; 
     TexCoords = aTexCoords;
     
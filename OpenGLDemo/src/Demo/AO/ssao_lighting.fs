@@ -17,6 +17,21 @@ struct Light {
 };
 uniform Light light;
 
+// image based ambient: the environment's irradiance / pi as L2 spherical harmonics, in world space
+uniform bool shAmbient;
+uniform vec3 ambientSH[9];
+uniform mat3 viewToWorld;
+
+vec3 irradianceSH(vec3 n)
+{
+    vec3 irradiance = ambientSH[0] * 0.282095
+        + ambientSH[1] * (0.488603 * n.y) + ambientSH[2] * (0.488603 * n.z) + ambientSH[3] * (0.488603 * n.x)
+        + ambientSH[4] * (1.092548 * n.x * n.y) + ambientSH[5] * (1.092548 * n.y * n.z)
+        + ambientSH[6] * (0.315392 * (3.0 * n.z * n.z - 1.0)) + ambientSH[7] * (1.092548 * n.x * n.z)
+        + ambientSH[8] * (0.546274 * (n.x * n.x - n.y * n.y));
+    return max(irradiance, vec3(0.0));
+}
+
 void main()
 {             
     // retrieve data from gbuffer
@@ -27,6 +42,8 @@ void main()
     
     // then calculate lighting as usual
     vec3 ambient = vec3(0.3 * Diffuse * AmbientOcclusion);
+    if (shAmbient)
+        ambient = irradianceSH(normalize(viewToWorld * Normal)) * Diffuse * AmbientOcclusion;
     vec3 lighting  = ambient; 
     vec3 viewDir  = normalize(-FragPos); // viewpos is (0.0.0)
     // diffuse
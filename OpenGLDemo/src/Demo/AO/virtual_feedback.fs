@@ -0,0 +1,27 @@
+#version 330 core
+layout (location = 0) out uvec4 feedback;
+
+in vec2 TexCoords;
+
+// the page table of the virtual texture (see ssao_geometry.fs); every pixel writes the page it needs:
+// (texture id, level, page x, page y)
+uniform usampler2D texture_diffuse1;
+// the feedback target is smaller than the screen, this brings the level back to what the screen needs
+uniform float feedbackLodBias;
+
+const float PAGE_SIZE = 128.0;
+
+void main()
+{
+    ivec2 pages = textureSize(texture_diffuse1, 0);
+    vec2 size = vec2(pages) * PAGE_SIZE;
+    vec2 dx = dFdx(TexCoords * size), dy = dFdy(TexCoords * size);
+    int coarsest = int(log2(float(max(pages.x, pages.y))) + 0.5);
+    float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8)) + feedbackLodBias;
+    int level = clamp(int(floor(lod)), 0, coarsest);
+
+    ivec2 levelPages = max(pages >> level, ivec2(1));
+    ivec2 page = min(ivec2(fract(TexCoords) * vec2(levelPages)), levelPages - 1);
+    uint id = texelFetch(texture_diffuse1, ivec2(0), coarsest).a;
+    feedback = uvec4(id, uint(level), uvec2(page));
+}
@@ -0,0 +1,49 @@
+#include <learnopengl/profiler.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+// Checks that chrome trace timestamps keep microsecond resolution late into a run: two zones 1 us apart,
+// a few minutes after the profiler started, must come out with different, correctly ordered "ts" values.
+//
+// usage: Tests__ProfilerTrace, exit code 1 on failure
+
+// the "ts" of the zone called 'name' in a dumped trace, as written
+static std::string zoneTimestamp(const std::string& trace, const std::string& name)
+{
+    size_t zone = trace.find("{\"name\":\"" + name + "\"");
+    size_t ts = zone == std::string::npos ? zone : trace.find("\"ts\":", zone);
+    if (ts == std::string::npos)
+        return "";
+    ts += 5;
+    return trace.substr(ts, trace.find(',', ts) - ts);
+}
+
+int main()
+{
+    const uint64_t LATE = 123456789ull * 1000; // ~2 minutes in, in nanoseconds
+    ProfileThreadBuffer* track = Profiler::instance().createTrack("trace precision");
+    track->push({ "first zone", LATE, LATE + 500 });
+    track->push({ "second zone", LATE + 1000, LATE + 1500 });
+
+    std::string path = "profiler_trace_test.json";
+    if (!Profiler::instance().dumpChromeTrace(path))
+        return 1;
+    std::ifstream in(path);
+    std::string trace((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    std::remove(path.c_str());
+
+    std::string first = zoneTimestamp(trace, "first zone"), second = zoneTimestamp(trace, "second zone");
+    std::cout << "first zone ts " << first << ", second zone ts " << second << std::endl;
+    if (first != "123456789.000" || second != "123456790.000" || std::stod(first) >= std::stod(second))
+    {
+        std::cout << "ERROR::PROFILER_TRACE:: zones 1 us apart don't get distinct, ordered timestamps" << std::endl;
+        return 1;
+    }
+    std::cout << "passed" << std::endl;
+    return 0;
+}
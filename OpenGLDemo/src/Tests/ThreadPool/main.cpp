@@ -0,0 +1,70 @@
+#include <learnopengl/thread_pool.h>
+
+#include <atomic>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+// Checks ThreadPool::parallelFor: every index runs once, and a body that throws neither hangs the caller
+// nor gets lost: the first exception comes back out of parallelFor, also from nested ranges, and the
+// pool keeps working afterwards.
+//
+// usage: Tests__ThreadPool, exit code 1 on failure (a hang is caught by the ctest timeout)
+
+static int failures = 0;
+
+static void check(bool condition, const std::string& what)
+{
+    std::cout << (condition ? "ok      " : "FAILED  ") << what << std::endl;
+    if (!condition)
+        failures++;
+}
+
+int main()
+{
+    ThreadPool& pool = ThreadPool::instance();
+
+    std::atomic<size_t> sum{ 0 };
+    pool.parallelFor(1000, [&](size_t i) { sum += i; });
+    check(sum == 999 * 1000 / 2, "every index runs once");
+
+    for (size_t thrower : { (size_t)0, (size_t)500, (size_t)999 })
+    {
+        std::string message;
+        try
+        {
+            pool.parallelFor(1000, [&](size_t i) {
+                if (i == thrower)
+                    throw std::runtime_error("index " + std::to_string(i));
+            });
+        }
+        catch (const std::runtime_error& e)
+        {
+            message = e.what();
+        }
+        check(message == "index " + std::to_string(thrower), "throw at index " + std::to_string(thrower) + " is rethrown to the caller");
+    }
+
+    bool caught = false;
+    try
+    {
+        pool.parallelFor(8, [&](size_t) {
+            pool.parallelFor(8, [](size_t j) {
+                if (j == 3)
+                    throw std::runtime_error("nested");
+            });
+        });
+    }
+    catch (const std::runtime_error&)
+    {
+        caught = true;
+    }
+    check(caught, "throw in a nested range reaches the outer caller");
+
+    sum = 0;
+    pool.parallelFor(100, [&](size_t) { sum++; });
+    check(sum == 100, "the pool still works after exceptions");
+
+    std::cout << (failures ? "FAILED" : "passed") << std::endl;
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,131 @@
+#include <learnopengl/filesystem.h>
+#include <learnopengl/pbr_material.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Cooks the PBR materials under a directory (resources/textures/pbr by default), one per subdirectory:
+// writes each material's descriptor (material.pbr) if it has none, or from a fresh scan with --rescan, and
+// its packed occlusion/roughness/metallic texture (orm.dds), then shows which maps are images and which
+// are constants, and the GPU memory of the three maps as separate textures against the packed one.
+//
+// usage: Tools__MaterialCook [directory] [--rescan]
+// exit code 1 if a material fails to cook.
+
+using Clock = std::chrono::steady_clock;
+
+// bytes of an image with its mips as TextureStreamer would keep it: BC1 for three and four channels (four
+// would be BC3 if translucent, counted as BC1 here), uncompressed otherwise
+static size_t separateBytes(const std::string& path, int& width, int& height)
+{
+    int components = 0;
+    if (!stbi_info(path.c_str(), &width, &height, &components))
+        return 0;
+    size_t bytes = 0;
+    for (int level = 0; ; level++)
+    {
+        int w = std::max(1, width >> level), h = std::max(1, height >> level);
+        bytes += components >= 3 ? compressedLevelSize(TEXTURE_CODEC_BC1, w, h) : (size_t)w * h * components;
+        if (w == 1 && h == 1)
+            break;
+    }
+    return bytes;
+}
+
+int main(int argc, char* argv[])
+{
+    std::string directory = FileSystem::getPath("resources/textures/pbr");
+    bool rescan = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--rescan") == 0)
+            rescan = true;
+        else if (argv[i][0] != '-')
+            directory = argv[i];
+        else
+        {
+            std::cout << "ERROR::MATERIAL_COOK:: unknown argument " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<std::filesystem::path> materials;
+    std::error_code error;
+    for (auto it = std::filesystem::directory_iterator(directory, error); !error && it != std::filesystem::directory_iterator(); it.increment(error))
+        if (it->is_directory())
+            materials.push_back(it->path());
+    std::sort(materials.begin(), materials.end());
+    if (materials.empty())
+    {
+        std::cout << "ERROR::MATERIAL_COOK:: no materials in " << directory << std::endl;
+        return 1;
+    }
+
+    std::printf("%-14s %-14s %-14s %-14s %11s %10s %10s %8s\n", "material", "occlusion", "roughness", "metallic", "orm", "separate", "packed", "cook ms");
+    size_t totalSeparate = 0, totalPacked = 0;
+    int failures = 0;
+    for (const std::filesystem::path& material : materials)
+    {
+        std::string path = material.generic_string();
+        PbrMaterialDescriptor descriptor;
+        if (rescan)
+        {
+            descriptor = scanPbrMaterial(path);
+            writePbrMaterial(path + '/' + PBR_MATERIAL_FILE, descriptor);
+        }
+        else
+            descriptor = findPbrMaterial(path);
+
+        char maps[3][32];
+        size_t separate = 0;
+        for (int c = 0; c < 3; c++)
+        {
+            const PbrMaterialMap& map = *descriptor.orm(c);
+            int width = 0, height = 0;
+            if (map.file.empty())
+                std::snprintf(maps[c], sizeof(maps[c]), "= %.2f", map.value.x);
+            else
+            {
+                separate += separateBytes(path + '/' + map.file, width, height);
+                std::snprintf(maps[c], sizeof(maps[c]), "%dx%d", width, height);
+            }
+        }
+
+        Clock::time_point start = Clock::now();
+        CompressedTexture texture;
+        unsigned char* pixels = nullptr;
+        int width = 0, height = 0;
+        bool cooked = cookOrm(path, descriptor, true, texture, pixels, width, height);
+        double milliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        stbi_image_free(pixels);
+        std::string name = material.filename().string();
+        if (!cooked)
+        {
+            std::printf("%-14s could not be cooked\n", name.c_str());
+            failures++;
+            continue;
+        }
+
+        char size[32];
+        std::snprintf(size, sizeof(size), "%dx%d", texture.width, texture.height);
+        std::printf("%-14s %-14s %-14s %-14s %11s %9.1fM %9.1fM %8.1f\n", name.c_str(), maps[0], maps[1], maps[2], size,
+            (double)separate / (1 << 20), (double)texture.data.size() / (1 << 20), milliseconds);
+        totalSeparate += separate;
+        totalPacked += texture.data.size();
+    }
+
+    std::printf("\ntotal: %.1f MB as separate textures, %.1f MB packed, 3 fetches per pixel down to 1\n",
+        (double)totalSeparate / (1 << 20), (double)totalPacked / (1 << 20));
+    if (failures)
+    {
+        std::cout << "ERROR::MATERIAL_COOK:: " << failures << " materials failed to cook" << std::endl;
+        return 1;
+    }
+    return 0;
+}
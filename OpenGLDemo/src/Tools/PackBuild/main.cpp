@@ -0,0 +1,138 @@
+#include <learnopengl/filesystem.h>
+#include <learnopengl/pack_file.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Builds the resource pack the demos mount at startup (pack_file.h): every file under the given
+// directories of the source root (resources by default) except the caches cooked from them (*.dds,
+// *.vtex, *.ibl, *.meshcache), which are rebuilt per machine. Then reads every file back from the pack,
+// checks its hash and its content against the loose file, and times reading all files loose against
+// reading them from the pack.
+//
+// usage: Tools__PackBuild [directory...] [--out PATH] [--no-verify]
+// the pack goes to resources.pack in the root unless --out is given. exit code 1 if building or
+// verifying fails.
+
+using Clock = std::chrono::steady_clock;
+
+static double millisecondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static bool isCache(const std::string& name)
+{
+    static const char* const EXTENSIONS[] = { ".dds", ".vtex", ".ibl", ".cone", ".meshcache", ".pack", ".tmp" };
+    std::string extension = std::filesystem::path(name).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    for (const char* cache : EXTENSIONS)
+        if (extension == cache)
+            return true;
+    return name.find(".tmp") != std::string::npos;
+}
+
+int main(int argc, char* argv[])
+{
+    std::string root = FileSystem::getPath("");
+    std::string out = FileSystem::getPath("resources.pack");
+    std::vector<std::string> directories;
+    bool verify = true;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+            out = argv[++i];
+        else if (std::strcmp(argv[i], "--no-verify") == 0)
+            verify = false;
+        else if (argv[i][0] != '-')
+            directories.push_back(std::filesystem::path(argv[i]).lexically_normal().generic_string());
+        else
+        {
+            std::cout << "ERROR::PACK_BUILD:: unknown argument " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+    if (directories.empty())
+        directories.push_back("resources");
+    for (std::string& directory : directories)
+        if (directory.back() != '/')
+            directory += '/';
+
+    // names are relative to the root, the way FileSystem::packName looks them up
+    Clock::time_point start = Clock::now();
+    PackStats stats;
+    bool built = buildPack(root, out, [&](const std::string& name) {
+        if (isCache(name))
+            return false;
+        for (const std::string& directory : directories)
+            if (name.compare(0, directory.size(), directory) == 0)
+                return true;
+        return false;
+    }, stats);
+    if (!built)
+        return 1;
+    double buildMs = millisecondsSince(start);
+    std::printf("%zu files, %.1f MB -> %.1f MB (%.1f%%), %llu blocks compressed, %llu stored, %.0f ms\n", stats.files,
+        stats.inputBytes / 1048576.0, stats.packBytes / 1048576.0, 100.0 * stats.packBytes / std::max<uint64_t>(1, stats.inputBytes),
+        (unsigned long long)stats.compressedBlocks, (unsigned long long)stats.storedBlocks, buildMs);
+    std::printf("written to %s\n", out.c_str());
+    if (!verify)
+        return 0;
+
+    start = Clock::now();
+    PackReader pack;
+    pack.verifyHashes = true;
+    if (!pack.open(out))
+        return 1;
+    double openMs = millisecondsSince(start);
+
+    // loose: an open and a read per file
+    std::vector<const PackEntryRecord*> entries = pack.list();
+    std::vector<std::string> loose(entries.size());
+    start = Clock::now();
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        std::ifstream in(root + '/' + pack.name(*entries[i]), std::ios::binary);
+        loose[i].assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    double looseMs = millisecondsSince(start);
+
+    int failures = 0;
+    std::string content;
+    start = Clock::now();
+    for (const PackEntryRecord* entry : entries)
+        if (!pack.read(*entry, content))
+            failures++;
+    double packMs = millisecondsSince(start);
+
+    // content, and a part from the middle of every file through block level access
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        const PackEntryRecord& entry = *entries[i];
+        bool same = pack.read(entry, content) && content == loose[i];
+        uint64_t offset = entry.size / 3, size = std::min<uint64_t>(entry.size - offset, PACK_BLOCK_SIZE + 1000);
+        std::string part((size_t)size, '\0');
+        same = same && pack.read(entry, offset, size, reinterpret_cast<unsigned char*>(&part[0])) && part == loose[i].substr((size_t)offset, (size_t)size);
+        if (!same)
+        {
+            std::cout << "ERROR::PACK_BUILD:: " << pack.name(entry) << " differs from the loose file" << std::endl;
+            failures++;
+        }
+    }
+
+    std::printf("open %.2f ms, read all: loose %.1f ms, pack %.1f ms (hashes checked)\n", openMs, looseMs, packMs);
+    if (failures)
+    {
+        std::cout << "ERROR::PACK_BUILD:: " << failures << " files failed to verify" << std::endl;
+        return 1;
+    }
+    std::printf("verified %zu files\n", entries.size());
+    return 0;
+}
@@ -0,0 +1,215 @@
+#include <learnopengl/filesystem.h>
+#include <learnopengl/texture_compressor.h>
+
+extern "C" {
+// not declared in image_DXT.h: compresses the alpha channel of a 4x4 RGBA block into a BC4 block
+void compress_DDS_alpha_block(const unsigned char* const uncompressed, unsigned char compressed[8]);
+}
+#include <image_helper.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Microbenchmark of texture cooking over a directory of images (resources/textures by default).
+// Every image goes through the reference path (image_helper's mipmap_image and image_DXT's block
+// encoders, one thread) and through TextureCompressor::compress on one thread and on the thread pool;
+// the outputs must match byte for byte. Reading the file is timed as well, cooking should keep up with it.
+//
+// usage: Tools__TextureCook [directory] [--repeat N]
+// exit code 1 if any compressed output differs from the reference.
+
+using Clock = std::chrono::steady_clock;
+
+static double millisecondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// the whole mip chain the way the first version of the cooker built it, straight from the C library
+static std::vector<unsigned char> cookReference(const unsigned char* pixels, int width, int height, int components, TextureCodec codec)
+{
+    std::vector<unsigned char> output;
+    std::vector<unsigned char> level(pixels, pixels + (size_t)width * height * components), next;
+    while (true)
+    {
+        if (codec == TEXTURE_CODEC_BC5)
+        {
+            unsigned char block[16 * 4] = {};
+            unsigned char compressed[8];
+            for (int y = 0; y < height; y += 4)
+                for (int x = 0; x < width; x += 4)
+                    for (int channel = 0; channel < 2; channel++)
+                    {
+                        for (int j = 0; j < 4; j++)
+                            for (int i = 0; i < 4; i++)
+                            {
+                                int px = std::min(x + i, width - 1), py = std::min(y + j, height - 1);
+                                block[(j * 4 + i) * 4 + 3] = level[((size_t)py * width + px) * components + channel];
+                            }
+                        compress_DDS_alpha_block(block, compressed);
+                        output.insert(output.end(), compressed, compressed + 8);
+                    }
+        }
+        else
+        {
+            int size = 0;
+            unsigned char* blocks = codec == TEXTURE_CODEC_BC1
+                ? convert_image_to_DXT1(level.data(), width, height, components, &size)
+                : convert_image_to_DXT5(level.data(), width, height, components, &size);
+            output.insert(output.end(), blocks, blocks + size);
+            free(blocks);
+        }
+        if (width == 1 && height == 1)
+            break;
+        int nextWidth = std::max(1, width / 2), nextHeight = std::max(1, height / 2);
+        next.resize((size_t)nextWidth * nextHeight * components);
+        mipmap_image(level.data(), width, height, components, next.data(), width > 1 ? 2 : 1, height > 1 ? 2 : 1);
+        level.swap(next);
+        width = nextWidth;
+        height = nextHeight;
+    }
+    return output;
+}
+
+static bool isImage(const std::filesystem::path& path)
+{
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".tga" || extension == ".bmp";
+}
+
+static const char* codecName(TextureCodec codec)
+{
+    switch (codec)
+    {
+    case TEXTURE_CODEC_BC1: return "BC1";
+    case TEXTURE_CODEC_BC3: return "BC3";
+    case TEXTURE_CODEC_BC5: return "BC5";
+    default: return "-";
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::string directory = FileSystem::getPath("resources/textures");
+    int repeat = 3;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+            repeat = std::max(1, std::atoi(argv[++i]));
+        else if (argv[i][0] != '-')
+            directory = argv[i];
+        else
+        {
+            std::cout << "ERROR::TEXTURE_COOK:: unknown argument " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<std::filesystem::path> files;
+    std::error_code error;
+    for (auto it = std::filesystem::recursive_directory_iterator(directory, error); !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+        if (it->is_regular_file() && isImage(it->path()))
+            files.push_back(it->path());
+    std::sort(files.begin(), files.end());
+    if (files.empty())
+    {
+        std::cout << "ERROR::TEXTURE_COOK:: no images in " << directory << std::endl;
+        return 1;
+    }
+
+    std::printf("%u pool threads, best of %d\n", (unsigned)ThreadPool::instance().threadCount(), repeat);
+    std::printf("%-40s %11s %5s %9s %9s %10s %10s %10s %8s\n", "image", "size", "codec", "read ms", "decode ms", "ref ms", "simd ms", "pool ms", "speedup");
+    double totalRead = 0.0, totalReference = 0.0, totalSerial = 0.0, totalParallel = 0.0;
+    size_t totalBytes = 0, totalPixels = 0;
+    int mismatches = 0;
+    for (const std::filesystem::path& file : files)
+    {
+        double read = 1e30, decode = 1e30, reference = 1e30, serial = 1e30, parallel = 1e30;
+        std::string source;
+        for (int r = 0; r < repeat; r++)
+        {
+            Clock::time_point start = Clock::now();
+            std::ifstream in(file, std::ios::binary);
+            source.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            read = std::min(read, millisecondsSince(start));
+        }
+
+        int width = 0, height = 0, components = 0;
+        unsigned char* pixels = nullptr;
+        for (int r = 0; r < repeat; r++)
+        {
+            stbi_image_free(pixels);
+            Clock::time_point start = Clock::now();
+            pixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(source.data()), (int)source.size(), &width, &height, &components, 0);
+            decode = std::min(decode, millisecondsSince(start));
+        }
+        std::string name = std::filesystem::relative(file, directory).generic_string();
+        if (!pixels)
+        {
+            std::printf("%-40s could not be decoded\n", name.c_str());
+            continue;
+        }
+        TextureCodec codec = TextureCompressor::chooseCodec(file.string(), pixels, width, height, components);
+        if (codec == TEXTURE_CODEC_NONE)
+        {
+            std::printf("%-40s %5dx%-5d %5s  %d channels, not compressed\n", name.c_str(), width, height, "-", components);
+            stbi_image_free(pixels);
+            continue;
+        }
+
+        std::vector<unsigned char> expected;
+        CompressedTexture texture;
+        bool identical = true;
+        for (int r = 0; r < repeat; r++)
+        {
+            Clock::time_point start = Clock::now();
+            expected = cookReference(pixels, width, height, components, codec);
+            reference = std::min(reference, millisecondsSince(start));
+
+            start = Clock::now();
+            TextureCompressor::compress(pixels, width, height, components, codec, texture, false);
+            serial = std::min(serial, millisecondsSince(start));
+            identical = identical && texture.data == expected;
+
+            start = Clock::now();
+            TextureCompressor::compress(pixels, width, height, components, codec, texture, true);
+            parallel = std::min(parallel, millisecondsSince(start));
+            identical = identical && texture.data == expected;
+        }
+        stbi_image_free(pixels);
+
+        std::printf("%-40s %5dx%-5d %5s %9.2f %9.2f %10.2f %10.2f %10.2f %7.1fx%s\n", name.c_str(), width, height, codecName(codec),
+            read, decode, reference, serial, parallel, reference / parallel, identical ? "" : "  MISMATCH");
+        if (!identical)
+            mismatches++;
+        totalRead += read;
+        totalReference += reference;
+        totalSerial += serial;
+        totalParallel += parallel;
+        totalBytes += source.size();
+        totalPixels += (size_t)width * height;
+    }
+
+    double megapixels = (double)totalPixels / 1e6;
+    std::printf("\ntotal: %.1f MB of files, %.1f megapixels\n", (double)totalBytes / (1 << 20), megapixels);
+    std::printf("read      %8.1f ms  %8.1f MB/s\n", totalRead, (double)totalBytes / (1 << 20) / (totalRead / 1000.0));
+    std::printf("reference %8.1f ms  %8.1f Mpixel/s\n", totalReference, megapixels / (totalReference / 1000.0));
+    std::printf("simd      %8.1f ms  %8.1f Mpixel/s  %.1fx\n", totalSerial, megapixels / (totalSerial / 1000.0), totalReference / totalSerial);
+    std::printf("pool      %8.1f ms  %8.1f Mpixel/s  %.1fx\n", totalParallel, megapixels / (totalParallel / 1000.0), totalReference / totalParallel);
+    if (mismatches)
+    {
+        std::cout << "ERROR::TEXTURE_COOK:: " << mismatches << " images differ from the reference" << std::endl;
+        return 1;
+    }
+    return 0;
+}